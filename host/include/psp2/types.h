@@ -0,0 +1,54 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Host Shim Types
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PSP2_TYPES_H_
+#define _PSP2_TYPES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int8_t   SceChar8;
+typedef uint8_t  SceUChar8;
+typedef int8_t   SceInt8;
+typedef uint8_t  SceUInt8;
+typedef int16_t  SceInt16;
+typedef uint16_t SceUInt16;
+typedef int32_t  SceInt32;
+typedef uint32_t SceUInt32;
+typedef int32_t  SceInt;
+typedef uint32_t SceUInt;
+typedef int64_t  SceInt64;
+typedef uint64_t SceUInt64;
+
+typedef unsigned int SceSize;
+typedef int          SceSSize;
+typedef int          SceUID;
+typedef int64_t      SceOff;
+typedef int          SceBool;
+
+#define SCE_TRUE  (1)
+#define SCE_FALSE (0)
+
+#define SCE_OK    (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _PSP2_TYPES_H_ */
@@ -0,0 +1,21 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Host Shim IO
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PSP2KERN_IO_STAT_H_
+#define _PSP2KERN_IO_STAT_H_
+
+#include <psp2kern/kernel/iofilemgr.h>
+
+#endif	/* _PSP2KERN_IO_STAT_H_ */
@@ -0,0 +1,32 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Host Shim DMA Controller
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PSP2KERN_KERNEL_DMAC_H_
+#define _PSP2KERN_KERNEL_DMAC_H_
+
+#include <psp2kern/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void *ksceDmacMemcpy(void *dst, const void *src, SceSize size);
+void *ksceDmacMemset(void *dst, int c, SceSize size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _PSP2KERN_KERNEL_DMAC_H_ */
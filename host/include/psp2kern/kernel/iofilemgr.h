@@ -0,0 +1,89 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Host Shim IO File Manager
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PSP2KERN_KERNEL_IOFILEMGR_H_
+#define _PSP2KERN_KERNEL_IOFILEMGR_H_
+
+#include <psp2kern/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCE_O_RDONLY    (0x0001)
+#define SCE_O_WRONLY    (0x0002)
+#define SCE_O_RDWR      (SCE_O_RDONLY | SCE_O_WRONLY)
+#define SCE_O_NBLOCK    (0x0004)
+#define SCE_O_APPEND    (0x0100)
+#define SCE_O_CREAT     (0x0200)
+#define SCE_O_TRUNC     (0x0400)
+#define SCE_O_EXCL      (0x0800)
+
+#define SCE_SEEK_SET    (0)
+#define SCE_SEEK_CUR    (1)
+#define SCE_SEEK_END    (2)
+
+#define SCE_CST_SIZE    (0x0004)
+
+#define SCE_ERROR_ERRNO_ENOENT (0x80010002)
+#define SCE_ERROR_ERRNO_EIO    (0x80010005)
+#define SCE_ERROR_ERRNO_EBADF  (0x80010009)
+#define SCE_ERROR_ERRNO_EINVAL (0x80010016)
+
+typedef struct SceDateTime {
+	unsigned short year;
+	unsigned short month;
+	unsigned short day;
+	unsigned short hour;
+	unsigned short minute;
+	unsigned short second;
+	unsigned int microsecond;
+} SceDateTime;
+
+typedef struct SceIoStat {
+	SceUInt32 st_mode;
+	unsigned int st_attr;
+	SceOff st_size;
+	/* st_ctime/st_atime/st_mtime collide with the libc <sys/stat.h> macros */
+	SceDateTime sce_st_ctime;
+	SceDateTime sce_st_atime;
+	SceDateTime sce_st_mtime;
+	unsigned int st_private[6];
+} SceIoStat;
+
+SceUID ksceIoOpen(const char *file, int flags, int mode);
+int ksceIoClose(SceUID fd);
+int ksceIoRead(SceUID fd, void *data, SceSize size);
+int ksceIoWrite(SceUID fd, const void *data, SceSize size);
+int ksceIoPread(SceUID fd, void *data, SceSize size, SceOff offset);
+int ksceIoPwrite(SceUID fd, const void *data, SceSize size, SceOff offset);
+SceOff ksceIoLseek(SceUID fd, SceOff offset, int whence);
+int ksceIoRemove(const char *file);
+int ksceIoRename(const char *oldname, const char *newname);
+int ksceIoSync(const char *device, unsigned int unk);
+int ksceIoSyncByFd(SceUID fd);
+
+int ksceIoGetstat(const char *file, SceIoStat *stat);
+int ksceIoGetstatByFd(SceUID fd, SceIoStat *stat);
+int ksceIoChstatByFd(SceUID fd, const SceIoStat *stat, unsigned int bits);
+
+int ksceIoMount(int id, const char *path, int permission, int a4, int a5, int a6);
+int ksceIoUmount(int id, int force, int a3, int a4);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _PSP2KERN_KERNEL_IOFILEMGR_H_ */
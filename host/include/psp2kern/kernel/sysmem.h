@@ -0,0 +1,54 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Host Shim System Memory
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PSP2KERN_KERNEL_SYSMEM_H_
+#define _PSP2KERN_KERNEL_SYSMEM_H_
+
+#include <psp2kern/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCE_KERNEL_ERROR_NO_MEMORY     (0x80020007)
+#define SCE_KERNEL_ERROR_INVALID_ARGUMENT (0x80020003)
+
+typedef struct SceKernelAllocMemBlockKernelOpt SceKernelAllocMemBlockKernelOpt;
+
+SceUID ksceKernelAllocMemBlock(const char *name, SceUInt32 type, SceSize size, SceKernelAllocMemBlockKernelOpt *opt);
+int ksceKernelFreeMemBlock(SceUID uid);
+int ksceKernelGetMemBlockBase(SceUID uid, void **basep);
+SceUID ksceKernelFindMemBlockByAddr(const void *addr, SceSize size);
+
+typedef struct SceKernelHeapCreateOpt {
+	SceSize size;
+	SceUInt32 attr;
+	SceUInt32 field_8;
+	SceUInt32 field_C;
+	SceUInt32 field_10;
+	SceUInt32 field_14;
+} SceKernelHeapCreateOpt;
+
+SceUID ksceKernelCreateHeap(const char *name, SceSize size, SceKernelHeapCreateOpt *opt);
+int ksceKernelDeleteHeap(SceUID uid);
+
+void *ksceKernelAllocHeapMemory(SceUID uid, SceSize size);
+void ksceKernelFreeHeapMemory(SceUID uid, void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _PSP2KERN_KERNEL_SYSMEM_H_ */
@@ -0,0 +1,79 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Host Shim Thread Manager
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PSP2KERN_KERNEL_THREADMGR_H_
+#define _PSP2KERN_KERNEL_THREADMGR_H_
+
+#include <psp2kern/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCE_KERNEL_ERROR_WAIT_TIMEOUT (0x80028005)
+#define SCE_KERNEL_ERROR_EVF_COND     (0x800281A3)
+#define SCE_KERNEL_ERROR_UNKNOWN_UID  (0x80020001)
+
+typedef int (* SceKernelThreadEntry)(SceSize args, void *argp);
+
+typedef struct SceKernelThreadOptParam SceKernelThreadOptParam;
+
+SceUID ksceKernelCreateThread(const char *name, SceKernelThreadEntry entry, int initPriority, SceSize stackSize, SceUInt32 attr, int cpuAffinityMask, const SceKernelThreadOptParam *option);
+int ksceKernelDeleteThread(SceUID thid);
+int ksceKernelStartThread(SceUID thid, SceSize arglen, void *argp);
+int ksceKernelExitThread(int status);
+int ksceKernelWaitThreadEnd(SceUID thid, int *stat, SceUInt *timeout);
+int ksceKernelChangeThreadPriority(SceUID thid, int priority);
+int ksceKernelChangeThreadCpuAffinityMask(SceUID thid, int cpuAffinityMask);
+int ksceKernelDelayThread(SceUInt delay);
+SceUID ksceKernelGetThreadId(void);
+
+SceInt64 ksceKernelGetSystemTimeWide(void);
+SceUInt32 ksceKernelGetSystemTimeLow(void);
+
+/* Event flag */
+#define SCE_EVENT_WAITAND       (0x00000000)
+#define SCE_EVENT_WAITOR        (0x00000001)
+#define SCE_EVENT_WAITCLEAR     (0x00000002)
+#define SCE_EVENT_WAITCLEAR_PAT (0x00000004)
+
+#define SCE_EVENT_WAITSINGLE    (0x00000000)
+#define SCE_EVENT_WAITMULTIPLE  (0x00001000)
+
+typedef struct SceKernelEventFlagOptParam SceKernelEventFlagOptParam;
+
+SceUID ksceKernelCreateEventFlag(const char *name, int attr, int bits, SceKernelEventFlagOptParam *opt);
+int ksceKernelDeleteEventFlag(SceUID evfid);
+int ksceKernelSetEventFlag(SceUID evfid, unsigned int bits);
+int ksceKernelClearEventFlag(SceUID evfid, unsigned int bits);
+int ksceKernelPollEventFlag(SceUID evfid, unsigned int bits, unsigned int wait, unsigned int *outBits);
+int ksceKernelWaitEventFlag(SceUID evfid, unsigned int bits, unsigned int wait, unsigned int *outBits, SceUInt *timeout);
+
+/* Fast mutex */
+typedef struct SceKernelLwMutexWork {
+	SceInt64 data[8];
+} SceKernelLwMutexWork;
+
+int ksceKernelInitializeFastMutex(void *mutex, const char *name, int unk0, int unk1);
+int ksceKernelLockFastMutex(void *mutex);
+int ksceKernelTryLockFastMutex(void *mutex);
+int ksceKernelUnlockFastMutex(void *mutex);
+int ksceKernelDeleteFastMutex(void *mutex);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _PSP2KERN_KERNEL_THREADMGR_H_ */
@@ -0,0 +1,170 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Sector I/O Benchmark
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vmass.h"
+#include "vmass_host.h"
+
+/*
+ * 1 sector FAT/directory updates up to the 0x100 sector bulk transfers SceUsbMass issues.
+ * 0x40 and 0xA0 are the first sizes offloaded to the RW thread for write and read.
+ */
+static const SceSize bench_sector_list[] = {
+	0x1, 0x8, 0x20, 0x40, 0x80, 0xA0, 0x100
+};
+
+typedef int (* VmassBenchOp)(SceSize sector_pos, void *data, SceSize sector_num);
+
+static SceInt64 benchGetTimeNs(void){
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((SceInt64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static int benchWriteSector(SceSize sector_pos, void *data, SceSize sector_num){
+	return vmassWriteSector(sector_pos, data, sector_num);
+}
+
+static int benchRun(const char *name, VmassBenchOp op, SceSize all_sector, SceSize sector_num, void *data, int count){
+
+	int i, res;
+	SceSize sector_pos = 0;
+	SceInt64 time_s, time_e, lat, lat_min = -1, lat_max = 0, total = 0;
+
+	for(i=0;i<count;i++){
+		if((sector_pos + sector_num) > all_sector)
+			sector_pos = 0;
+
+		time_s = benchGetTimeNs();
+		res = op(sector_pos, data, sector_num);
+		time_e = benchGetTimeNs();
+
+		if(res < 0){
+			printf("%s failed at sector 0x%08X:0x%X (0x%X)\n", name, sector_pos, sector_num, res);
+			return res;
+		}
+
+		lat = time_e - time_s;
+		total += lat;
+		if(lat_min < 0 || lat < lat_min)
+			lat_min = lat;
+		if(lat > lat_max)
+			lat_max = lat;
+
+		sector_pos += sector_num;
+	}
+
+	printf("%-5s 0x%04X %8u %10.1f %10.2f %10.2f %10.2f\n",
+		name, sector_num, sector_num << 9,
+		((double)(sector_num << 9) * count) / ((double)total / 1000000000.0) / 1000000.0,
+		(double)total / count / 1000.0, (double)lat_min / 1000.0, (double)lat_max / 1000.0);
+
+	return 0;
+}
+
+static void benchPrintLatency(const char *name, const SceUInt64 (*latency)[VMASS_STAT_LATENCY_NUM]){
+
+	int i, n;
+	static const char * const size_name[VMASS_STAT_SIZE_NUM] = {"<=4K", "<=64K", "<=512K", ">512K"};
+
+	for(i=0;i<VMASS_STAT_SIZE_NUM;i++){
+		for(n=0;n<VMASS_STAT_LATENCY_NUM && latency[i][n] == 0;n++);
+		if(n == VMASS_STAT_LATENCY_NUM)
+			continue;
+
+		printf("%-5s %-6s", name, size_name[i]);
+
+		for(n=0;n<VMASS_STAT_LATENCY_NUM;n++){
+			if(latency[i][n] != 0)
+				printf(" <%uus:%llu", 1 << n, (unsigned long long)latency[i][n]);
+		}
+
+		printf("\n");
+	}
+}
+
+int main(int argc, char *argv[]){
+
+	int i, res, count = 0x2000;
+	void *data;
+	SceSize read_split_sector, write_split_sector, backed_size, total_size;
+	SceUsbMassDevInfo info;
+	VmassCopyStat copy_stat;
+	VmassStat stat;
+
+	if(argc > 1)
+		count = strtol(argv[1], NULL, 0);
+
+	if(count <= 0){
+		fprintf(stderr, "usage: %s [requests per size]\n", argv[0]);
+		return 1;
+	}
+
+	res = vmassInit();
+	if(res < 0){
+		fprintf(stderr, "vmassInit failed 0x%X\n", res);
+		return 1;
+	}
+
+	vmassGetDevInfo(&info);
+
+	printf("storage %u sectors (%u MiB), %d requests per size\n", info.number_of_all_sector, info.number_of_all_sector >> 11, count);
+
+	vmassGetSplitThreshold(0, &read_split_sector, &write_split_sector);
+	printf("split threshold read 0x%X write 0x%X sectors per worker\n", read_split_sector, write_split_sector);
+	printf("%-5s %6s %8s %10s %10s %10s %10s\n", "op", "sector", "bytes", "MB/s", "avg(us)", "min(us)", "max(us)");
+
+	data = aligned_alloc(0x40, bench_sector_list[(sizeof(bench_sector_list) / sizeof(bench_sector_list[0])) - 1] << 9);
+	memset(data, 0xA5, bench_sector_list[(sizeof(bench_sector_list) / sizeof(bench_sector_list[0])) - 1] << 9);
+
+	for(i=0;i<(sizeof(bench_sector_list) / sizeof(bench_sector_list[0]));i++){
+		res = benchRun("write", benchWriteSector, info.number_of_all_sector, bench_sector_list[i], data, count);
+		if(res < 0)
+			break;
+	}
+
+	for(i=0;res >= 0 && i<(sizeof(bench_sector_list) / sizeof(bench_sector_list[0]));i++){
+		res = benchRun("read", vmassReadSector, info.number_of_all_sector, bench_sector_list[i], data, count);
+	}
+
+	vmassGetCopyStat(&copy_stat);
+	printf("copy cpu %llu (%llu bytes) dmac %llu (%llu bytes)\n",
+		(unsigned long long)copy_stat.cpu_count, (unsigned long long)copy_stat.cpu_bytes,
+		(unsigned long long)copy_stat.dmac_count, (unsigned long long)copy_stat.dmac_bytes);
+
+	vmassGetStat(&stat, VMASS_STAT_RESET);
+	printf("requests read %llu (%llu bytes) write %llu (%llu bytes), chunks queued %llu inline %llu, lock waits %llu (%llu us)\n",
+		(unsigned long long)stat.read_count, (unsigned long long)stat.read_bytes,
+		(unsigned long long)stat.write_count, (unsigned long long)stat.write_bytes,
+		(unsigned long long)stat.queue_count, (unsigned long long)stat.inline_count,
+		(unsigned long long)stat.lock_wait_count, (unsigned long long)stat.lock_wait_time);
+
+	benchPrintLatency("read", stat.read_latency);
+	benchPrintLatency("write", stat.write_latency);
+
+	vmassGetStorageUsage(&backed_size, &total_size);
+	printf("storage backed 0x%X of 0x%X bytes\n", backed_size, total_size);
+
+	free(data);
+
+	return (res < 0) ? 1 : 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Config Checker
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vmass.h"
+#include "vmass_config.h"
+
+static void cfgPrint(const VmassConfig *cfg){
+
+	SceSize i;
+
+	if(cfg->capacity != 0)
+		printf("capacity          0x%X\n", cfg->capacity);
+
+	for(i=0;i<cfg->memtype_num;i++)
+		printf("memtype           0x%08X max 0x%X\n", cfg->memtype[i].memtype, cfg->memtype[i].max_size);
+
+	if(cfg->cluster_size != 0)
+		printf("cluster_size      0x%X\n", cfg->cluster_size);
+
+	if(cfg->cluster_align != 0)
+		printf("cluster_align     0x%X\n", cfg->cluster_align);
+
+	if(cfg->trace_record_num != 0)
+		printf("trace             0x%X\n", cfg->trace_record_num);
+
+	if(cfg->rw_priority != 0)
+		printf("rw_priority       0x%X\n", cfg->rw_priority);
+
+	if(cfg->rw_work_priority != 0)
+		printf("rw_work_priority  0x%X\n", cfg->rw_work_priority);
+
+	if(cfg->rw_stack_size != 0)
+		printf("rw_stack_size     0x%X\n", cfg->rw_stack_size);
+
+	if(cfg->rw_cpu_mask != 0)
+		printf("rw_cpu_mask       0x%X\n", cfg->rw_cpu_mask);
+
+	for(i=0;i<cfg->split_num;i++)
+		printf("split             0x%08X read 0x%X write 0x%X\n", cfg->split[i].memtype, cfg->split[i].read_split_sector, cfg->split[i].write_split_sector);
+
+	if(cfg->calibrate_mode >= 0)
+		printf("calibrate         %d\n", cfg->calibrate_mode);
+
+	if(cfg->thin_mode >= 0)
+		printf("thin              %d\n", cfg->thin_mode);
+
+	if(cfg->reclaim_mode >= 0)
+		printf("reclaim           %d\n", cfg->reclaim_mode);
+
+	if(cfg->load_mode >= 0)
+		printf("load_mode         %d\n", cfg->load_mode);
+
+	if(cfg->image_format >= 0)
+		printf("image_format      %d\n", cfg->image_format);
+
+	if(cfg->journal_mode >= 0)
+		printf("journal           %d\n", cfg->journal_mode);
+
+	if(cfg->journal_latency != 0)
+		printf("journal_latency   %u\n", cfg->journal_latency);
+
+	for(i=0;i<cfg->image_path_num;i++)
+		printf("image_path        %s\n", cfg->image_path[i]);
+
+	if(cfg->reject_num != 0)
+		printf("%u line(s) skipped, first at line %u\n", cfg->reject_num, cfg->reject_line);
+}
+
+static int cfgParse(VmassConfig *cfg, const char *text){
+	vmassConfigClear(cfg);
+	return vmassConfigParse(cfg, text, strlen(text));
+}
+
+#define CFG_CHECK(cond) do { \
+	if(!(cond)){ \
+		printf("selftest: %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		fail++; \
+	} \
+} while(0)
+
+/*
+ * Parser cases, each checks what was taken and what was skipped.
+ */
+static int cfgSelfTest(void){
+
+	int fail = 0;
+	VmassConfig cfg;
+
+	CFG_CHECK(cfgParse(&cfg, "") == 0 && cfg.capacity == 0 && cfg.calibrate_mode == -1 && cfg.thin_mode == -1 && cfg.reclaim_mode == -1
+		&& cfg.load_mode == -1 && cfg.image_format == -1 && cfg.journal_mode == -1 && cfg.journal_latency == 0);
+	CFG_CHECK(cfgParse(&cfg, "# comment only\n\n   \t\n") == 0);
+
+	CFG_CHECK(cfgParse(&cfg, "capacity = 32M\n") == 0 && cfg.capacity == 0x2000000);
+	CFG_CHECK(cfgParse(&cfg, "capacity=0x600000") == 0 && cfg.capacity == 0x600000);
+	CFG_CHECK(cfgParse(&cfg, "  capacity\t=\t1024K   # trailing comment\r\n") == 0 && cfg.capacity == 0x100000);
+	CFG_CHECK(cfgParse(&cfg, "capacity = 1G\n") == 0 && cfg.capacity == 0x40000000);
+	CFG_CHECK(cfgParse(&cfg, "capacity = 4G\n") == 1 && cfg.capacity == 0);
+	CFG_CHECK(cfgParse(&cfg, "capacity = 0x1000\n") == 1 && cfg.capacity == 0);
+	CFG_CHECK(cfgParse(&cfg, "capacity = 0x10800\n") == 1);
+	CFG_CHECK(cfgParse(&cfg, "capacity = 12abc\n") == 1);
+	CFG_CHECK(cfgParse(&cfg, "capacity = 0x\n") == 1);
+	CFG_CHECK(cfgParse(&cfg, "capacity = M\n") == 1);
+	CFG_CHECK(cfgParse(&cfg, "capacity = 99999999999\n") == 1);
+	CFG_CHECK(cfgParse(&cfg, "capacity = 1M 2M\n") == 1);
+	CFG_CHECK(cfgParse(&cfg, "capacity =\n") == 1);
+	CFG_CHECK(cfgParse(&cfg, "capacity 1M\n") == 1);
+	CFG_CHECK(cfgParse(&cfg, "= 1M\n") == 1);
+
+	CFG_CHECK(cfgParse(&cfg, "memtype = 0x1080D006 8M\nmemtype = 0x40404006\n") == 0 && cfg.memtype_num == 2
+		&& cfg.memtype[0].memtype == 0x1080D006 && cfg.memtype[0].max_size == 0x800000
+		&& cfg.memtype[1].memtype == 0x40404006 && cfg.memtype[1].max_size == 0);
+	CFG_CHECK(cfgParse(&cfg, "memtype = 0\nmemtype = 0x1080D006 0x1234\nmemtype = 1 2M 3M\n") == 3 && cfg.memtype_num == 0);
+	CFG_CHECK(cfgParse(&cfg, "memtype = 1\nmemtype = 2\nmemtype = 3\nmemtype = 4\nmemtype = 5\nmemtype = 6\nmemtype = 7\nmemtype = 8\nmemtype = 9\n") == 1
+		&& cfg.memtype_num == VMASS_STORAGE_MEMTYPE_MAX && cfg.reject_line == 9);
+
+	CFG_CHECK(cfgParse(&cfg, "cluster_size = 32K\n") == 0 && cfg.cluster_size == 0x8000);
+	CFG_CHECK(cfgParse(&cfg, "cluster_size = 0x100\ncluster_size = 0x3000\ncluster_size = 128K\n") == 3 && cfg.cluster_size == 0);
+
+	CFG_CHECK(cfgParse(&cfg, "cluster_align = 1M\n") == 0 && cfg.cluster_align == 0x100000);
+	CFG_CHECK(cfgParse(&cfg, "cluster_align = 0x100\ncluster_align = 0x1800\ncluster_align = 2M\n") == 3 && cfg.cluster_align == 0);
+
+	CFG_CHECK(cfgParse(&cfg, "trace = 0x10000\n") == 0 && cfg.trace_record_num == 0x10000);
+	CFG_CHECK(cfgParse(&cfg, "trace = 0x80\ntrace = 0x3000\ntrace = 1M\n") == 3 && cfg.trace_record_num == 0);
+
+	CFG_CHECK(cfgParse(&cfg, "rw_priority = 0x6E\nrw_work_priority = 40\n") == 0 && cfg.rw_priority == 0x6E && cfg.rw_work_priority == 40);
+	CFG_CHECK(cfgParse(&cfg, "rw_priority = 0\nrw_work_priority = 0x100\n") == 2 && cfg.rw_priority == 0 && cfg.rw_work_priority == 0);
+
+	CFG_CHECK(cfgParse(&cfg, "rw_stack_size = 8K\n") == 0 && cfg.rw_stack_size == 0x2000);
+	CFG_CHECK(cfgParse(&cfg, "rw_stack_size = 0x800\nrw_stack_size = 0x1800\nrw_stack_size = 1M\n") == 3 && cfg.rw_stack_size == 0);
+
+	CFG_CHECK(cfgParse(&cfg, "rw_cpu_mask = 0x7\n") == 0 && cfg.rw_cpu_mask == 0x7);
+	CFG_CHECK(cfgParse(&cfg, "rw_cpu_mask = 0\nrw_cpu_mask = 0x10\n") == 2 && cfg.rw_cpu_mask == 0);
+
+	CFG_CHECK(cfgParse(&cfg, "split = 0 0x50 0x20\nsplit = 0x40404006 never 8\n") == 0 && cfg.split_num == 2
+		&& cfg.split[0].memtype == 0 && cfg.split[0].read_split_sector == 0x50 && cfg.split[0].write_split_sector == 0x20
+		&& cfg.split[1].memtype == 0x40404006 && cfg.split[1].read_split_sector == VMASS_SPLIT_NEVER && cfg.split[1].write_split_sector == 8);
+	CFG_CHECK(cfgParse(&cfg, "split = 0 0 0x20\nsplit = 0 0x50\nsplit = 0 1 2 3\n") == 3 && cfg.split_num == 0);
+
+	CFG_CHECK(cfgParse(&cfg, "calibrate = init\n") == 0 && cfg.calibrate_mode == VMASS_CALIBRATE_INIT);
+	CFG_CHECK(cfgParse(&cfg, "calibrate = layout\n") == 1 && cfg.calibrate_mode == -1);
+	CFG_CHECK(cfgParse(&cfg, "calibrate = off\n") == 0 && cfg.calibrate_mode == VMASS_CALIBRATE_OFF);
+	CFG_CHECK(cfgParse(&cfg, "calibrate = Off\n") == 1 && cfg.calibrate_mode == -1);
+
+	CFG_CHECK(cfgParse(&cfg, "thin = on\n") == 0 && cfg.thin_mode == 1);
+	CFG_CHECK(cfgParse(&cfg, "thin = off\n") == 0 && cfg.thin_mode == 0);
+	CFG_CHECK(cfgParse(&cfg, "thin = 1\nthin = on off\n") == 2 && cfg.thin_mode == -1);
+
+	CFG_CHECK(cfgParse(&cfg, "reclaim = auto\n") == 0 && cfg.reclaim_mode == VMASS_RECLAIM_AUTO);
+	CFG_CHECK(cfgParse(&cfg, "reclaim = manual\n") == 0 && cfg.reclaim_mode == VMASS_RECLAIM_MANUAL);
+	CFG_CHECK(cfgParse(&cfg, "reclaim = on\n") == 1 && cfg.reclaim_mode == -1);
+
+	CFG_CHECK(cfgParse(&cfg, "load_mode = lazy\nimage_format = lz\n") == 0 && cfg.load_mode == VMASS_LOAD_LAZY && cfg.image_format == VMASS_IMAGE_LZ);
+	CFG_CHECK(cfgParse(&cfg, "load_mode = sync\nimage_format = sparse\n") == 0 && cfg.load_mode == VMASS_LOAD_SYNC && cfg.image_format == VMASS_IMAGE_SPARSE);
+	CFG_CHECK(cfgParse(&cfg, "load_mode = 1\nimage_format = raw\n") == 2 && cfg.load_mode == -1 && cfg.image_format == -1);
+
+	CFG_CHECK(cfgParse(&cfg, "journal = on\njournal_latency = 50000\n") == 0 && cfg.journal_mode == VMASS_JOURNAL_ON && cfg.journal_latency == 50000);
+	CFG_CHECK(cfgParse(&cfg, "journal = off\n") == 0 && cfg.journal_mode == VMASS_JOURNAL_OFF && cfg.journal_latency == 0);
+	CFG_CHECK(cfgParse(&cfg, "journal = 1\njournal_latency = 999\njournal_latency = 0x1000000\n") == 3 && cfg.journal_mode == -1 && cfg.journal_latency == 0);
+
+	CFG_CHECK(cfgParse(&cfg, "image_path = ux0:vmass/uma0.img\nimage_path = sd0:vmass.img\n") == 0 && cfg.image_path_num == 2
+		&& strcmp(cfg.image_path[0], "ux0:vmass/uma0.img") == 0 && strcmp(cfg.image_path[1], "sd0:vmass.img") == 0);
+	CFG_CHECK(cfgParse(&cfg, "image_path = vmass.img\nimage_path = a:b c\n") == 2 && cfg.image_path_num == 0);
+	CFG_CHECK(cfgParse(&cfg, "image_path = ux0:aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaabbbbbbbbbbbbbbbb\n") == 1);
+
+	CFG_CHECK(cfgParse(&cfg, "unknown = 1\ncapacity = 16M\n") == 1 && cfg.reject_line == 1 && cfg.capacity == 0x1000000);
+	CFG_CHECK(cfgParse(&cfg, "capacity = 16M\ncapacity = 8M") == 0 && cfg.capacity == 0x800000);
+
+	printf("selftest: %s\n", (fail == 0) ? "ok" : "failed");
+
+	return (fail == 0) ? 0 : -1;
+}
+
+int main(int argc, char *argv[]){
+
+	FILE *fp;
+	char *text;
+	size_t size;
+	VmassConfig cfg;
+
+	if(argc != 2){
+		fprintf(stderr, "usage: %s <vmass.cfg>\n", argv[0]);
+		fprintf(stderr, "       %s selftest\n", argv[0]);
+		return 1;
+	}
+
+	if(strcmp(argv[1], "selftest") == 0)
+		return (cfgSelfTest() < 0) ? 1 : 0;
+
+	fp = fopen(argv[1], "rb");
+	if(fp == NULL){
+		perror(argv[1]);
+		return 1;
+	}
+
+	text = malloc(VMASS_CONFIG_FILE_MAX);
+	if(text == NULL){
+		fclose(fp);
+		return 1;
+	}
+
+	// vmassConfigLoad reads at most VMASS_CONFIG_FILE_MAX bytes too
+	size = fread(text, 1, VMASS_CONFIG_FILE_MAX, fp);
+	fclose(fp);
+
+	vmassConfigClear(&cfg);
+	vmassConfigParse(&cfg, text, size);
+	free(text);
+
+	cfgPrint(&cfg);
+
+	return (cfg.reject_num != 0) ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Copy Kernel Benchmark
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vmass_copy.h"
+
+typedef void (* VmassCopyFunc)(void *dst, const void *src, SceSize size);
+
+typedef struct CopyBenchKernel {
+	const char *name;
+	VmassCopyFunc func;
+} CopyBenchKernel;
+
+static void benchMemcpy(void *dst, const void *src, SceSize size){
+	memcpy(dst, src, size);
+}
+
+static const CopyBenchKernel copybench_kernel[] = {
+	{"memcpy",  benchMemcpy},
+	{"kernel",  vmassCopyCpu}
+};
+
+static const SceSize copybench_size[] = {
+	0x200, 0x1000, 0x4000, 0x10000, 0x20000
+};
+
+/*
+ * dst/src misalignment: both aligned, src misaligned, dst misaligned.
+ */
+static const SceSize copybench_align[][2] = {
+	{0, 0}, {0, 4}, {4, 0}
+};
+
+static SceInt64 benchGetTimeNs(void){
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((SceInt64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static double benchCopy(VmassCopyFunc func, void *dst, const void *src, SceSize size, SceSize total){
+
+	SceSize i, count = total / size;
+	SceInt64 time_s;
+
+	func(dst, src, size);
+
+	time_s = benchGetTimeNs();
+
+	for(i=0;i<count;i++)
+		func(dst, src, size);
+
+	return ((double)size * count) / ((double)(benchGetTimeNs() - time_s) / 1000000000.0) / 1000000.0;
+}
+
+int main(int argc, char *argv[]){
+
+	int i, j, k;
+	SceSize total = 0x10000000;
+	char *dst, *src;
+
+	if(argc > 1)
+		total = strtoul(argv[1], NULL, 0);
+
+	dst = aligned_alloc(0x40, copybench_size[(sizeof(copybench_size) / sizeof(copybench_size[0])) - 1] + 0x40);
+	src = aligned_alloc(0x40, copybench_size[(sizeof(copybench_size) / sizeof(copybench_size[0])) - 1] + 0x40);
+
+	memset(src, 0x5A, copybench_size[(sizeof(copybench_size) / sizeof(copybench_size[0])) - 1] + 0x40);
+
+	printf("%8s %4s %4s", "size", "dst", "src");
+	for(k=0;k<(sizeof(copybench_kernel) / sizeof(copybench_kernel[0]));k++)
+		printf(" %10s", copybench_kernel[k].name);
+	printf("  (MB/s)\n");
+
+	for(i=0;i<(sizeof(copybench_size) / sizeof(copybench_size[0]));i++){
+		for(j=0;j<(sizeof(copybench_align) / sizeof(copybench_align[0]));j++){
+			printf("%8u %4u %4u", copybench_size[i], copybench_align[j][0], copybench_align[j][1]);
+
+			for(k=0;k<(sizeof(copybench_kernel) / sizeof(copybench_kernel[0]));k++){
+				printf(" %10.1f", benchCopy(copybench_kernel[k].func,
+					dst + copybench_align[j][0], src + copybench_align[j][1], copybench_size[i], total));
+			}
+
+			if(memcmp(dst + copybench_align[j][0], src + copybench_align[j][1], copybench_size[i]) != 0){
+				printf("  MISMATCH\n");
+				return 1;
+			}
+
+			printf("\n");
+		}
+	}
+
+	free(dst);
+	free(src);
+
+	return 0;
+}
@@ -0,0 +1,976 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Host Shim
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Maps the subset of the SceKernel/SceIofilemgr driver API used by vmass
+ * onto pthreads, malloc and POSIX files so the engine runs unmodified on Linux.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <psp2kern/kernel/threadmgr.h>
+#include <psp2kern/kernel/sysmem.h>
+#include <psp2kern/kernel/sysclib.h>
+#include <psp2kern/kernel/dmac.h>
+#include <psp2kern/kernel/cpu.h>
+#include <psp2kern/kernel/modulemgr.h>
+#include <psp2kern/kernel/iofilemgr.h>
+#include <psp2kern/syscon.h>
+#include "sysevent.h"
+#include "vmass_host.h"
+
+#define HOST_OBJ_MAX (0x400)
+#define HOST_UID_BASE (0x10005)
+
+#define HOST_OBJ_FREE    (0)
+#define HOST_OBJ_THREAD  (1)
+#define HOST_OBJ_EVF     (2)
+#define HOST_OBJ_MEMBLK  (3)
+#define HOST_OBJ_FILE    (4)
+#define HOST_OBJ_SYSEVT  (5)
+#define HOST_OBJ_HEAP    (6)
+
+typedef struct HostThread {
+	pthread_t pthread;
+	SceKernelThreadEntry entry;
+	int cpu_mask;
+	int started;
+	int exit_status;
+	SceSize arglen;
+	void *argp;
+} HostThread;
+
+typedef struct HostEvf {
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	unsigned int bits;
+} HostEvf;
+
+typedef struct HostMemBlock {
+	void *base;
+	SceSize size;
+	SceUInt32 type;
+} HostMemBlock;
+
+/*
+ * Heaps are malloc with a budget of their creation size, so running out of pool space can be tested.
+ */
+typedef struct HostHeap {
+	pthread_mutex_t mtx;
+	SceSize size;
+	SceSize used;
+} HostHeap;
+
+typedef struct HostSysEvent {
+	SceSysEventCallback cb;
+	void *argp;
+} HostSysEvent;
+
+typedef struct HostObject {
+	int type;
+	char name[0x20];
+	union {
+		HostThread thread;
+		HostEvf evf;
+		HostMemBlock memblk;
+		int fd;
+		HostSysEvent sysevt;
+		HostHeap heap;
+	};
+} HostObject;
+
+static pthread_mutex_t host_obj_mtx = PTHREAD_MUTEX_INITIALIZER;
+static HostObject host_obj[HOST_OBJ_MAX];
+static __thread SceUID host_current_thid = -1;
+static SceUInt32 host_ctrl = 0xFFFFFFFF;
+static char host_root[0x400];
+
+static SceUID hostObjAlloc(int type, const char *name, HostObject **ppObj){
+
+	int i;
+
+	pthread_mutex_lock(&host_obj_mtx);
+
+	for(i=0;i<HOST_OBJ_MAX;i++){
+		if(host_obj[i].type == HOST_OBJ_FREE){
+			memset(&host_obj[i], 0, sizeof(host_obj[i]));
+			host_obj[i].type = type;
+			if(name != NULL)
+				strncpy(host_obj[i].name, name, sizeof(host_obj[i].name) - 1);
+			pthread_mutex_unlock(&host_obj_mtx);
+
+			*ppObj = &host_obj[i];
+			return HOST_UID_BASE + (i << 1);
+		}
+	}
+
+	pthread_mutex_unlock(&host_obj_mtx);
+
+	return SCE_KERNEL_ERROR_NO_MEMORY;
+}
+
+static HostObject *hostObjGet(SceUID uid, int type){
+
+	int idx = (uid - HOST_UID_BASE) >> 1;
+
+	if(uid < HOST_UID_BASE || idx >= HOST_OBJ_MAX || host_obj[idx].type != type)
+		return NULL;
+
+	return &host_obj[idx];
+}
+
+static void hostObjFree(HostObject *obj){
+	pthread_mutex_lock(&host_obj_mtx);
+	obj->type = HOST_OBJ_FREE;
+	pthread_mutex_unlock(&host_obj_mtx);
+}
+
+/* Thread */
+
+static void *hostThreadEntry(void *arg){
+
+	SceUID thid = (SceUID)(intptr_t)arg;
+	HostObject *obj = hostObjGet(thid, HOST_OBJ_THREAD);
+
+	host_current_thid = thid;
+
+	obj->thread.exit_status = obj->thread.entry(obj->thread.arglen, obj->thread.argp);
+
+	return NULL;
+}
+
+SceUID ksceKernelCreateThread(const char *name, SceKernelThreadEntry entry, int initPriority, SceSize stackSize, SceUInt32 attr, int cpuAffinityMask, const SceKernelThreadOptParam *option){
+
+	SceUID thid;
+	HostObject *obj;
+
+	thid = hostObjAlloc(HOST_OBJ_THREAD, name, &obj);
+	if(thid < 0)
+		return thid;
+
+	obj->thread.entry    = entry;
+	obj->thread.cpu_mask = cpuAffinityMask;
+
+	return thid;
+}
+
+static void hostThreadApplyAffinity(pthread_t pthread, int cpuAffinityMask){
+
+	int i;
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	cpu_set_t set;
+
+	if(cpuAffinityMask == 0 || ncpu <= 0)
+		return;
+
+	/*
+	 * Kernel masks use bit 0-3 and user masks use bit 16-19 for the four cores.
+	 */
+	CPU_ZERO(&set);
+	for(i=0;i<4;i++){
+		if((cpuAffinityMask & ((1 << i) | (0x10000 << i))) != 0)
+			CPU_SET(i % ncpu, &set);
+	}
+
+	pthread_setaffinity_np(pthread, sizeof(set), &set);
+}
+
+int ksceKernelStartThread(SceUID thid, SceSize arglen, void *argp){
+
+	HostObject *obj = hostObjGet(thid, HOST_OBJ_THREAD);
+
+	if(obj == NULL)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	if(arglen != 0 && argp != NULL){
+		obj->thread.argp = malloc(arglen);
+		memcpy(obj->thread.argp, argp, arglen);
+	}
+	obj->thread.arglen = arglen;
+
+	if(pthread_create(&obj->thread.pthread, NULL, hostThreadEntry, (void *)(intptr_t)thid) != 0)
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+
+	hostThreadApplyAffinity(obj->thread.pthread, obj->thread.cpu_mask);
+
+	obj->thread.started = 1;
+
+	return 0;
+}
+
+int ksceKernelWaitThreadEnd(SceUID thid, int *stat, SceUInt *timeout){
+
+	HostObject *obj = hostObjGet(thid, HOST_OBJ_THREAD);
+
+	if(obj == NULL)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	if(obj->thread.started != 0){
+		pthread_join(obj->thread.pthread, NULL);
+		obj->thread.started = 0;
+	}
+
+	if(stat != NULL)
+		*stat = obj->thread.exit_status;
+
+	return 0;
+}
+
+int ksceKernelDeleteThread(SceUID thid){
+
+	HostObject *obj = hostObjGet(thid, HOST_OBJ_THREAD);
+
+	if(obj == NULL)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	if(obj->thread.started != 0)
+		pthread_detach(obj->thread.pthread);
+
+	free(obj->thread.argp);
+	hostObjFree(obj);
+
+	return 0;
+}
+
+int ksceKernelExitThread(int status){
+
+	HostObject *obj = hostObjGet(host_current_thid, HOST_OBJ_THREAD);
+
+	if(obj != NULL)
+		obj->thread.exit_status = status;
+
+	pthread_exit(NULL);
+
+	return 0;
+}
+
+int ksceKernelChangeThreadPriority(SceUID thid, int priority){
+	return 0;
+}
+
+int ksceKernelChangeThreadCpuAffinityMask(SceUID thid, int cpuAffinityMask){
+
+	HostObject *obj;
+
+	if(thid == 0)
+		thid = host_current_thid;
+
+	obj = hostObjGet(thid, HOST_OBJ_THREAD);
+	if(obj == NULL)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	obj->thread.cpu_mask = cpuAffinityMask;
+	if(obj->thread.started != 0)
+		hostThreadApplyAffinity(obj->thread.pthread, cpuAffinityMask);
+
+	return 0;
+}
+
+int ksceKernelDelayThread(SceUInt delay){
+	usleep(delay);
+	return 0;
+}
+
+SceUID ksceKernelGetThreadId(void){
+	return host_current_thid;
+}
+
+SceInt64 ksceKernelGetSystemTimeWide(void){
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((SceInt64)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+SceUInt32 ksceKernelGetSystemTimeLow(void){
+	return (SceUInt32)ksceKernelGetSystemTimeWide();
+}
+
+int ksceKernelCpuGetCpuId(void){
+
+	int cpu = sched_getcpu();
+
+	return (cpu < 0) ? 0 : (cpu & 3);
+}
+
+/* Event flag */
+
+SceUID ksceKernelCreateEventFlag(const char *name, int attr, int bits, SceKernelEventFlagOptParam *opt){
+
+	SceUID evfid;
+	HostObject *obj;
+
+	evfid = hostObjAlloc(HOST_OBJ_EVF, name, &obj);
+	if(evfid < 0)
+		return evfid;
+
+	pthread_mutex_init(&obj->evf.mtx, NULL);
+	pthread_cond_init(&obj->evf.cond, NULL);
+	obj->evf.bits = bits;
+
+	return evfid;
+}
+
+int ksceKernelDeleteEventFlag(SceUID evfid){
+
+	HostObject *obj = hostObjGet(evfid, HOST_OBJ_EVF);
+
+	if(obj == NULL)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	pthread_cond_destroy(&obj->evf.cond);
+	pthread_mutex_destroy(&obj->evf.mtx);
+	hostObjFree(obj);
+
+	return 0;
+}
+
+int ksceKernelSetEventFlag(SceUID evfid, unsigned int bits){
+
+	HostObject *obj = hostObjGet(evfid, HOST_OBJ_EVF);
+
+	if(obj == NULL)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	pthread_mutex_lock(&obj->evf.mtx);
+	obj->evf.bits |= bits;
+	pthread_cond_broadcast(&obj->evf.cond);
+	pthread_mutex_unlock(&obj->evf.mtx);
+
+	return 0;
+}
+
+int ksceKernelClearEventFlag(SceUID evfid, unsigned int bits){
+
+	HostObject *obj = hostObjGet(evfid, HOST_OBJ_EVF);
+
+	if(obj == NULL)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	pthread_mutex_lock(&obj->evf.mtx);
+	obj->evf.bits &= bits;
+	pthread_mutex_unlock(&obj->evf.mtx);
+
+	return 0;
+}
+
+static int hostEvfMatch(HostEvf *evf, unsigned int bits, unsigned int wait, unsigned int *outBits){
+
+	unsigned int match = evf->bits & bits;
+
+	if(((wait & SCE_EVENT_WAITOR) != 0) ? (match == 0) : (match != bits))
+		return 0;
+
+	if(outBits != NULL)
+		*outBits = evf->bits;
+
+	if((wait & SCE_EVENT_WAITCLEAR) != 0)
+		evf->bits = 0;
+	else if((wait & SCE_EVENT_WAITCLEAR_PAT) != 0)
+		evf->bits &= ~bits;
+
+	return 1;
+}
+
+int ksceKernelPollEventFlag(SceUID evfid, unsigned int bits, unsigned int wait, unsigned int *outBits){
+
+	int res;
+	HostObject *obj = hostObjGet(evfid, HOST_OBJ_EVF);
+
+	if(obj == NULL)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	pthread_mutex_lock(&obj->evf.mtx);
+	res = hostEvfMatch(&obj->evf, bits, wait, outBits) ? 0 : SCE_KERNEL_ERROR_EVF_COND;
+	pthread_mutex_unlock(&obj->evf.mtx);
+
+	return res;
+}
+
+int ksceKernelWaitEventFlag(SceUID evfid, unsigned int bits, unsigned int wait, unsigned int *outBits, SceUInt *timeout){
+
+	int res = 0;
+	struct timespec ts;
+	HostObject *obj = hostObjGet(evfid, HOST_OBJ_EVF);
+
+	if(obj == NULL)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	if(timeout != NULL){
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec  += *timeout / 1000000;
+		ts.tv_nsec += (*timeout % 1000000) * 1000;
+		if(ts.tv_nsec >= 1000000000){
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+	}
+
+	pthread_mutex_lock(&obj->evf.mtx);
+
+	while(hostEvfMatch(&obj->evf, bits, wait, outBits) == 0){
+		if(timeout == NULL){
+			pthread_cond_wait(&obj->evf.cond, &obj->evf.mtx);
+		}else if(pthread_cond_timedwait(&obj->evf.cond, &obj->evf.mtx, &ts) == ETIMEDOUT){
+			res = SCE_KERNEL_ERROR_WAIT_TIMEOUT;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&obj->evf.mtx);
+
+	return res;
+}
+
+/* Fast mutex */
+
+_Static_assert(sizeof(SceKernelLwMutexWork) >= sizeof(pthread_mutex_t), "SceKernelLwMutexWork is too small");
+
+int ksceKernelInitializeFastMutex(void *mutex, const char *name, int unk0, int unk1){
+
+	return pthread_mutex_init((pthread_mutex_t *)mutex, NULL);
+}
+
+int ksceKernelLockFastMutex(void *mutex){
+	return pthread_mutex_lock((pthread_mutex_t *)mutex);
+}
+
+int ksceKernelTryLockFastMutex(void *mutex){
+	return (pthread_mutex_trylock((pthread_mutex_t *)mutex) == 0) ? 0 : SCE_KERNEL_ERROR_EVF_COND;
+}
+
+int ksceKernelUnlockFastMutex(void *mutex){
+	return pthread_mutex_unlock((pthread_mutex_t *)mutex);
+}
+
+int ksceKernelDeleteFastMutex(void *mutex){
+	return pthread_mutex_destroy((pthread_mutex_t *)mutex);
+}
+
+/* Memory */
+
+SceUID ksceKernelAllocMemBlock(const char *name, SceUInt32 type, SceSize size, SceKernelAllocMemBlockKernelOpt *opt){
+
+	SceUID memid;
+	HostObject *obj;
+	void *base;
+
+	if(size == 0 || (size & 0xFFF) != 0)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	if(posix_memalign(&base, 0x1000, size) != 0)
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+
+	memid = hostObjAlloc(HOST_OBJ_MEMBLK, name, &obj);
+	if(memid < 0){
+		free(base);
+		return memid;
+	}
+
+	// ksceKernelFindMemBlockByAddr scans the table under host_obj_mtx
+	pthread_mutex_lock(&host_obj_mtx);
+	obj->memblk.base = base;
+	obj->memblk.size = size;
+	obj->memblk.type = type;
+	pthread_mutex_unlock(&host_obj_mtx);
+
+	return memid;
+}
+
+int ksceKernelFreeMemBlock(SceUID uid){
+
+	HostObject *obj = hostObjGet(uid, HOST_OBJ_MEMBLK);
+
+	if(obj == NULL)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	free(obj->memblk.base);
+	hostObjFree(obj);
+
+	return 0;
+}
+
+int ksceKernelGetMemBlockBase(SceUID uid, void **basep){
+
+	HostObject *obj = hostObjGet(uid, HOST_OBJ_MEMBLK);
+
+	if(obj == NULL)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	*basep = obj->memblk.base;
+
+	return 0;
+}
+
+SceUID ksceKernelFindMemBlockByAddr(const void *addr, SceSize size){
+
+	int i;
+	SceUID res = SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	pthread_mutex_lock(&host_obj_mtx);
+
+	for(i=0;i<HOST_OBJ_MAX;i++){
+		if(host_obj[i].type == HOST_OBJ_MEMBLK
+			&& (const char *)addr >= (const char *)host_obj[i].memblk.base
+			&& (const char *)addr < ((const char *)host_obj[i].memblk.base + host_obj[i].memblk.size)){
+			res = HOST_UID_BASE + (i << 1);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&host_obj_mtx);
+
+	return res;
+}
+
+#define HOST_HEAP_HEADER (0x10)
+
+SceUID ksceKernelCreateHeap(const char *name, SceSize size, SceKernelHeapCreateOpt *opt){
+
+	SceUID uid;
+	HostObject *obj;
+
+	uid = hostObjAlloc(HOST_OBJ_HEAP, name, &obj);
+	if(uid < 0)
+		return uid;
+
+	pthread_mutex_init(&obj->heap.mtx, NULL);
+	obj->heap.size = size;
+	obj->heap.used = 0;
+
+	return uid;
+}
+
+int ksceKernelDeleteHeap(SceUID uid){
+
+	HostObject *obj = hostObjGet(uid, HOST_OBJ_HEAP);
+
+	if(obj == NULL)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	pthread_mutex_destroy(&obj->heap.mtx);
+	hostObjFree(obj);
+
+	return 0;
+}
+
+void *ksceKernelAllocHeapMemory(SceUID uid, SceSize size){
+
+	void *ptr;
+	HostObject *obj = hostObjGet(uid, HOST_OBJ_HEAP);
+
+	// the system heap has no budget
+	if(obj == NULL)
+		return malloc(size);
+
+	pthread_mutex_lock(&obj->heap.mtx);
+
+	if((obj->heap.used + size + HOST_HEAP_HEADER) > obj->heap.size){
+		pthread_mutex_unlock(&obj->heap.mtx);
+		return NULL;
+	}
+
+	ptr = malloc(size + HOST_HEAP_HEADER);
+	if(ptr != NULL){
+		*(SceSize *)ptr = size + HOST_HEAP_HEADER;
+		obj->heap.used += size + HOST_HEAP_HEADER;
+		ptr += HOST_HEAP_HEADER;
+	}
+
+	pthread_mutex_unlock(&obj->heap.mtx);
+
+	return ptr;
+}
+
+void ksceKernelFreeHeapMemory(SceUID uid, void *ptr){
+
+	HostObject *obj = hostObjGet(uid, HOST_OBJ_HEAP);
+
+	if(obj == NULL){
+		free(ptr);
+		return;
+	}
+
+	if(ptr == NULL)
+		return;
+
+	ptr -= HOST_HEAP_HEADER;
+
+	pthread_mutex_lock(&obj->heap.mtx);
+	obj->heap.used -= *(SceSize *)ptr;
+	pthread_mutex_unlock(&obj->heap.mtx);
+
+	free(ptr);
+}
+
+/*
+ * The DMAC is simulated by a copy on the calling thread, which blocks until its transfer finished.
+ * Each caller works like on a channel of its own, so RW workers copying at once are not serialised.
+ */
+void *ksceDmacMemcpy(void *dst, const void *src, SceSize size){
+	return memcpy(dst, src, size);
+}
+
+void *ksceDmacMemset(void *dst, int c, SceSize size){
+	return memset(dst, c, size);
+}
+
+int ksceDebugPrintf(const char *fmt, ...){
+
+	int res;
+	va_list args;
+
+	va_start(args, fmt);
+	res = vfprintf(stderr, fmt, args);
+	va_end(args);
+
+	return res;
+}
+
+SceUID ksceKernelSearchModuleByName(const char *name){
+	return SCE_KERNEL_ERROR_UNKNOWN_UID;
+}
+
+/* Io */
+
+int vmassHostSetRoot(const char *root){
+
+	if(root == NULL)
+		return -1;
+
+	strncpy(host_root, root, sizeof(host_root) - 1);
+
+	return 0;
+}
+
+static int hostIoPathAppend(char *path, SceSize size, SceSize len, const char *str, SceSize str_len){
+
+	if((len + str_len) >= size)
+		return -1;
+
+	memcpy(path + len, str, str_len);
+	path[len + str_len] = 0;
+
+	return len + str_len;
+}
+
+static int hostIoPath(const char *file, char *path, SceSize size){
+
+	int len;
+	const char *root = host_root, *sep;
+
+	if(root[0] == 0){
+		root = getenv("VMASS_HOST_ROOT");
+		if(root == NULL)
+			root = "vmass_host";
+	}
+
+	len = hostIoPathAppend(path, size, 0, root, strlen(root));
+	if(len < 0)
+		return len;
+
+	mkdir(path, 0777);
+
+	sep = strchr(file, ':');
+	if(sep != NULL){
+		len = hostIoPathAppend(path, size, len, "/", 1);
+		if(len >= 0)
+			len = hostIoPathAppend(path, size, len, file, sep - file);
+		if(len < 0)
+			return len;
+
+		mkdir(path, 0777);
+		file = sep + 1;
+	}
+
+	len = hostIoPathAppend(path, size, len, "/", 1);
+	if(len >= 0)
+		len = hostIoPathAppend(path, size, len, file, strlen(file));
+
+	return len;
+}
+
+static int hostErrno(void){
+
+	switch(errno){
+	case ENOENT:
+		return SCE_ERROR_ERRNO_ENOENT;
+	case EBADF:
+		return SCE_ERROR_ERRNO_EBADF;
+	case EINVAL:
+		return SCE_ERROR_ERRNO_EINVAL;
+	default:
+		return SCE_ERROR_ERRNO_EIO;
+	}
+}
+
+static int hostFd(SceUID fd){
+
+	HostObject *obj = hostObjGet(fd, HOST_OBJ_FILE);
+
+	return (obj == NULL) ? -1 : obj->fd;
+}
+
+SceUID ksceIoOpen(const char *file, int flags, int mode){
+
+	int oflags = 0, fd;
+	char path[0x400];
+	SceUID uid;
+	HostObject *obj;
+
+	switch(flags & SCE_O_RDWR){
+	case SCE_O_RDONLY:
+		oflags = O_RDONLY;
+		break;
+	case SCE_O_WRONLY:
+		oflags = O_WRONLY;
+		break;
+	default:
+		oflags = O_RDWR;
+		break;
+	}
+
+	if((flags & SCE_O_APPEND) != 0)
+		oflags |= O_APPEND;
+	if((flags & SCE_O_CREAT) != 0)
+		oflags |= O_CREAT;
+	if((flags & SCE_O_TRUNC) != 0)
+		oflags |= O_TRUNC;
+	if((flags & SCE_O_EXCL) != 0)
+		oflags |= O_EXCL;
+
+	if(hostIoPath(file, path, sizeof(path)) < 0)
+		return SCE_ERROR_ERRNO_EINVAL;
+
+	fd = open(path, oflags, mode);
+	if(fd < 0)
+		return hostErrno();
+
+	uid = hostObjAlloc(HOST_OBJ_FILE, file, &obj);
+	if(uid < 0){
+		close(fd);
+		return uid;
+	}
+
+	obj->fd = fd;
+
+	return uid;
+}
+
+int ksceIoClose(SceUID fd){
+
+	HostObject *obj = hostObjGet(fd, HOST_OBJ_FILE);
+
+	if(obj == NULL)
+		return SCE_ERROR_ERRNO_EBADF;
+
+	close(obj->fd);
+	hostObjFree(obj);
+
+	return 0;
+}
+
+int ksceIoRead(SceUID fd, void *data, SceSize size){
+
+	ssize_t res = read(hostFd(fd), data, size);
+
+	return (res < 0) ? hostErrno() : (int)res;
+}
+
+int ksceIoWrite(SceUID fd, const void *data, SceSize size){
+
+	ssize_t res = write(hostFd(fd), data, size);
+
+	return (res < 0) ? hostErrno() : (int)res;
+}
+
+int ksceIoPread(SceUID fd, void *data, SceSize size, SceOff offset){
+
+	ssize_t res = pread(hostFd(fd), data, size, offset);
+
+	return (res < 0) ? hostErrno() : (int)res;
+}
+
+int ksceIoPwrite(SceUID fd, const void *data, SceSize size, SceOff offset){
+
+	ssize_t res = pwrite(hostFd(fd), data, size, offset);
+
+	return (res < 0) ? hostErrno() : (int)res;
+}
+
+SceOff ksceIoLseek(SceUID fd, SceOff offset, int whence){
+
+	off_t res = lseek(hostFd(fd), offset, (whence == SCE_SEEK_SET) ? SEEK_SET : (whence == SCE_SEEK_CUR) ? SEEK_CUR : SEEK_END);
+
+	return (res < 0) ? hostErrno() : (SceOff)res;
+}
+
+int ksceIoRemove(const char *file){
+
+	char path[0x400];
+
+	if(hostIoPath(file, path, sizeof(path)) < 0)
+		return SCE_ERROR_ERRNO_EINVAL;
+
+	return (unlink(path) < 0) ? hostErrno() : 0;
+}
+
+int ksceIoRename(const char *oldname, const char *newname){
+
+	char oldpath[0x400], newpath[0x400];
+
+	if(hostIoPath(oldname, oldpath, sizeof(oldpath)) < 0 || hostIoPath(newname, newpath, sizeof(newpath)) < 0)
+		return SCE_ERROR_ERRNO_EINVAL;
+
+	return (rename(oldpath, newpath) < 0) ? hostErrno() : 0;
+}
+
+int ksceIoSync(const char *device, unsigned int unk){
+	sync();
+	return 0;
+}
+
+int ksceIoSyncByFd(SceUID fd){
+	return (fsync(hostFd(fd)) < 0) ? hostErrno() : 0;
+}
+
+static void hostStatConvert(const struct stat *st, SceIoStat *stat){
+	memset(stat, 0, sizeof(*stat));
+	stat->st_mode = st->st_mode;
+	stat->st_size = st->st_size;
+}
+
+int ksceIoGetstat(const char *file, SceIoStat *stat){
+
+	char path[0x400];
+	struct stat st;
+
+	if(hostIoPath(file, path, sizeof(path)) < 0)
+		return SCE_ERROR_ERRNO_EINVAL;
+
+	if(lstat(path, &st) < 0)
+		return hostErrno();
+
+	hostStatConvert(&st, stat);
+
+	return 0;
+}
+
+int ksceIoGetstatByFd(SceUID fd, SceIoStat *stat){
+
+	struct stat st;
+
+	if(fstat(hostFd(fd), &st) < 0)
+		return hostErrno();
+
+	hostStatConvert(&st, stat);
+
+	return 0;
+}
+
+int ksceIoChstatByFd(SceUID fd, const SceIoStat *stat, unsigned int bits){
+
+	if((bits & SCE_CST_SIZE) != 0 && ftruncate(hostFd(fd), stat->st_size) < 0)
+		return hostErrno();
+
+	return 0;
+}
+
+int ksceIoMount(int id, const char *path, int permission, int a4, int a5, int a6){
+	return 0;
+}
+
+int ksceIoUmount(int id, int force, int a3, int a4){
+	return 0;
+}
+
+/* Syscon / SysEvent */
+
+int vmassHostSetControls(SceUInt32 ctrl){
+	host_ctrl = ctrl;
+	return 0;
+}
+
+int ksceSysconGetControlsInfo(SceUInt32 *ctrl){
+	*ctrl = host_ctrl;
+	return 0;
+}
+
+SceUID ksceKernelRegisterSysEventHandler(const char *name, SceSysEventCallback cb, void *argp){
+
+	SceUID uid;
+	HostObject *obj;
+
+	uid = hostObjAlloc(HOST_OBJ_SYSEVT, name, &obj);
+	if(uid < 0)
+		return uid;
+
+	obj->sysevt.cb   = cb;
+	obj->sysevt.argp = argp;
+
+	return uid;
+}
+
+int ksceKernelUnregisterSysEventHandler(SceUID id){
+
+	HostObject *obj = hostObjGet(id, HOST_OBJ_SYSEVT);
+
+	if(obj == NULL)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	hostObjFree(obj);
+
+	return 0;
+}
+
+int vmassHostSysEvent(int resume, int eventid, void *args, void *opt){
+
+	int i;
+
+	for(i=0;i<HOST_OBJ_MAX;i++){
+		if(host_obj[i].type == HOST_OBJ_SYSEVT)
+			host_obj[i].sysevt.cb(resume, eventid, args, opt);
+	}
+
+	return 0;
+}
+
+int vmassHostPowerOff(int hold_start){
+
+	int eventid, args[2] = {0x18, SCE_SYS_EVENT_STATE_POWEROFF};
+	SceUInt32 ctrl = host_ctrl;
+
+	host_ctrl = (hold_start != 0) ? (ctrl & ~SCE_SYSCON_CTRL_START) : (ctrl | SCE_SYSCON_CTRL_START);
+
+	for(eventid=0x201;eventid<=0x204;eventid++)
+		vmassHostSysEvent(0, eventid, args, NULL);
+
+	host_ctrl = ctrl;
+
+	return 0;
+}
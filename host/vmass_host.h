@@ -0,0 +1,42 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Host Shim Header
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VMASS_HOST_H_
+#define _VMASS_HOST_H_
+
+#include <psp2kern/types.h>
+
+/*
+ * Device paths such as "sd0:vmass.img" are mapped to "<root>/sd0/vmass.img".
+ * The root defaults to $VMASS_HOST_ROOT, or "vmass_host" in the current directory.
+ */
+int vmassHostSetRoot(const char *root);
+
+/*
+ * Controls reported by ksceSysconGetControlsInfo. Bits are active low like on the console.
+ */
+int vmassHostSetControls(SceUInt32 ctrl);
+
+/*
+ * Deliver a system event to every handler registered with ksceKernelRegisterSysEventHandler.
+ */
+int vmassHostSysEvent(int resume, int eventid, void *args, void *opt);
+
+/*
+ * Deliver the phases 0x201 to 0x204 of the power-off event, optionally with START held.
+ */
+int vmassHostPowerOff(int hold_start);
+
+#endif	/* _VMASS_HOST_H_ */
@@ -0,0 +1,506 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Image Converter
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "vmass.h"
+#include "vmass_host.h"
+#include "vmass_image.h"
+#include "vmass_lz.h"
+
+typedef struct ImgBuffer {
+	unsigned char *data;
+	size_t size;
+} ImgBuffer;
+
+static int imgReadFile(const char *path, ImgBuffer *buf){
+
+	FILE *fp;
+	long size;
+
+	fp = fopen(path, "rb");
+	if(fp == NULL){
+		perror(path);
+		return -1;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	buf->size = size;
+	buf->data = malloc(size + 1);
+
+	if(buf->data == NULL || fread(buf->data, 1, size, fp) != (size_t)size){
+		fprintf(stderr, "%s: read failed\n", path);
+		fclose(fp);
+		return -1;
+	}
+
+	fclose(fp);
+
+	return 0;
+}
+
+static int imgWriteFile(const char *path, const ImgBuffer *buf){
+
+	FILE *fp;
+
+	fp = fopen(path, "wb");
+	if(fp == NULL){
+		perror(path);
+		return -1;
+	}
+
+	if(fwrite(buf->data, 1, buf->size, fp) != buf->size){
+		fprintf(stderr, "%s: write failed\n", path);
+		fclose(fp);
+		return -1;
+	}
+
+	fclose(fp);
+
+	return 0;
+}
+
+static int imgIsPartial(const ImgBuffer *img){
+	return img->size >= sizeof(VmassImageHeader) && ((const VmassImageHeader *)img->data)->magic == VMASS_IMAGE_MAGIC_PARTIAL;
+}
+
+static int imgIsSparse(const ImgBuffer *img){
+	return img->size >= sizeof(VmassImageHeader) && ((const VmassImageHeader *)img->data)->magic == VMASS_IMAGE_MAGIC;
+}
+
+static int imgIsZero(const unsigned char *data, size_t size){
+
+	size_t i;
+
+	for(i=0;i<size;i++){
+		if(data[i] != 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Expand any image to the raw storage it holds, checking the sparse layout the same way vmassLoadImage does.
+ */
+static int imgDecode(const ImgBuffer *img, ImgBuffer *raw){
+
+	SceUInt32 i;
+	SceUInt64 prev_end = 0, prev_offset = VMASS_IMAGE_DATA_OFFSET, all_sector, data_end, data_size;
+	VmassImageHeader header;
+	const VmassImageExtent *extent;
+	const VmassImageBlock *block;
+
+	if(imgIsPartial(img)){
+		fprintf(stderr, "image of an interrupted save\n");
+		return -1;
+	}
+
+	if(imgIsSparse(img) == 0){
+		raw->size = img->size;
+		raw->data = malloc(img->size + 1);
+		memcpy(raw->data, img->data, img->size);
+		return 0;
+	}
+
+	memcpy(&header, img->data, sizeof(header));
+
+	if(header.version > VMASS_IMAGE_VERSION || header.header_size < sizeof(header) || (header.flags & ~VMASS_IMAGE_FLAG_LZ) != 0){
+		fprintf(stderr, "unsupported sparse image (version %u flags 0x%X)\n", header.version, header.flags);
+		return -1;
+	}
+
+	if(header.storage_size == 0 || (header.storage_size & 0x1FF) != 0 || header.extent_offset > img->size
+		|| header.extent_num > ((img->size - header.extent_offset) / sizeof(VmassImageExtent))){
+		fprintf(stderr, "corrupted sparse image header\n");
+		return -1;
+	}
+
+	all_sector = header.storage_size >> 9;
+
+	raw->size = header.storage_size;
+	raw->data = calloc(1, raw->size);
+	if(raw->data == NULL)
+		return -1;
+
+	extent = (const VmassImageExtent *)(img->data + header.extent_offset);
+
+	for(i=0;i<header.extent_num;i++){
+		if((header.flags & VMASS_IMAGE_FLAG_LZ) != 0){
+			data_end  = (i + 1 < header.extent_num) ? extent[i + 1].file_offset : header.extent_offset;
+			data_size = (data_end > extent[i].file_offset) ? (data_end - extent[i].file_offset) : 0;
+		}else{
+			data_end  = header.extent_offset;
+			data_size = (SceUInt64)extent[i].sector_num << 9;
+		}
+
+		if(extent[i].sector_num == 0 || extent[i].sector_pos < prev_end || extent[i].sector_pos >= all_sector
+			|| extent[i].sector_num > (all_sector - extent[i].sector_pos)
+			|| extent[i].file_offset < prev_offset || (extent[i].file_offset + data_size) > data_end){
+			fprintf(stderr, "corrupted extent %u\n", i);
+			return -1;
+		}
+
+		if((header.flags & VMASS_IMAGE_FLAG_LZ) == 0){
+			memcpy(raw->data + ((SceUInt64)extent[i].sector_pos << 9), img->data + extent[i].file_offset, data_size);
+		}else{
+			block = (const VmassImageBlock *)(img->data + extent[i].file_offset);
+
+			if((extent[i].sector_pos / (VMASS_IMAGE_BLOCK_SIZE >> 9)) != ((extent[i].sector_pos + extent[i].sector_num - 1) / (VMASS_IMAGE_BLOCK_SIZE >> 9))
+				|| data_size < sizeof(*block) || block->comp_size != (data_size - sizeof(*block))){
+				fprintf(stderr, "corrupted block %u\n", i);
+				return -1;
+			}
+
+			if(block->comp_size == (extent[i].sector_num << 9)){
+				memcpy(raw->data + ((SceUInt64)extent[i].sector_pos << 9), &block[1], block->comp_size);
+			}else if(vmassLzDecompress(raw->data + ((SceUInt64)extent[i].sector_pos << 9), extent[i].sector_num << 9, &block[1], block->comp_size) != (extent[i].sector_num << 9)){
+				fprintf(stderr, "corrupted block %u\n", i);
+				return -1;
+			}
+		}
+
+		prev_end    = extent[i].sector_pos + extent[i].sector_num;
+		prev_offset = extent[i].file_offset + data_size;
+	}
+
+	return 0;
+}
+
+/*
+ * Build the sparse image of raw storage with the layout vmassCreateImage writes: runs of non-zero extent units
+ * that do not cross a VMASS_IMAGE_BLOCK_SIZE window, merged across windows unless they are LZ blocks.
+ */
+static int imgEncode(const ImgBuffer *raw, ImgBuffer *img, SceUInt32 flags){
+
+	int comp_size;
+	SceUInt32 extent_num = 0, extent_max = 0x40;
+	SceUInt64 sector_pos, run_end, window_end, unit_num, all_sector = raw->size >> 9, data_size = 0;
+	VmassImageExtent *extent;
+	VmassImageHeader *header;
+	VmassImageBlock *block;
+	void *work;
+
+	if(raw->size == 0 || (raw->size & 0x1FF) != 0){
+		fprintf(stderr, "raw image size 0x%zX is not a multiple of the sector size\n", raw->size);
+		return -1;
+	}
+
+	// every block can grow by its header
+	img->data = calloc(1, VMASS_IMAGE_DATA_OFFSET + raw->size * 2);
+	extent    = malloc(extent_max * sizeof(VmassImageExtent));
+	work      = malloc(VMASS_LZ_WORK_SIZE);
+
+	for(sector_pos=0;sector_pos<all_sector;sector_pos=run_end){
+		run_end    = sector_pos;
+		unit_num   = 0;
+		window_end = (sector_pos + (VMASS_IMAGE_BLOCK_SIZE >> 9)) & ~((VMASS_IMAGE_BLOCK_SIZE >> 9) - 1);
+		if(window_end > all_sector)
+			window_end = all_sector;
+
+		while(run_end < window_end){
+			unit_num = window_end - run_end;
+			if(unit_num > (VMASS_IMAGE_EXTENT_UNIT >> 9))
+				unit_num = VMASS_IMAGE_EXTENT_UNIT >> 9;
+
+			if(imgIsZero(raw->data + (run_end << 9), unit_num << 9))
+				break;
+
+			run_end += unit_num;
+		}
+
+		if(run_end == sector_pos){
+			run_end += unit_num;
+			continue;
+		}
+
+		if(extent_num != 0 && (flags & VMASS_IMAGE_FLAG_LZ) == 0
+			&& (extent[extent_num - 1].sector_pos + extent[extent_num - 1].sector_num) == sector_pos){
+			extent[extent_num - 1].sector_num += run_end - sector_pos;
+		}else{
+			if(extent_num == extent_max){
+				extent_max <<= 1;
+				extent = realloc(extent, extent_max * sizeof(VmassImageExtent));
+			}
+
+			extent[extent_num].sector_pos  = sector_pos;
+			extent[extent_num].sector_num  = run_end - sector_pos;
+			extent[extent_num].file_offset = VMASS_IMAGE_DATA_OFFSET + data_size;
+			extent_num++;
+		}
+
+		if((flags & VMASS_IMAGE_FLAG_LZ) == 0){
+			memcpy(img->data + VMASS_IMAGE_DATA_OFFSET + data_size, raw->data + (sector_pos << 9), (run_end - sector_pos) << 9);
+			data_size += (run_end - sector_pos) << 9;
+			continue;
+		}
+
+		block = (VmassImageBlock *)(img->data + VMASS_IMAGE_DATA_OFFSET + data_size);
+
+		comp_size = vmassLzCompress(&block[1], ((run_end - sector_pos) << 9) - 1, raw->data + (sector_pos << 9), (run_end - sector_pos) << 9, work);
+		if(comp_size < 0){
+			comp_size = (run_end - sector_pos) << 9;
+			memcpy(&block[1], raw->data + (sector_pos << 9), comp_size);
+		}
+
+		block->comp_size = comp_size;
+		data_size += sizeof(*block) + comp_size;
+	}
+
+	free(work);
+
+	img->size = VMASS_IMAGE_DATA_OFFSET + data_size + extent_num * sizeof(VmassImageExtent);
+	img->data = realloc(img->data, img->size);
+
+	memcpy(img->data + VMASS_IMAGE_DATA_OFFSET + data_size, extent, extent_num * sizeof(VmassImageExtent));
+	free(extent);
+
+	header = (VmassImageHeader *)img->data;
+	header->magic         = VMASS_IMAGE_MAGIC;
+	header->version       = VMASS_IMAGE_VERSION;
+	header->header_size   = sizeof(VmassImageHeader);
+	header->flags         = flags;
+	header->extent_num    = extent_num;
+	header->storage_size  = raw->size;
+	header->extent_offset = VMASS_IMAGE_DATA_OFFSET + data_size;
+	header->data_size     = data_size;
+
+	return 0;
+}
+
+static int imgInfo(const ImgBuffer *img){
+
+	const VmassImageHeader *header = (const VmassImageHeader *)img->data;
+
+	if(imgIsPartial(img)){
+		printf("partial image of an interrupted save, file 0x%zX bytes\n", img->size);
+		return 0;
+	}
+
+	if(imgIsSparse(img) == 0){
+		printf("raw image, storage 0x%zX bytes\n", img->size);
+		return 0;
+	}
+
+	printf("%s image v%u, storage 0x%llX bytes, %u extents, data 0x%llX bytes, file 0x%zX bytes\n",
+		((header->flags & VMASS_IMAGE_FLAG_LZ) != 0) ? "lz" : "sparse", header->version, (unsigned long long)header->storage_size, header->extent_num,
+		(unsigned long long)header->data_size, img->size);
+
+	return 0;
+}
+
+/*
+ * Save the storage in full in the given format and compare what was written with raw.
+ */
+static int imgVerifySave(const char *path, const char *image_path, int format, const ImgBuffer *raw){
+
+	int res;
+	ImgBuffer saved, saved_raw;
+	VmassImageIoStat stat;
+
+	// a dirty storage without its image file is saved in full
+	vmassWriteSector(0, raw->data, 1);
+	unlink(image_path);
+
+	vmassSetImageFormat(format);
+
+	res = vmassCreateImage();
+	if(res < 0){
+		fprintf(stderr, "vmassCreateImage failed 0x%X\n", res);
+		return -1;
+	}
+
+	if(imgReadFile(image_path, &saved) < 0 || imgIsSparse(&saved) == 0 || imgDecode(&saved, &saved_raw) < 0)
+		return -1;
+
+	if(saved_raw.size != raw->size || memcmp(saved_raw.data, raw->data, raw->size) != 0){
+		fprintf(stderr, "%s: engine save mismatch\n", path);
+		return -1;
+	}
+
+	vmassGetImageIoStat(&stat);
+
+	printf("%s: engine %s save ok, 0x%zX bytes in %llu us\n", path, (format == VMASS_IMAGE_LZ) ? "lz" : "sparse", saved.size,
+		(unsigned long long)stat.last_save_time);
+
+	free(saved.data);
+	free(saved_raw.data);
+
+	return 0;
+}
+
+/*
+ * Run the image through the engine: load it, compare the storage, then save it in full in each format and compare that too.
+ */
+static int imgVerifyEngine(const char *path, const ImgBuffer *img, const ImgBuffer *raw){
+
+	char root[] = "/tmp/vmass_imgconv.XXXXXX", image_path[0x100];
+	unsigned char sector[0x200];
+	int res;
+	SceSize sector_pos;
+	SceUsbMassDevInfo info;
+	VmassImageIoStat stat;
+
+	if(mkdtemp(root) == NULL){
+		perror("mkdtemp");
+		return -1;
+	}
+
+	snprintf(image_path, sizeof(image_path), "%s/sd0", root);
+	mkdir(image_path, 0777);
+	snprintf(image_path, sizeof(image_path), "%s/sd0/vmass.img", root);
+
+	if(imgWriteFile(image_path, img) < 0)
+		return -1;
+
+	vmassHostSetRoot(root);
+
+	res = vmassInit();
+	if(res < 0){
+		fprintf(stderr, "vmassInit failed 0x%X\n", res);
+		return -1;
+	}
+
+	vmassGetDevInfo(&info);
+
+	if(((SceUInt64)info.number_of_all_sector << 9) != raw->size){
+		printf("%s: engine skipped, storage is 0x%llX bytes\n", path, (unsigned long long)info.number_of_all_sector << 9);
+		goto remove;
+	}
+
+	for(sector_pos=0;sector_pos<info.number_of_all_sector;sector_pos++){
+		vmassReadSector(sector_pos, sector, 1);
+
+		if(memcmp(sector, raw->data + ((SceUInt64)sector_pos << 9), sizeof(sector)) != 0){
+			fprintf(stderr, "%s: engine load mismatch at sector 0x%X\n", path, sector_pos);
+			return -1;
+		}
+	}
+
+	vmassGetImageIoStat(&stat);
+
+	printf("%s: engine load ok in %llu us, read 0x%llX bytes\n", path, (unsigned long long)stat.last_load_time, (unsigned long long)stat.read_bytes);
+
+	if(imgVerifySave(path, image_path, VMASS_IMAGE_SPARSE, raw) < 0 || imgVerifySave(path, image_path, VMASS_IMAGE_LZ, raw) < 0)
+		return -1;
+
+remove:
+	unlink(image_path);
+	snprintf(image_path, sizeof(image_path), "%s/sd0", root);
+	rmdir(image_path);
+	rmdir(root);
+
+	return 0;
+}
+
+/*
+ * image -> raw -> sparse or lz -> raw must give back the same storage.
+ */
+static int imgVerifyFormat(const char *path, const ImgBuffer *raw, SceUInt32 flags){
+
+	ImgBuffer img, raw2;
+
+	if(imgEncode(raw, &img, flags) < 0 || imgDecode(&img, &raw2) < 0)
+		return -1;
+
+	if(raw->size != raw2.size || memcmp(raw->data, raw2.data, raw->size) != 0){
+		fprintf(stderr, "%s: round trip mismatch\n", path);
+		return -1;
+	}
+
+	printf("%s: %s round trip ok, raw 0x%zX bytes, image 0x%zX bytes\n", path, (flags != 0) ? "lz" : "sparse", raw->size, img.size);
+
+	free(img.data);
+	free(raw2.data);
+
+	return 0;
+}
+
+static int imgVerify(const char *path, const ImgBuffer *img){
+
+	ImgBuffer raw;
+
+	if(imgDecode(img, &raw) < 0)
+		return -1;
+
+	if(imgVerifyFormat(path, &raw, 0) < 0 || imgVerifyFormat(path, &raw, VMASS_IMAGE_FLAG_LZ) < 0)
+		return -1;
+
+	if(imgVerifyEngine(path, img, &raw) < 0)
+		return -1;
+
+	free(raw.data);
+
+	return 0;
+}
+
+static void imgUsage(const char *name){
+	fprintf(stderr, "usage: %s info <image>\n", name);
+	fprintf(stderr, "       %s sparse <image> <output>\n", name);
+	fprintf(stderr, "       %s lz <image> <output>\n", name);
+	fprintf(stderr, "       %s raw <image> <output>\n", name);
+	fprintf(stderr, "       %s verify <image>\n", name);
+}
+
+int main(int argc, char *argv[]){
+
+	ImgBuffer img, out, raw;
+
+	if(argc < 3){
+		imgUsage(argv[0]);
+		return 1;
+	}
+
+	if(imgReadFile(argv[2], &img) < 0)
+		return 1;
+
+	if(strcmp(argv[1], "info") == 0)
+		return (imgInfo(&img) < 0) ? 1 : 0;
+
+	if(strcmp(argv[1], "verify") == 0)
+		return (imgVerify(argv[2], &img) < 0) ? 1 : 0;
+
+	if(argc < 4 || (strcmp(argv[1], "sparse") != 0 && strcmp(argv[1], "lz") != 0 && strcmp(argv[1], "raw") != 0)){
+		imgUsage(argv[0]);
+		return 1;
+	}
+
+	if(imgDecode(&img, &raw) < 0)
+		return 1;
+
+	if(strcmp(argv[1], "sparse") == 0){
+		if(imgEncode(&raw, &out, 0) < 0)
+			return 1;
+	}else if(strcmp(argv[1], "lz") == 0){
+		if(imgEncode(&raw, &out, VMASS_IMAGE_FLAG_LZ) < 0)
+			return 1;
+	}else{
+		out = raw;
+	}
+
+	if(imgWriteFile(argv[3], &out) < 0)
+		return 1;
+
+	printf("%s -> %s (0x%zX bytes)\n", argv[2], argv[3], out.size);
+
+	return 0;
+}
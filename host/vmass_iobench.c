@@ -0,0 +1,402 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Sector I/O Benchmark Suite
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "vmass.h"
+#include "vmass_host.h"
+#include "vmass_internal.h"
+#include "vmass_page.h"
+
+/*
+ * Sweeps vmassReadSector/vmassWriteSector over request size, buffer alignment and start offset for each page layout.
+ * vmassInit runs once per process, so every layout is measured in a child process and the results come back
+ * through shared memory.
+ */
+#define IOBENCH_CAPACITY   (0x2000000)
+#define IOBENCH_PAGE_SECTOR (0x80) // 64KiB, the thin page and the cluster alignment of a formatted uma0:
+#define IOBENCH_RESULT_MAX (0x400)
+#define IOBENCH_ROUND_NUM  (5)
+
+#define IOBENCH_FORMAT_TABLE (0)
+#define IOBENCH_FORMAT_CSV   (1)
+#define IOBENCH_FORMAT_JSON  (2)
+
+typedef struct IoBenchLayout {
+	const char *name;
+	int thin;
+	VmassStorageMemtype memtype[2];
+	SceSize memtype_num;
+} IoBenchLayout;
+
+/*
+ * thin:  64KiB pages, found by shift
+ * block: 16MiB memblocks, found by shift
+ * split: a 3MiB block then 16MiB ones, found by binary search
+ */
+static const IoBenchLayout iobench_layout[] = {
+	{"thin",  1, {{0x1080D006, 0}},                        1},
+	{"block", 0, {{0x1080D006, 0}},                        1},
+	{"split", 0, {{0x1080D006, 0x300000}, {0x40404006, 0}}, 2}
+};
+
+static const SceSize iobench_sector[] = {
+	0x1, 0x8, 0x20, 0x80, 0x100, 0x400, 0x1000, 0x2000
+};
+
+static const SceSize iobench_sector_quick[] = {
+	0x1, 0x8, 0x80, 0x400
+};
+
+// byte offset of the data buffer from a cache line
+static const SceSize iobench_align[] = {
+	0x0, 0x4, 0x1
+};
+
+// sector offset of each request from a 64KiB boundary, IOBENCH_PAGE_SECTOR - 1 makes every request longer than a sector cross one
+static const SceSize iobench_start[] = {
+	0x0, IOBENCH_PAGE_SECTOR - 1
+};
+
+typedef struct IoBenchResult {
+	char layout[8];
+	char op[8];
+	SceSize sector_num;
+	SceSize align;
+	SceSize start;
+	SceSize count;
+	double mbps;
+	double avg_us;
+	double min_us;
+	double max_us;
+} IoBenchResult;
+
+typedef struct IoBenchShared {
+	SceSize num;
+	IoBenchResult result[IOBENCH_RESULT_MAX];
+} IoBenchShared;
+
+typedef int (* IoBenchOp)(SceSize sector_pos, void *data, SceSize sector_num);
+
+static int iobench_quick;
+
+static SceInt64 iobenchGetTimeNs(void){
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((SceInt64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static int iobenchWriteSector(SceSize sector_pos, void *data, SceSize sector_num){
+	return vmassWriteSector(sector_pos, data, sector_num);
+}
+
+/*
+ * The MB/s and average are those of the fastest of IOBENCH_ROUND_NUM rounds, which keeps scheduler noise out of a
+ * regression gate. min and max cover every round.
+ */
+static int iobenchRun(IoBenchResult *result, IoBenchOp op, SceSize all_sector, void *data){
+
+	int res, round;
+	SceSize i, count, step, span, sector_pos;
+	SceInt64 time_s, lat, lat_min = -1, lat_max = 0, total, best = -1;
+
+	// whole 64KiB steps, so every request starts at the same offset from a boundary
+	step = (result->sector_num + IOBENCH_PAGE_SECTOR - 1) & ~(IOBENCH_PAGE_SECTOR - 1);
+	span = ((all_sector - result->start - result->sector_num) / step) * step;
+
+	count = ((iobench_quick != 0) ? 0x400000 : 0x1000000) / (result->sector_num << 9);
+	if(count < 0x40)
+		count = 0x40;
+
+	for(round=0;round<IOBENCH_ROUND_NUM;round++){
+		total = 0;
+
+		for(i=0;i<count;i++){
+			sector_pos = ((i * step) % span) + result->start;
+
+			time_s = iobenchGetTimeNs();
+			res = op(sector_pos, data, result->sector_num);
+			lat = iobenchGetTimeNs() - time_s;
+
+			if(res < 0){
+				fprintf(stderr, "%s failed at sector 0x%08X:0x%X (0x%X)\n", result->op, sector_pos, result->sector_num, res);
+				return res;
+			}
+
+			total += lat;
+			if(lat_min < 0 || lat < lat_min)
+				lat_min = lat;
+			if(lat > lat_max)
+				lat_max = lat;
+		}
+
+		if(best < 0 || total < best)
+			best = total;
+	}
+
+	result->count  = count;
+	result->mbps   = ((double)(result->sector_num << 9) * count) / ((double)best / 1000000000.0) / 1000000.0;
+	result->avg_us = (double)best / count / 1000.0;
+	result->min_us = (double)lat_min / 1000.0;
+	result->max_us = (double)lat_max / 1000.0;
+
+	return 0;
+}
+
+static int iobenchLayout(const IoBenchLayout *layout, IoBenchShared *shared){
+
+	int res;
+	SceSize i, a, s, o, sector_num, sector_max, size_num;
+	const SceSize *size_list;
+	void *buf;
+	IoBenchResult *result;
+	SceUsbMassDevInfo info;
+
+	size_list = (iobench_quick != 0) ? iobench_sector_quick : iobench_sector;
+	size_num  = (iobench_quick != 0) ? (sizeof(iobench_sector_quick) / sizeof(iobench_sector_quick[0]))
+		: (sizeof(iobench_sector) / sizeof(iobench_sector[0]));
+
+	vmass_thin_provision = layout->thin;
+
+	vmassSetStorageCapacity(IOBENCH_CAPACITY, layout->memtype, layout->memtype_num);
+
+	res = vmassInit();
+	if(res < 0){
+		fprintf(stderr, "%s: vmassInit failed 0x%X\n", layout->name, res);
+		return res;
+	}
+
+	vmassGetDevInfo(&info);
+
+	sector_max = size_list[size_num - 1];
+
+	buf = aligned_alloc(0x40, (sector_max << 9) + 0x40);
+	if(buf == NULL)
+		return -1;
+
+	memset(buf, 0xA5, (sector_max << 9) + 0x40);
+
+	// back every page first, so the writes measure steady state rather than the first touch
+	for(i=0;i<info.number_of_all_sector;i+=sector_num){
+		sector_num = info.number_of_all_sector - i;
+		if(sector_num > sector_max)
+			sector_num = sector_max;
+
+		res = vmassWriteSector(i, buf, sector_num);
+		if(res < 0)
+			goto end;
+	}
+
+	for(o=0;o<2;o++){
+		for(s=0;s<size_num;s++){
+			sector_num = size_list[s];
+
+			for(a=0;a<(sizeof(iobench_align) / sizeof(iobench_align[0]));a++){
+				if(iobench_quick != 0 && iobench_align[a] == 0x1)
+					continue;
+
+				for(i=0;i<(sizeof(iobench_start) / sizeof(iobench_start[0]));i++){
+					if(shared->num == IOBENCH_RESULT_MAX)
+						goto end;
+
+					result = &shared->result[shared->num];
+					memset(result, 0, sizeof(*result));
+
+					snprintf(result->layout, sizeof(result->layout), "%s", layout->name);
+					snprintf(result->op, sizeof(result->op), "%s", (o == 0) ? "write" : "read");
+					result->sector_num = sector_num;
+					result->align      = iobench_align[a];
+					result->start      = iobench_start[i];
+
+					res = iobenchRun(result, (o == 0) ? iobenchWriteSector : vmassReadSector, info.number_of_all_sector, buf + iobench_align[a]);
+					if(res < 0)
+						goto end;
+
+					shared->num++;
+				}
+			}
+		}
+	}
+
+end:
+	free(buf);
+
+	return res;
+}
+
+static void iobenchPrint(const IoBenchShared *shared, int format){
+
+	SceSize i;
+	const IoBenchResult *r;
+
+	if(format == IOBENCH_FORMAT_CSV)
+		printf("layout,op,sector_num,align,start,count,mbps,avg_us,min_us,max_us\n");
+	else if(format == IOBENCH_FORMAT_JSON)
+		printf("[\n");
+	else
+		printf("%-6s %-5s %6s %5s %5s %8s %10s %10s %10s %10s\n", "layout", "op", "sector", "align", "start", "count", "MB/s", "avg(us)", "min(us)", "max(us)");
+
+	for(i=0;i<shared->num;i++){
+		r = &shared->result[i];
+
+		if(format == IOBENCH_FORMAT_CSV){
+			printf("%s,%s,%u,%u,%u,%u,%.1f,%.3f,%.3f,%.3f\n",
+				r->layout, r->op, r->sector_num, r->align, r->start, r->count, r->mbps, r->avg_us, r->min_us, r->max_us);
+		}else if(format == IOBENCH_FORMAT_JSON){
+			printf("  {\"layout\": \"%s\", \"op\": \"%s\", \"sector_num\": %u, \"align\": %u, \"start\": %u, \"count\": %u, "
+				"\"mbps\": %.1f, \"avg_us\": %.3f, \"min_us\": %.3f, \"max_us\": %.3f}%s\n",
+				r->layout, r->op, r->sector_num, r->align, r->start, r->count, r->mbps, r->avg_us, r->min_us, r->max_us,
+				(i == (shared->num - 1)) ? "" : ",");
+		}else{
+			printf("%-6s %-5s 0x%04X %5u %5u %8u %10.1f %10.2f %10.2f %10.2f\n",
+				r->layout, r->op, r->sector_num, r->align, r->start, r->count, r->mbps, r->avg_us, r->min_us, r->max_us);
+		}
+	}
+
+	if(format == IOBENCH_FORMAT_JSON)
+		printf("]\n");
+}
+
+/*
+ * Compares against a CSV of an earlier run. Single results of a short run are noisy, so the gate is the geometric
+ * mean of the MB/s ratios, which fails when it drops by more than tolerance percent. Results that dropped by more
+ * than that on their own are listed. Returns < 0 on a regression.
+ */
+static int iobenchCompare(const IoBenchShared *shared, const char *path, double tolerance){
+
+	FILE *fp;
+	char line[0x200], layout[8], op[8];
+	unsigned int sector_num, align, start, count;
+	double mbps, ratio, log_sum = 0.0, mean;
+	SceSize i;
+	int match = 0;
+	const IoBenchResult *r;
+
+	fp = fopen(path, "r");
+	if(fp == NULL){
+		perror(path);
+		return -1;
+	}
+
+	while(fgets(line, sizeof(line), fp) != NULL){
+		if(sscanf(line, "%7[^,],%7[^,],%u,%u,%u,%u,%lf", layout, op, &sector_num, &align, &start, &count, &mbps) != 7 || mbps <= 0.0)
+			continue;
+
+		for(i=0;i<shared->num;i++){
+			r = &shared->result[i];
+
+			if(strcmp(r->layout, layout) != 0 || strcmp(r->op, op) != 0 || r->sector_num != sector_num || r->align != align || r->start != start)
+				continue;
+
+			ratio = r->mbps / mbps;
+
+			log_sum += log(ratio);
+			match++;
+
+			if(ratio < (1.0 - (tolerance / 100.0)))
+				fprintf(stderr, "slower: %s %s 0x%X align %u start %u: %.1f MB/s, baseline %.1f MB/s\n",
+					layout, op, sector_num, align, start, r->mbps, mbps);
+		}
+	}
+
+	fclose(fp);
+
+	if(match == 0){
+		fprintf(stderr, "%s: no matching results\n", path);
+		return -1;
+	}
+
+	mean = exp(log_sum / match);
+
+	fprintf(stderr, "%d results, geometric mean %.3f of %s\n", match, mean, path);
+
+	if(mean < (1.0 - (tolerance / 100.0))){
+		fprintf(stderr, "regression: more than %.0f%% slower than %s\n", tolerance, path);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[]){
+
+	int i, res = 0, status, format = IOBENCH_FORMAT_TABLE;
+	double tolerance = 20.0;
+	const char *baseline = NULL;
+	pid_t pid;
+	IoBenchShared *shared;
+
+	for(i=1;i<argc;i++){
+		if(strcmp(argv[i], "--quick") == 0){
+			iobench_quick = 1;
+		}else if(strcmp(argv[i], "--csv") == 0){
+			format = IOBENCH_FORMAT_CSV;
+		}else if(strcmp(argv[i], "--json") == 0){
+			format = IOBENCH_FORMAT_JSON;
+		}else if(strcmp(argv[i], "--baseline") == 0 && (i + 1) < argc){
+			baseline = argv[++i];
+		}else if(strcmp(argv[i], "--tolerance") == 0 && (i + 1) < argc){
+			tolerance = strtod(argv[++i], NULL);
+		}else{
+			fprintf(stderr, "usage: %s [--quick] [--csv|--json] [--baseline <csv> [--tolerance <percent>]]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(shared == MAP_FAILED){
+		perror("mmap");
+		return 1;
+	}
+
+	shared->num = 0;
+
+	for(i=0;i<(sizeof(iobench_layout) / sizeof(iobench_layout[0]));i++){
+		fflush(stdout);
+
+		pid = fork();
+		if(pid < 0){
+			perror("fork");
+			return 1;
+		}
+
+		if(pid == 0)
+			_exit((iobenchLayout(&iobench_layout[i], shared) < 0) ? 1 : 0);
+
+		if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0){
+			fprintf(stderr, "%s: layout failed\n", iobench_layout[i].name);
+			res = -1;
+		}
+	}
+
+	iobenchPrint(shared, format);
+
+	if(res >= 0 && baseline != NULL && iobenchCompare(shared, baseline, tolerance) < 0)
+		res = -1;
+
+	munmap(shared, sizeof(*shared));
+
+	return (res < 0) ? 1 : 0;
+}
@@ -0,0 +1,338 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Trace Replay
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "vmass.h"
+#include "vmass_host.h"
+#include "vmass_internal.h"
+#include "vmass_trace.h"
+
+/*
+ * Each CPU of the trace gets a thread that issues its requests in start order, so requests that overlapped on
+ * the console overlap again. Asynchronous requests are replayed synchronously.
+ */
+#define REPLAY_CPU_NUM (4)
+
+#define REPLAY_MODE_REAL (0) // issue each request at its recorded offset from the first one
+#define REPLAY_MODE_MAX  (1) // issue each request as soon as the previous one of its CPU completes
+
+typedef struct ReplayRequest {
+	SceUInt64 offset;  // us from the first request of the trace
+	VmassTraceRecord record;
+} ReplayRequest;
+
+typedef struct ReplayOpStat {
+	SceUInt64 count;
+	SceUInt64 bytes;
+	SceUInt64 trace_time; // recorded latency, us
+	SceUInt64 time;       // replayed latency, ns
+	SceUInt64 time_max;
+} ReplayOpStat;
+
+typedef struct ReplayCpu {
+	pthread_t thread;
+	ReplayRequest *req;
+	SceSize req_num;
+	void *data;
+	int res;
+	ReplayOpStat stat[2]; // read, write
+} ReplayCpu;
+
+static int replay_mode;
+static SceInt64 replay_start;
+
+static SceInt64 replayGetTimeNs(void){
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((SceInt64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void replayWaitUntil(SceInt64 time){
+
+	struct timespec ts;
+
+	ts.tv_sec  = time / 1000000000;
+	ts.tv_nsec = time % 1000000000;
+
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0);
+}
+
+static int replayCompare(const void *a, const void *b){
+
+	const ReplayRequest *ra = a, *rb = b;
+
+	if(ra->offset != rb->offset)
+		return (ra->offset < rb->offset) ? -1 : 1;
+
+	return 0;
+}
+
+static void *replayThread(void *argp){
+
+	ReplayCpu *cpu = argp;
+	ReplayRequest *req;
+	ReplayOpStat *stat;
+	SceSize i;
+	SceInt64 time_s, time;
+	int res;
+
+	for(i=0;i<cpu->req_num;i++){
+		req = &cpu->req[i];
+
+		if(replay_mode == REPLAY_MODE_REAL)
+			replayWaitUntil(replay_start + (SceInt64)req->offset * 1000);
+
+		time_s = replayGetTimeNs();
+
+		if(req->record.op == VMASS_TRACE_OP_READ)
+			res = vmassReadSector(req->record.sector_pos, cpu->data, req->record.sector_num);
+		else
+			res = vmassWriteSector(req->record.sector_pos, cpu->data, req->record.sector_num);
+
+		time = replayGetTimeNs() - time_s;
+
+		if(res < 0){
+			printf("request at sector 0x%08X:0x%X failed 0x%X\n", req->record.sector_pos, req->record.sector_num, res);
+			cpu->res = res;
+			break;
+		}
+
+		stat = &cpu->stat[(req->record.op == VMASS_TRACE_OP_READ) ? 0 : 1];
+		stat->count++;
+		stat->bytes      += req->record.sector_num << 9;
+		stat->trace_time += req->record.latency;
+		stat->time       += time;
+		if(time > stat->time_max)
+			stat->time_max = time;
+	}
+
+	return NULL;
+}
+
+/*
+ * Reads the trace and splits its requests by CPU. Times are unwrapped against the previous record, which
+ * completed close enough in time for the difference to fit in 32 bits.
+ */
+static int replayLoad(const char *path, ReplayCpu *cpu, SceSize *end_sector, SceUInt64 *span){
+
+	FILE *fp;
+	VmassTraceHeader header;
+	VmassTraceRecord record;
+	ReplayRequest *req;
+	ReplayCpu *c;
+	SceSize i, n, skip = 0;
+	SceInt64 time = 0, time_min = 0, time_max = 0;
+	SceUInt32 prev = 0;
+
+	fp = fopen(path, "rb");
+	if(fp == NULL){
+		perror(path);
+		return -1;
+	}
+
+	if(fread(&header, sizeof(header), 1, fp) != 1 || header.magic != VMASS_TRACE_MAGIC
+		|| header.version != VMASS_TRACE_VERSION || header.record_size != sizeof(VmassTraceRecord)){
+		fprintf(stderr, "%s: not a vmass trace\n", path);
+		fclose(fp);
+		return -1;
+	}
+
+	printf("trace %u records of %llu traced\n", header.record_num, (unsigned long long)header.total_num);
+
+	req = calloc(header.record_num + 1, sizeof(*req));
+	if(req == NULL){
+		fclose(fp);
+		return -1;
+	}
+
+	for(i=0,n=0;i<header.record_num;i++){
+		if(fread(&record, sizeof(record), 1, fp) != 1){
+			fprintf(stderr, "%s: truncated at record %u\n", path, i);
+			break;
+		}
+
+		time = (i == 0) ? 0 : (time + (SceInt32)(record.time - prev));
+		prev = record.time;
+
+		if(i == 0 || time < time_min)
+			time_min = time;
+		if(i == 0 || time > time_max)
+			time_max = time;
+
+		if((record.flags & VMASS_TRACE_FLAG_ERROR) != 0 || record.sector_num == 0
+			|| (record.op != VMASS_TRACE_OP_READ && record.op != VMASS_TRACE_OP_WRITE)){
+			skip++;
+			continue;
+		}
+
+		if((record.sector_pos + record.sector_num) > *end_sector)
+			*end_sector = record.sector_pos + record.sector_num;
+
+		req[n].offset = time;
+		req[n].record = record;
+		n++;
+	}
+
+	fclose(fp);
+
+	if(skip != 0)
+		printf("skipped %u failed or malformed records\n", skip);
+
+	for(i=0;i<n;i++){
+		req[i].offset -= time_min;
+		cpu[req[i].record.cpu & (REPLAY_CPU_NUM - 1)].req_num++;
+	}
+
+	*span = time_max - time_min;
+
+	for(i=0;i<REPLAY_CPU_NUM;i++){
+		cpu[i].req = malloc((cpu[i].req_num + 1) * sizeof(*req));
+		if(cpu[i].req == NULL)
+			return -1;
+
+		cpu[i].req_num = 0;
+	}
+
+	for(i=0;i<n;i++){
+		c = &cpu[req[i].record.cpu & (REPLAY_CPU_NUM - 1)];
+		c->req[c->req_num++] = req[i];
+	}
+
+	for(i=0;i<REPLAY_CPU_NUM;i++)
+		qsort(cpu[i].req, cpu[i].req_num, sizeof(*req), replayCompare);
+
+	free(req);
+
+	return 0;
+}
+
+static void replayPrint(const char *name, const ReplayOpStat *stat, SceInt64 elapsed){
+
+	if(stat->count == 0)
+		return;
+
+	printf("%-5s %8llu %12llu %10.1f %12.2f %12.2f %12.2f\n", name,
+		(unsigned long long)stat->count, (unsigned long long)stat->bytes,
+		(double)stat->bytes / ((double)elapsed / 1000000000.0) / 1000000.0,
+		(double)stat->trace_time / stat->count,
+		(double)stat->time / stat->count / 1000.0, (double)stat->time_max / 1000.0);
+}
+
+int main(int argc, char *argv[]){
+
+	int i, op, res = 0;
+	SceSize n, end_sector = 0, capacity, max_sector;
+	SceUInt64 span = 0;
+	SceInt64 elapsed;
+	ReplayCpu cpu[REPLAY_CPU_NUM];
+	ReplayOpStat total[2];
+	VmassStorageMemtype memtype = {0x1080D006, 0};
+	VmassStat stat;
+
+	if(argc < 2 || argc > 3 || (argc == 3 && strcmp(argv[2], "real") != 0 && strcmp(argv[2], "max") != 0)){
+		fprintf(stderr, "usage: %s <vmass.trace> [real|max]\n", argv[0]);
+		return 1;
+	}
+
+	replay_mode = (argc == 3 && strcmp(argv[2], "max") == 0) ? REPLAY_MODE_MAX : REPLAY_MODE_REAL;
+
+	memset(cpu, 0, sizeof(cpu));
+
+	if(replayLoad(argv[1], cpu, &end_sector, &span) < 0)
+		return 1;
+
+	// the storage covers every request of the trace
+	capacity = ((end_sector << 9) + 0xFFFF) & ~0xFFFF;
+	if(capacity < 0x600000)
+		capacity = 0x600000;
+
+	vmassSetStorageCapacity(capacity, &memtype, 1);
+
+	res = vmassInit();
+	if(res < 0){
+		fprintf(stderr, "vmassInit failed 0x%X\n", res);
+		return 1;
+	}
+
+	max_sector = 0;
+	for(i=0;i<REPLAY_CPU_NUM;i++){
+		for(n=0;n<cpu[i].req_num;n++){
+			if(cpu[i].req[n].record.sector_num > max_sector)
+				max_sector = cpu[i].req[n].record.sector_num;
+		}
+	}
+
+	vmassGetStat(&stat, VMASS_STAT_RESET);
+
+	replay_start = replayGetTimeNs();
+
+	for(i=0;i<REPLAY_CPU_NUM;i++){
+		if(cpu[i].req_num == 0)
+			continue;
+
+		cpu[i].data = aligned_alloc(0x40, (max_sector << 9) + 0x40);
+		memset(cpu[i].data, 0xA5, max_sector << 9);
+
+		pthread_create(&cpu[i].thread, NULL, replayThread, &cpu[i]);
+	}
+
+	for(i=0;i<REPLAY_CPU_NUM;i++){
+		if(cpu[i].req_num != 0)
+			pthread_join(cpu[i].thread, NULL);
+	}
+
+	elapsed = replayGetTimeNs() - replay_start;
+
+	memset(total, 0, sizeof(total));
+
+	for(i=0;i<REPLAY_CPU_NUM;i++){
+		if(cpu[i].res < 0)
+			res = cpu[i].res;
+
+		for(op=0;op<2;op++){
+			total[op].count      += cpu[i].stat[op].count;
+			total[op].bytes      += cpu[i].stat[op].bytes;
+			total[op].trace_time += cpu[i].stat[op].trace_time;
+			total[op].time       += cpu[i].stat[op].time;
+			if(cpu[i].stat[op].time_max > total[op].time_max)
+				total[op].time_max = cpu[i].stat[op].time_max;
+		}
+
+		free(cpu[i].data);
+		free(cpu[i].req);
+	}
+
+	printf("%s replay took %.3f s, the trace spans %.3f s\n", (replay_mode == REPLAY_MODE_MAX) ? "max speed" : "real time",
+		(double)elapsed / 1000000000.0, (double)span / 1000000.0);
+	printf("%-5s %8s %12s %10s %12s %12s %12s\n", "op", "count", "bytes", "MB/s", "trace(us)", "replay(us)", "max(us)");
+
+	replayPrint("read", &total[0], elapsed);
+	replayPrint("write", &total[1], elapsed);
+
+	vmassGetStat(&stat, 0);
+	printf("chunks queued %llu inline %llu, lock waits %llu (%llu us)\n",
+		(unsigned long long)stat.queue_count, (unsigned long long)stat.inline_count,
+		(unsigned long long)stat.lock_wait_count, (unsigned long long)stat.lock_wait_time);
+
+	return (res < 0) ? 1 : 0;
+}
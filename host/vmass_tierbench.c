@@ -0,0 +1,174 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Compressed Tier Benchmark
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vmass.h"
+#include "vmass_page.h"
+#include "vmass_lz.h"
+#include "vmass_host.h"
+
+/*
+ * Fills the storage with log text, compresses every chunk and then measures the first read of each chunk,
+ * which decompresses it, against a second read of the same sector.
+ */
+#define TIERBENCH_CHUNK_SECTOR (VMASS_THIN_CHUNK_SIZE >> 9)
+
+static SceInt64 benchGetTimeNs(void){
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((SceInt64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void benchFillLog(char *data, SceSize size, unsigned int *line){
+
+	int len;
+	SceSize off = 0;
+	char tmp[0x80];
+
+	while(off < size){
+		len = snprintf(tmp, sizeof(tmp), "2026-10-16 12:%02u:%02u [%s] req %u served in %u us\n",
+			(*line / 60) % 60, *line % 60, ((*line % 7) == 0) ? "warn" : "info", *line, (*line * 37) % 5000);
+
+		if(len > (size - off))
+			len = size - off;
+
+		memcpy(data + off, tmp, len);
+		off += len;
+		(*line)++;
+	}
+}
+
+typedef struct BenchLatency {
+	SceInt64 total;
+	SceInt64 min;
+	SceInt64 max;
+	int count;
+} BenchLatency;
+
+static void benchLatencyAdd(BenchLatency *lat, SceInt64 time){
+
+	lat->total += time;
+	if(lat->count == 0 || time < lat->min)
+		lat->min = time;
+	if(time > lat->max)
+		lat->max = time;
+
+	lat->count++;
+}
+
+static void benchLatencyPrint(const char *name, const BenchLatency *lat){
+	printf("%-12s %8d %10.2f %10.2f %10.2f\n", name, lat->count,
+		(double)lat->total / lat->count / 1000.0, (double)lat->min / 1000.0, (double)lat->max / 1000.0);
+}
+
+int main(int argc, char *argv[]){
+
+	int res, size;
+	unsigned int line = 0;
+	char *data, *comp, *work;
+	SceSize sector_pos, all_sector;
+	SceInt64 time_s;
+	SceUsbMassDevInfo info;
+	VmassTierStat stat;
+	BenchLatency lat_miss, lat_hit, lat_codec;
+
+	// the tier only compresses thin pages
+	vmass_thin_provision = 1;
+
+	res = vmassInit();
+	if(res < 0){
+		fprintf(stderr, "vmassInit failed 0x%X\n", res);
+		return 1;
+	}
+
+	vmassGetDevInfo(&info);
+	all_sector = info.number_of_all_sector;
+
+	data = malloc(VMASS_THIN_CHUNK_SIZE);
+	comp = malloc(VMASS_THIN_CHUNK_SIZE);
+	work = malloc(VMASS_LZ_WORK_SIZE);
+
+	for(sector_pos=0;(sector_pos + TIERBENCH_CHUNK_SECTOR)<=all_sector;sector_pos+=TIERBENCH_CHUNK_SECTOR){
+		benchFillLog(data, VMASS_THIN_CHUNK_SIZE, &line);
+		vmassWriteSector(sector_pos, data, TIERBENCH_CHUNK_SECTOR);
+	}
+
+	res = vmassSetTierMode(VMASS_TIER_ON);
+	if(res < 0){
+		fprintf(stderr, "vmassSetTierMode failed 0x%X\n", res);
+		return 1;
+	}
+
+	time_s = benchGetTimeNs();
+	vmassTierScan(0);
+
+	vmassGetTierStat(&stat);
+	printf("compressed %u chunks in %.2f ms, %u -> %u bytes (ratio %.2f), %llu rejected\n",
+		stat.compressed_num, (double)(benchGetTimeNs() - time_s) / 1000000.0,
+		stat.original_size, stat.compressed_size,
+		(stat.compressed_size != 0) ? ((double)stat.original_size / stat.compressed_size) : 0.0,
+		(unsigned long long)stat.reject_count);
+
+	memset(&lat_miss, 0, sizeof(lat_miss));
+	memset(&lat_hit, 0, sizeof(lat_hit));
+	memset(&lat_codec, 0, sizeof(lat_codec));
+
+	for(sector_pos=0;(sector_pos + TIERBENCH_CHUNK_SECTOR)<=all_sector;sector_pos+=TIERBENCH_CHUNK_SECTOR){
+		time_s = benchGetTimeNs();
+		vmassReadSector(sector_pos, data, 1);
+		benchLatencyAdd(&lat_miss, benchGetTimeNs() - time_s);
+
+		time_s = benchGetTimeNs();
+		vmassReadSector(sector_pos, data, 1);
+		benchLatencyAdd(&lat_hit, benchGetTimeNs() - time_s);
+	}
+
+	// the bare codec on one chunk, without the memblock allocation of a miss
+	vmassReadSector(0, data, TIERBENCH_CHUNK_SECTOR);
+	size = vmassLzCompress(comp, VMASS_THIN_CHUNK_SIZE, data, VMASS_THIN_CHUNK_SIZE, work);
+
+	for(res=0;size > 0 && res<0x100;res++){
+		time_s = benchGetTimeNs();
+		vmassLzDecompress(data, VMASS_THIN_CHUNK_SIZE, comp, size);
+		benchLatencyAdd(&lat_codec, benchGetTimeNs() - time_s);
+	}
+
+	printf("%-12s %8s %10s %10s %10s\n", "read", "count", "avg(us)", "min(us)", "max(us)");
+	benchLatencyPrint("miss 0x200", &lat_miss);
+	benchLatencyPrint("hit 0x200", &lat_hit);
+	benchLatencyPrint("decompress", &lat_codec);
+
+	if(lat_codec.count != 0)
+		printf("decompress %.1f MB/s\n", (double)VMASS_THIN_CHUNK_SIZE * lat_codec.count / ((double)lat_codec.total / 1000000000.0) / 1000000.0);
+
+	vmassGetTierStat(&stat);
+	printf("tier hit %llu miss %llu compressed %u\n",
+		(unsigned long long)stat.hit_count, (unsigned long long)stat.miss_count, stat.compressed_num);
+
+	vmassSetTierMode(VMASS_TIER_OFF);
+
+	free(data);
+	free(comp);
+	free(work);
+
+	return 0;
+}
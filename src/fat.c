@@ -16,7 +16,104 @@
 #include <string.h>
 #include "fat.h"
 
-int setFat32Header(FatHeader *pFatHeader, unsigned int sector_num){
+#define FAT_NUM (2)
+
+#define FAT16_RSVD_SECTOR (2)
+#define FAT16_ROOT_ENTRY  (0x200)
+#define FAT32_RSVD_SECTOR (0x20)
+
+/*
+ * Fill the geometry of a type FAT with fat_size sectors, or the smallest that covers the clusters if fat_size is 0.
+ */
+static int setFatGeometry(FatLayout *pLayout, unsigned int type, unsigned int fat_size){
+
+	unsigned int root_sector, meta_sector, need, rsvd_sector;
+
+	pLayout->type           = type;
+	rsvd_sector             = (type == 32) ? FAT32_RSVD_SECTOR : FAT16_RSVD_SECTOR;
+	pLayout->root_entry_num = (type == 32) ? 0 : FAT16_ROOT_ENTRY;
+
+	root_sector = (pLayout->root_entry_num * 0x20) >> 9;
+	need        = (fat_size != 0) ? fat_size : 1;
+
+	do {
+		pLayout->fat_size = need;
+
+		meta_sector = rsvd_sector + root_sector + (pLayout->fat_size * FAT_NUM);
+		meta_sector = (meta_sector + pLayout->align_sector - 1) & ~(pLayout->align_sector - 1);
+		if(meta_sector >= pLayout->sector_num)
+			return -1;
+
+		pLayout->rsvd_sector = meta_sector - root_sector - (pLayout->fat_size * FAT_NUM);
+		pLayout->data_sector = meta_sector;
+		pLayout->cluster_num = (pLayout->sector_num - meta_sector) / pLayout->cluster_sector;
+
+		need = (((unsigned long long)(pLayout->cluster_num + 2) * type + 7) / 8 + 0x1FF) >> 9;
+	} while(need > pLayout->fat_size);
+
+	if(pLayout->cluster_num == 0)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * A count just past a type limit can fall below it with the larger entries of the next type.
+ * The smaller type then takes a FAT larger than it needs, until its count fits.
+ */
+static int setFatGeometryMax(FatLayout *pLayout, unsigned int type, unsigned int cluster_max){
+
+	if(setFatGeometry(pLayout, type, 0) < 0)
+		return -1;
+
+	while(pLayout->cluster_num > cluster_max){
+		if(setFatGeometry(pLayout, type, pLayout->fat_size + 1) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+int getFatLayout(FatLayout *pLayout, unsigned int sector_num, unsigned int cluster_sector, unsigned int align_sector){
+
+	if(cluster_sector == 0 || cluster_sector > 0x80 || (cluster_sector & (cluster_sector - 1)) != 0)
+		return -1;
+
+	// rsvd_sector is 16 bits wide
+	if(align_sector == 0 || align_sector > 0x800 || (align_sector & (align_sector - 1)) != 0)
+		return -1;
+
+	memset(pLayout, 0, sizeof(*pLayout));
+
+	pLayout->sector_num     = sector_num;
+	pLayout->cluster_sector = cluster_sector;
+	pLayout->align_sector   = align_sector;
+
+	if(setFatGeometry(pLayout, 12, 0) < 0)
+		return -1;
+
+	if(pLayout->cluster_num <= FAT12_CLUSTER_MAX)
+		return 0;
+
+	if(setFatGeometry(pLayout, 16, 0) < 0)
+		return -1;
+
+	if(pLayout->cluster_num <= FAT12_CLUSTER_MAX)
+		return setFatGeometryMax(pLayout, 12, FAT12_CLUSTER_MAX);
+
+	if(pLayout->cluster_num <= FAT16_CLUSTER_MAX)
+		return 0;
+
+	if(setFatGeometry(pLayout, 32, 0) < 0)
+		return -1;
+
+	if(pLayout->cluster_num <= FAT16_CLUSTER_MAX)
+		return setFatGeometryMax(pLayout, 16, FAT16_CLUSTER_MAX);
+
+	return 0;
+}
+
+static void setFatBase(FatHeader *pFatHeader, const FatLayout *pLayout){
 
 	memset(pFatHeader, 0, sizeof(FatHeader));
 
@@ -27,26 +124,41 @@ int setFat32Header(FatHeader *pFatHeader, unsigned int sector_num){
 	memcpy(pFatHeader->fat_base.oem_name, "FAPS    ", 8);
 
 	pFatHeader->fat_base.sector_size       = 0x200;
-	pFatHeader->fat_base.allocation_sector = 0x40; // Allocation unit size, (((byte / sector_size) / num_fats))
-	pFatHeader->fat_base.rsvd_sector       = 0x40;
+	pFatHeader->fat_base.allocation_sector = pLayout->cluster_sector;
+	pFatHeader->fat_base.rsvd_sector       = pLayout->rsvd_sector;
 
-	pFatHeader->fat_base.num_fats          = 2;
-	pFatHeader->fat_base.root_entry_sector = 0;
-	pFatHeader->fat_base.all_sector_num    = 0;
+	pFatHeader->fat_base.num_fats          = FAT_NUM;
+	pFatHeader->fat_base.root_entry_sector = pLayout->root_entry_num;
+	pFatHeader->fat_base.media             = 0xF8;
+
+	if(pLayout->type != 32 && pLayout->sector_num < 0x10000){
+		pFatHeader->fat_base.all_sector_num = (uint16_t)(pLayout->sector_num);
+		pFatHeader->fat_base.all_sector     = 0;
+	}else{
+		pFatHeader->fat_base.all_sector_num = 0;
+		pFatHeader->fat_base.all_sector     = pLayout->sector_num;
+	}
 
-	pFatHeader->fat_base.media            = 0xF8;
-	pFatHeader->fat_base.fat_size_16      = 0;
 	pFatHeader->fat_base.sector_per_track = 0x3F;
 	pFatHeader->fat_base.head_num         = 0xFF;
 	pFatHeader->fat_base.hidden_sector    = 0;
-	pFatHeader->fat_base.all_sector       = sector_num;
+}
+
+int setFat32Header(FatHeader *pFatHeader, const FatLayout *pLayout){
+
+	if(pLayout->type != 32)
+		return -1;
 
-	pFatHeader->fat32.fat_size            = ((sector_num >> 13) + 0x3F) & ~0x3F;
+	setFatBase(pFatHeader, pLayout);
+
+	pFatHeader->fat_base.fat_size_16      = 0;
+
+	pFatHeader->fat32.fat_size            = pLayout->fat_size;
 	pFatHeader->fat32.ext_flags           = 0;
 	pFatHeader->fat32.fs_version          = 0;
 	pFatHeader->fat32.root_cluster        = 2;
-	pFatHeader->fat32.fsinfo_sector       = 1;
-	pFatHeader->fat32.boot_backup_sector  = 6;
+	pFatHeader->fat32.fsinfo_sector       = FAT32_FSINFO_SECTOR;
+	pFatHeader->fat32.boot_backup_sector  = FAT32_BACKUP_SECTOR;
 	pFatHeader->fat32.drive_num           = 0x80;
 	pFatHeader->fat32.boot_sig            = 0x29;
 	pFatHeader->fat32.volume_id           = 0x287C78C1;
@@ -59,49 +171,27 @@ int setFat32Header(FatHeader *pFatHeader, unsigned int sector_num){
 	return 0;
 }
 
-int setFat32FsInfo(FAT32Fsinfo *pFAT32Fsinfo, FatHeader *pFatHeader){
+int setFat32FsInfo(FAT32Fsinfo *pFAT32Fsinfo, const FatLayout *pLayout){
 
 	memset(pFAT32Fsinfo, 0, sizeof(FAT32Fsinfo));
 
 	pFAT32Fsinfo->sign1                  = 0x41615252;
 	pFAT32Fsinfo->sign2                  = 0x61417272;
-	pFAT32Fsinfo->free_cluster_num       = ((pFatHeader->fat_base.all_sector - ((pFatHeader->fat32.fat_size * 2) + pFatHeader->fat_base.allocation_sector)) >> 6) - 1;
+	pFAT32Fsinfo->free_cluster_num       = pLayout->cluster_num - 1;
 	pFAT32Fsinfo->last_allocated_cluster = 0xFFFFFFFF;
 	pFAT32Fsinfo->sector_sig             = 0xAA55;
 
 	return 0;
 }
 
-int setFat16Header(FatHeader *pFatHeader, unsigned int sector_num){
+int setFat16Header(FatHeader *pFatHeader, const FatLayout *pLayout){
 
-	memset(pFatHeader, 0, sizeof(FatHeader));
+	if(pLayout->type == 32)
+		return -1;
 
-	pFatHeader->fat_base.bootcode[0] = 0xEB;
-	pFatHeader->fat_base.bootcode[1] = 0xFE;
-	pFatHeader->fat_base.bootcode[2] = 0x90;
-
-	memcpy(pFatHeader->fat_base.oem_name, "FAPS    ", 8);
-
-	pFatHeader->fat_base.sector_size       = 0x200;
-	pFatHeader->fat_base.allocation_sector = 8; // Allocation unit size, (((byte / sector_size) / num_fats))
-	pFatHeader->fat_base.rsvd_sector       = 2;
-
-	pFatHeader->fat_base.num_fats          = 2;
-	pFatHeader->fat_base.root_entry_sector = 0x200;
-	pFatHeader->fat_base.media             = 0xF8;
-	pFatHeader->fat_base.fat_size_16       = (uint16_t)((sector_num >> 11) + 0x3);
+	setFatBase(pFatHeader, pLayout);
 
-	if(sector_num >= 0x10000){
-		pFatHeader->fat_base.all_sector_num = 0;
-		pFatHeader->fat_base.all_sector     = sector_num;
-	}else{
-		pFatHeader->fat_base.all_sector_num = (uint16_t)(sector_num);
-		pFatHeader->fat_base.all_sector     = 0;
-	}
-
-	pFatHeader->fat_base.sector_per_track = 0x3F;
-	pFatHeader->fat_base.head_num         = 0xFF;
-	pFatHeader->fat_base.hidden_sector    = 0;
+	pFatHeader->fat_base.fat_size_16      = (uint16_t)(pLayout->fat_size);
 
 	pFatHeader->fat16.drive_num           = 0x80;
 	pFatHeader->fat16.boot_sig            = 0x29;
@@ -115,11 +205,11 @@ int setFat16Header(FatHeader *pFatHeader, unsigned int sector_num){
 	return 0;
 }
 
-int setFat12Header(FatHeader *pFatHeader, unsigned int sector_num){
+int setFat12Header(FatHeader *pFatHeader, const FatLayout *pLayout){
 
 	int res;
 
-	res = setFat16Header(pFatHeader, sector_num);
+	res = setFat16Header(pFatHeader, pLayout);
 
 	memcpy(pFatHeader->fat16.fs_type, "FAT12   ", 8);
 
@@ -83,17 +83,43 @@ typedef struct FAT32Fsinfo {
 	uint32_t sign1;
 	char rsvd1[480];
 	uint32_t sign2;
-	uint32_t free_cluster_num;	// ((all_sector - ((fat_size * 2) + allocation_sector)) >> 6) - 1
+	uint32_t free_cluster_num;	// cluster_num - 1, the root directory takes cluster 2
 	uint32_t last_allocated_cluster;
 	char rsvd2[14];
 	uint16_t sector_sig;
 } __attribute__((packed)) FAT32Fsinfo;
 
-int setFat12Header(FatHeader *pFatHeader, unsigned int sector_num);
+#define FAT12_CLUSTER_MAX (4084)
+#define FAT16_CLUSTER_MAX (65524)
 
-int setFat16Header(FatHeader *pFatHeader, unsigned int sector_num);
+#define FAT32_FSINFO_SECTOR (1)
+#define FAT32_BACKUP_SECTOR (6)
 
-int setFat32Header(FatHeader *pFatHeader, unsigned int sector_num);
-int setFat32FsInfo(FAT32Fsinfo *pFAT32Fsinfo, FatHeader *pFatHeader);
+/*
+ * Volume geometry. The FAT type follows from cluster_num as the FAT specification defines it.
+ */
+typedef struct FatLayout {
+	unsigned int type;           // 12, 16 or 32
+	unsigned int sector_num;
+	unsigned int cluster_sector; // sectors per cluster, a power of two up to 0x80
+	unsigned int rsvd_sector;    // padded so data_sector is a multiple of align_sector
+	unsigned int root_entry_num; // 0 for FAT32
+	unsigned int fat_size;       // sectors of one FAT
+	unsigned int data_sector;    // first sector of cluster 2
+	unsigned int cluster_num;
+	unsigned int align_sector;
+} FatLayout;
+
+/*
+ * With data_sector aligned, every cluster starts on a multiple of the smaller of its size and align_sector.
+ */
+int getFatLayout(FatLayout *pLayout, unsigned int sector_num, unsigned int cluster_sector, unsigned int align_sector);
+
+int setFat12Header(FatHeader *pFatHeader, const FatLayout *pLayout);
+
+int setFat16Header(FatHeader *pFatHeader, const FatLayout *pLayout);
+
+int setFat32Header(FatHeader *pFatHeader, const FatLayout *pLayout);
+int setFat32FsInfo(FAT32Fsinfo *pFAT32Fsinfo, const FatLayout *pLayout);
 
 #endif	/* _VMASS_FAT_H_ */
@@ -22,33 +22,34 @@
 #include "sysevent.h"
 #include "vmass.h"
 #include "vmass_sysevent.h"
+#include "vmass_page.h"
+#include "vmass_tier.h"
+#include "vmass_config.h"
+#include "vmass_trace.h"
+#include "vmass_internal.h"
 #include "fat.h"
 
+#define SIZE_64KiB  0x10000
+#define SIZE_1MiB   0x100000
 #define SIZE_2MiB   0x200000
 #define SIZE_4MiB   0x400000
 #define SIZE_6MiB   0x600000
 #define SIZE_10MiB  0xA00000
 #define SIZE_16MiB 0x1000000
 
-typedef struct VmassPageInfo {
-	void   *base;
-	SceSize size;
-} VmassPageInfo;
-
-#define USE_MEMORY_10MiB  1
-#define USE_MEMORY_32MiB  0
-#define USE_DEVKIT_MEMORY 0
-
-#define DEVKIT_MEM_1MiB  {0x10F0D006, 0x00000000, 0x100000}
-#define DEVKIT_MEM_4MiB  DEVKIT_MEM_1MiB, DEVKIT_MEM_1MiB, DEVKIT_MEM_1MiB, DEVKIT_MEM_1MiB
-#define DEVKIT_MEM_16MiB DEVKIT_MEM_4MiB, DEVKIT_MEM_4MiB, DEVKIT_MEM_4MiB, DEVKIT_MEM_4MiB
-
 SceUID sysevent_id;
 SceSize g_vmass_size;
 
-#define VMASS_PAGE_MAX_NUMBER (0x20)
-
-VmassPageInfo vmass_page_list[VMASS_PAGE_MAX_NUMBER];
+/*
+ * Other useful memtypes are 0x40404006 (ScePhyMemPartGameCdram) and 0x10F0D006 (devkit memory).
+ */
+VmassStorageMemtype vmass_storage_memtype[VMASS_STORAGE_MEMTYPE_MAX] = {
+	{0x1080D006, 0} // ScePhyMemPartPhyCont
+};
+SceSize vmass_storage_memtype_num = 1;
+SceSize vmass_storage_capacity = SIZE_6MiB;
+SceSize vmass_format_cluster_size = 0; // 0 picks it from the capacity
+SceSize vmass_format_align = SIZE_64KiB;
 
 
 SceKernelLwMutexWork lw_mtx;
@@ -68,32 +69,33 @@ int _vmassGetDevInfo(SceUsbMassDevInfo *pInfo){
 
 int _vmassReadSector(SceSize sector_pos, void *data, SceSize sector_num){
 
-	int page_idx = 0;
+	int page_idx;
 	SceSize off = (sector_pos << 9), size = (sector_num << 9), work_size;
 
-	while(off >= vmass_page_list[page_idx].size){
-		off -= vmass_page_list[page_idx].size;
-		page_idx++;
-	}
+	page_idx = vmassPageLookup(off);
+	if(page_idx < 0)
+		return -1;
+
+	off -= vmass_page_list[page_idx].offset;
+
+	// a cluster aligned request stays in one page
+	if(size != 0 && (off + size) <= vmass_page_list[page_idx].size)
+		return vmassPageRead(page_idx, off, data, size);
+
+	while(size != 0){
+		if(page_idx >= vmass_page_num)
+			return -1;
 
-	if(off != 0){
 		work_size = vmass_page_list[page_idx].size - off;
 		if(work_size > size)
 			work_size = size;
 
-		memcpy(data, vmass_page_list[page_idx].base + off, work_size);
-		size -= work_size;
-		data += work_size;
-		off = 0;
-		page_idx++;
-	}
-
-	while(size != 0){
-		work_size = (size > vmass_page_list[page_idx].size) ? vmass_page_list[page_idx].size : size;
+		if(vmassPageRead(page_idx, off, data, work_size) < 0)
+			return -1;
 
-		memcpy(data, vmass_page_list[page_idx].base, work_size);
 		size -= work_size;
 		data += work_size;
+		off = 0;
 		page_idx++;
 	}
 
@@ -102,32 +104,32 @@ int _vmassReadSector(SceSize sector_pos, void *data, SceSize sector_num){
 
 int _vmassWriteSector(SceSize sector_pos, const void *data, SceSize sector_num){
 
-	int page_idx = 0;
+	int page_idx;
 	SceSize off = (sector_pos << 9), size = (sector_num << 9), work_size;
 
-	while(off >= vmass_page_list[page_idx].size){
-		off -= vmass_page_list[page_idx].size;
-		page_idx++;
-	}
+	page_idx = vmassPageLookup(off);
+	if(page_idx < 0)
+		return -1;
+
+	off -= vmass_page_list[page_idx].offset;
+
+	if(size != 0 && (off + size) <= vmass_page_list[page_idx].size)
+		return vmassPageWrite(page_idx, off, data, size);
+
+	while(size != 0){
+		if(page_idx >= vmass_page_num)
+			return -1;
 
-	if(off != 0){
 		work_size = vmass_page_list[page_idx].size - off;
 		if(work_size > size)
 			work_size = size;
 
-		memcpy(vmass_page_list[page_idx].base + off, data, work_size);
-		size -= work_size;
-		data += work_size;
-		off = 0;
-		page_idx++;
-	}
-
-	while(size != 0){
-		work_size = (size > vmass_page_list[page_idx].size) ? vmass_page_list[page_idx].size : size;
+		if(vmassPageWrite(page_idx, off, data, work_size) < 0)
+			return -1;
 
-		memcpy(vmass_page_list[page_idx].base, data, work_size);
 		size -= work_size;
 		data += work_size;
+		off = 0;
 		page_idx++;
 	}
 
@@ -136,215 +138,111 @@ int _vmassWriteSector(SceSize sector_pos, const void *data, SceSize sector_num){
 
 int vmassGetDevInfo(SceUsbMassDevInfo *info){
 
-	int res;
-
-	ksceKernelLockFastMutex(&lw_mtx);
-
-	res = _vmassGetDevInfo(info);
-
-	ksceKernelUnlockFastMutex(&lw_mtx);
-
-	return res;
+	/*
+	 * The geometry is fixed once vmassInit returns, so no lock is needed.
+	 */
+	return _vmassGetDevInfo(info);
 }
 
-#define VMASS_CAPTURE_SPEED (0)
-
-#if VMASS_CAPTURE_SPEED != 0
-
-#include <psp2kern/kernel/cpu.h>
-
-#define VMASS_PERF_S() SceInt64 time_s, time_e; \
-			{ \
-			time_s = ksceKernelGetSystemTimeWide(); \
-			}
-
-#define VMASS_PERF_E(type, sector_pos, sector) { \
-			time_e = ksceKernelGetSystemTimeWide(); \
-			int BytePerSecond = 0; \
-			getBytePerSecond(time_e - time_s, ((sector) << 9), &BytePerSecond); \
-			ksceDebugPrintf("[%-7s] %d:Sector 0x%08X:0x%08X Time %9dMB/s\n", type, ksceKernelCpuGetCpuId(), (sector_pos), (sector), BytePerSecond); \
-			}
-
-int getBytePerSecond(int time, int byte, int *dst){
+int vmassGetStorageUsage(SceSize *backed_size, SceSize *total_size){
 
-	asm volatile (
-		// s0 : time
-		// s3 : byte
-		"vmov s0, %0\n"
-		"vmov s3, %1\n"
-		"vcvt.f32.u32 s0, s0\n"
-		"vcvt.f32.u32 s3, s3\n"
+	if(backed_size != NULL)
+		*backed_size = vmassPageGetBackedSize();
 
-		// 1000000.0f
-		"movw r3, #:lower16:0x49742400\n"
-		"movt r3, #:upper16:0x49742400\n"
-		"vmov s1, r3\n"
-
-		// 1000.0f
-		"movw r3, #:lower16:0x447A0000\n"
-		"movt r3, #:upper16:0x447A0000\n"
-		"vmov s2, r3\n"
-
-		// s0 = 1000000.0f / time
-		"vdiv.f32 s0, s1, s0\n"
-
-		// s0 = byte * s0
-		"vmul.f32 s0, s3, s0\n"
-
-		// byte to KB
-		"vdiv.f32 s0, s0, s2\n"
-
-		// KB to MB
-		"vdiv.f32 s0, s0, s2\n"
-
-		// float to int
-		"vcvt.u32.f32 s0, s0\n"
-		"vstr s0, [%2]\n"
-		:
-		: "r"(time), "r"(byte), "r"(dst)
-		: "r3", "s0", "s1", "s2", "s3"
-	);
+	if(total_size != NULL)
+		*total_size = vmassPageGetTotalSize();
 
 	return 0;
 }
 
-#else
-
-#define VMASS_PERF_S()
-#define VMASS_PERF_E(type, sector_pos, sector)
-
-#endif
-
-#define VMASS_RW_THREAD_PRIORITY_DEF (0x6E)
-#define VMASS_RW_THREAD_PRIORITY_WRK (0x28)
-
-#define VMASS_REQ_READ  (1 << 0)
-#define VMASS_REQ_WRITE (1 << 1)
-#define VMASS_REQ_DONE  (1 << 30)
-#define VMASS_REQ_EXIT  (1 << 31)
-
-SceSize g_sector_pos;
-SceSize g_sector_num;
-void *g_pDataForRead;
-const void *g_pDataForWrite;
-SceUID thid, evf_id;
-
-int sceVmassRWThread(SceSize args, void *argp){
+int vmassCheckSector(SceSize sector_pos, SceSize sector_num){
 
-	int res;
-	unsigned int opcode;
-
-	while(1){
-		ksceKernelChangeThreadPriority(0, VMASS_RW_THREAD_PRIORITY_DEF);
-
-		opcode = 0;
-		res = ksceKernelWaitEventFlag(evf_id, VMASS_REQ_READ | VMASS_REQ_WRITE | VMASS_REQ_EXIT, SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, &opcode, NULL);
-		if(res < 0)
-			continue;
-
-		ksceKernelChangeThreadPriority(0, VMASS_RW_THREAD_PRIORITY_WRK);
-
-		if(opcode == VMASS_REQ_READ){
-			_vmassReadSector(g_sector_pos, g_pDataForRead, g_sector_num);
-			ksceKernelSetEventFlag(evf_id, VMASS_REQ_DONE);
-
-		}else if(opcode == VMASS_REQ_WRITE){
-			_vmassWriteSector(g_sector_pos, g_pDataForWrite, g_sector_num);
-			ksceKernelSetEventFlag(evf_id, VMASS_REQ_DONE);
+	SceSize off = (sector_pos << 9), size = (sector_num << 9);
 
-		}else if(opcode == VMASS_REQ_EXIT){
-			ksceKernelSetEventFlag(evf_id, VMASS_REQ_DONE);
-			break;
-		}
-	}
+	if(((size - 1) > g_vmass_size) || (off >= g_vmass_size) || ((off + size) > g_vmass_size))
+		return -1;
 
 	return 0;
 }
 
 int vmassReadSector(SceSize sector_pos, void *data, SceSize sector_num){
 
-	int res = 0, s1;
+	int res;
+	SceUInt32 time_s, time;
 
-	SceSize off = (sector_pos << 9), size = (sector_num << 9);
+	res = vmassCheckSector(sector_pos, sector_num);
+	if(res < 0)
+		return res;
 
-	if(((size - 1) > g_vmass_size) || (off >= g_vmass_size) || ((off + size) > g_vmass_size))
-		return -1;
+	time_s = ksceKernelGetSystemTimeLow();
+
+	vmassQueueEnter();
 
-	ksceKernelLockFastMutex(&lw_mtx);
+	res = vmassImageFault(sector_pos, sector_num);
+	if(res < 0){
+		vmassQueueLeave();
+		return res;
+	}
 
-	s1 = sector_num & 1;
-	sector_num >>= 1;
+	vmassRangeLock(-1, VMASS_REQ_READ, sector_pos, sector_num);
 
-	VMASS_PERF_S();
+	res = vmassSplitSector(VMASS_REQ_READ, sector_pos, data, sector_num, vmassGetReadSplitSector(sector_pos));
 
-	if(sector_num >= 0x50){
-		g_sector_pos = sector_pos;
-		g_sector_num = sector_num;
-		g_pDataForRead = data;
-		ksceKernelSetEventFlag(evf_id, VMASS_REQ_READ);
-	}else{
-		sector_num = (sector_num << 1) + s1;
-		s1 = -1;
-	}
+	vmassRangeUnlock(VMASS_REQ_READ, sector_pos, sector_num);
 
-	if(s1 >= 0){
-		_vmassReadSector(sector_pos + sector_num, data + (sector_num << 9), sector_num + s1);
+	time = ksceKernelGetSystemTimeLow() - time_s;
 
-		if(sector_num != 0){
-			ksceKernelWaitEventFlag(evf_id, VMASS_REQ_DONE, SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, NULL, NULL);
-		}
-		sector_num = (sector_num << 1) + s1;
-	}else{
-		_vmassReadSector(sector_pos, data, sector_num);
-	}
+	vmassTraceRecord(VMASS_REQ_READ, sector_pos, sector_num, time_s, time, (res < 0) ? VMASS_TRACE_FLAG_ERROR : 0);
 
-	VMASS_PERF_E("Read", sector_pos, sector_num);
+	vmassQueueLeave();
 
-	ksceKernelUnlockFastMutex(&lw_mtx);
+	if(res >= 0)
+		vmassStatRequest(VMASS_REQ_READ, sector_num, time);
 
 	return res;
 }
 
 int vmassWriteSector(SceSize sector_pos, const void *data, SceSize sector_num){
 
-	int res = 0, s1;
+	int res;
+	SceUInt32 time_s, time;
 
-	SceSize off = (sector_pos << 9), size = (sector_num << 9);
+	res = vmassCheckSector(sector_pos, sector_num);
+	if(res < 0)
+		return res;
 
-	if(((size - 1) > g_vmass_size) || (off >= g_vmass_size) || ((off + size) > g_vmass_size))
-		return -1;
+	time_s = ksceKernelGetSystemTimeLow();
 
-	ksceKernelLockFastMutex(&lw_mtx);
+	vmassQueueEnter();
 
-	s1 = sector_num & 1;
-	sector_num >>= 1;
+	res = vmassImageFault(sector_pos, sector_num);
+	if(res < 0){
+		vmassQueueLeave();
+		return res;
+	}
 
-	VMASS_PERF_S();
+	vmassSnapshotFault(sector_pos, sector_num);
 
-	if(sector_num >= 0x20){
-		g_sector_pos = sector_pos;
-		g_sector_num = sector_num;
-		g_pDataForWrite = data;
-		ksceKernelSetEventFlag(evf_id, VMASS_REQ_WRITE);
-	}else{
-		sector_num = (sector_num << 1) + s1;
-		s1 = -1;
+	vmassRangeLock(-1, VMASS_REQ_WRITE, sector_pos, sector_num);
+
+	res = vmassSplitSector(VMASS_REQ_WRITE, sector_pos, (void *)data, sector_num, vmassGetWriteSplitSector(sector_pos));
+	vmassReclaimNoteWrite();
+	if(res >= 0){
+		vmassPageTrim(sector_pos << 9, data, sector_num << 9);
+		vmassImageMarkDirty(sector_pos, sector_num);
+		vmassJournalAppend(sector_pos, data, sector_num);
 	}
 
-	if(s1 >= 0){
-		_vmassWriteSector(sector_pos + sector_num, data + (sector_num << 9), sector_num + s1);
+	vmassRangeUnlock(VMASS_REQ_WRITE, sector_pos, sector_num);
 
-		if(sector_num != 0){
-			ksceKernelWaitEventFlag(evf_id, VMASS_REQ_DONE, SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, NULL, NULL);
-		}
-		sector_num = (sector_num << 1) + s1;
-	}else{
-		_vmassWriteSector(sector_pos, data, sector_num);
-	}
+	time = ksceKernelGetSystemTimeLow() - time_s;
 
-	VMASS_PERF_E("Write", sector_pos, sector_num);
+	vmassTraceRecord(VMASS_REQ_WRITE, sector_pos, sector_num, time_s, time, (res < 0) ? VMASS_TRACE_FLAG_ERROR : 0);
 
-	ksceKernelUnlockFastMutex(&lw_mtx);
+	vmassQueueLeave();
+
+	if(res >= 0)
+		vmassStatRequest(VMASS_REQ_WRITE, sector_num, time);
 
 	return res;
 }
@@ -373,192 +271,162 @@ int SceUsbMassForDriver_7833D935(int a1, int a2){
 	return 0;
 }
 
-int vmassFreeStoragePage(void){
+int vmassSetStorageCapacity(SceSize capacity, const VmassStorageMemtype *list, SceSize num){
+
+	if(g_vmass_size != 0)
+		return -1;
 
-	int i = VMASS_PAGE_MAX_NUMBER;
+	if(capacity < SIZE_64KiB || list == NULL || num == 0 || num > VMASS_STORAGE_MEMTYPE_MAX)
+		return -1;
 
-	do {
-		i--;
-		if(vmass_page_list[i].base != NULL)
-			ksceKernelFreeMemBlock(ksceKernelFindMemBlockByAddr(vmass_page_list[i].base, 0));
-	} while(i != 0);
+	memcpy(vmass_storage_memtype, list, sizeof(*list) * num);
+	vmass_storage_memtype_num = num;
+	vmass_storage_capacity    = capacity;
 
 	return 0;
 }
 
-int vmassPageRegister(VmassPageInfo *info, void *base, SceSize size){
+int vmassAllocStoragePage(void){
+
+	int res;
 
-	if(base != NULL)
-		info->base = base;
-	info->size = size;
+	res = vmassPageAlloc(vmass_storage_memtype, vmass_storage_memtype_num, vmass_storage_capacity);
+	if(res < 0)
+		return res;
 
-	g_vmass_size += size;
+	g_vmass_size = vmassPageGetTotalSize();
 
 	return 0;
 }
 
-int vmassPageAlloc(VmassPageInfo *info, SceUInt32 memtype, SceSize size){
-
-	SceUID memid = ksceKernelAllocMemBlock("VmassStoragePage", memtype, size, NULL);
-	if(memid < 0){
-		vmassFreeStoragePage();
-
-		return memid;
-	}
+int vmassSetFormatClusterSize(SceSize size){
 
-	ksceKernelGetMemBlockBase(memid, &(info->base));
+	if(g_vmass_size != 0)
+		return -1;
 
-	ksceDmacMemset(info->base, 0, size);
+	if(size != 0 && (size < 0x200 || size > SIZE_64KiB || (size & (size - 1)) != 0))
+		return -1;
 
-	vmassPageRegister(info, NULL, size);
+	vmass_format_cluster_size = size;
 
 	return 0;
 }
 
-int vmassAllocStoragePage(void){
+int vmassSetFormatAlign(SceSize size){
 
-	// ScePhyMemPartPhyCont
-	vmassPageAlloc(&vmass_page_list[0], 0x1080D006, SIZE_6MiB);
+	if(g_vmass_size != 0)
+		return -1;
+
+	if(size < 0x200 || size > SIZE_1MiB || (size & (size - 1)) != 0)
+		return -1;
 
-	// ScePhyMemPartGameCdram
-	// vmassPageAlloc(&vmass_page_list[1], 0x40404006, SIZE_10MiB);
+	vmass_format_align = size;
 
 	return 0;
 }
 
-int vmassInitImageHeader(void){
-
-	int buf[0x200 >> 2];
-	FatHeader fat_header;
-
-	memset(buf, 0, 0x200);
-
-	if(g_vmass_size >= SIZE_16MiB){
-		buf[0] = 0xFFFFFFF8;
+/*
+ * Larger clusters keep a large file in fewer FAT entries, so a long write updates far fewer FAT sectors.
+ * The FAT type then follows from the cluster count.
+ */
+static SceSize vmassFormatClusterSize(SceSize size){
 
-		setFat16Header(&fat_header, g_vmass_size >> 9);
-	}else{
-		buf[0] = 0xFFFFF8;
+	if(vmass_format_cluster_size != 0)
+		return vmass_format_cluster_size;
 
-		setFat12Header(&fat_header, g_vmass_size >> 9);
-	}
+	if(size < SIZE_16MiB)
+		return 0x1000;
 
-	vmassWriteSector(0, &fat_header, 1);
+	if(size < (SIZE_16MiB * 4))
+		return 0x2000;
 
-	// write first file/dir entry
-	vmassWriteSector(2, buf, 1);
-	vmassWriteSector(fat_header.fat_base.fat_size_16 + 2, buf, 1);
+	if(size < (SIZE_16MiB * 8))
+		return 0x4000;
 
-	return 0;
+	return 0x8000;
 }
 
-int vmassLoadImage(void){
+int vmassInitImageHeader(void){
 
 	int res;
-	SceIoStat stat;
-	SceUID fd;
-
-	fd = ksceIoOpen("sd0:vmass.img", SCE_O_RDONLY, 0);
-	if(fd < 0)
-		fd = ksceIoOpen("ux0:data/vmass.img", SCE_O_RDONLY, 0);
-
-	if(fd < 0)
-		return fd;
-
-	res = ksceIoGetstatByFd(fd, &stat);
+	SceSize i;
+	SceUInt8 buf[0x200];
+	FatHeader fat_header;
+	FAT32Fsinfo fsinfo;
+	FatLayout layout;
+
+	/*
+	 * Clusters aligned to the thin pages make most data I/O a copy within one page.
+	 * A volume too small to spend the padding on is formatted unaligned.
+	 */
+	res = getFatLayout(&layout, g_vmass_size >> 9, vmassFormatClusterSize(g_vmass_size) >> 9, vmass_format_align >> 9);
 	if(res < 0)
-		goto io_close;
+		res = getFatLayout(&layout, g_vmass_size >> 9, vmassFormatClusterSize(g_vmass_size) >> 9, 1);
 
-	if(stat.st_size > (SceOff)(g_vmass_size)){
-		res = -1;
-		goto io_close;
-	}
+	if(res < 0)
+		return res;
 
-	g_vmass_size = (SceSize)stat.st_size;
+	memset(buf, 0, sizeof(buf));
 
-	SceSize page_idx = 0, size = g_vmass_size, work_size;
+	// media and end of chain entries of cluster 0 and 1, then the root directory cluster of FAT32
+	buf[0] = 0xF8;
+	buf[1] = 0xFF;
+	buf[2] = 0xFF;
 
-	while(size != 0){
-		work_size = (size > vmass_page_list[page_idx].size) ? vmass_page_list[page_idx].size : size;
+	if(layout.type == 12){
+		res = setFat12Header(&fat_header, &layout);
+	}else if(layout.type == 16){
+		buf[3] = 0xFF;
 
-		ksceIoRead(fd, vmass_page_list[page_idx].base, work_size);
+		res = setFat16Header(&fat_header, &layout);
+	}else{
+		memset(&buf[3], 0xFF, 9);
+		buf[3]  = 0x0F;
+		buf[7]  = 0x0F;
+		buf[11] = 0x0F;
 
-		size -= work_size;
-		page_idx++;
+		res = setFat32Header(&fat_header, &layout);
 	}
 
-	res = 0;
-
-io_close:
-	ksceIoClose(fd);
-
-	return res;
-}
-
-int vmassCreateImage(void){
-
-	int res;
-	SceIoStat stat;
-	SceUID fd;
-
-	fd = ksceIoOpen("sd0:vmass.img", SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0666);
-	if(fd < 0)
-		fd = ksceIoOpen("ux0:data/vmass.img", SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0666);
-
-	if(fd < 0)
-		return fd;
-
-	memset(&stat, 0, sizeof(stat));
-	stat.st_size = (SceOff)g_vmass_size;
-
-#define SCE_CST_SIZE        0x0004
-
-	res = ksceIoChstatByFd(fd, &stat, SCE_CST_SIZE);
 	if(res < 0)
-		goto io_close;
-
-	SceSize page_idx = 0, size = g_vmass_size, work_size;
+		return res;
 
-	while(size != 0){
-		work_size = (size > vmass_page_list[page_idx].size) ? vmass_page_list[page_idx].size : size;
+	vmassWriteSector(0, &fat_header, 1);
 
-		ksceIoWrite(fd, vmass_page_list[page_idx].base, work_size);
+	if(layout.type == 32){
+		setFat32FsInfo(&fsinfo, &layout);
 
-		size -= work_size;
-		page_idx++;
+		vmassWriteSector(FAT32_FSINFO_SECTOR, &fsinfo, 1);
+		vmassWriteSector(FAT32_BACKUP_SECTOR, &fat_header, 1);
+		vmassWriteSector(FAT32_BACKUP_SECTOR + FAT32_FSINFO_SECTOR, &fsinfo, 1);
 	}
 
-	res = 0;
+	for(i=0;i<fat_header.fat_base.num_fats;i++)
+		vmassWriteSector(layout.rsvd_sector + (layout.fat_size * i), buf, 1);
 
-io_close:
-	ksceIoClose(fd);
-
-	return res;
+	return 0;
 }
 
 int vmassInit(void){
 
 	int res;
+	VmassConfig *cfg;
 
-	res = ksceKernelInitializeFastMutex(&lw_mtx, "VmassMutex", 0, 0);
-	if(res < 0)
-		return res;
+	cfg = ksceKernelAllocHeapMemory(VMASS_KERNEL_HEAP, sizeof(*cfg));
+	if(cfg != NULL){
+		if(vmassConfigLoad(cfg, VMASS_CONFIG_PATH) >= 0)
+			vmassConfigApply(cfg);
 
-	evf_id = ksceKernelCreateEventFlag("VmassEvf", SCE_EVENT_WAITMULTIPLE, 0, NULL);
-	if(evf_id < 0){
-		res = evf_id;
-		goto del_mtx;
+		ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, cfg);
 	}
 
-	thid = ksceKernelCreateThread("SceVmassRWThread", sceVmassRWThread, 0x6E, 0x1000, 0, 1 << 3, NULL);
-	if(thid < 0){
-		res = thid;
-		goto del_evf;
-	}
+	res = ksceKernelInitializeFastMutex(&lw_mtx, "VmassMutex", 0, 0);
+	if(res < 0)
+		return res;
 
-	res = ksceKernelStartThread(thid, 0, NULL);
+	res = vmassQueueInit();
 	if(res < 0)
-		goto del_thread;
+		goto del_mtx;
 
 	sysevent_id = ksceKernelRegisterSysEventHandler("SceSysEventVmass", vmassSysEventHandler, NULL);
 	if(sysevent_id < 0){
@@ -570,16 +438,56 @@ int vmassInit(void){
 	if(res < 0)
 		goto unregister_sys_event;
 
-	res = vmassLoadImage();
+	res = vmassRangeInit(vmassPageGetTotalSize());
+	if(res < 0)
+		goto free_storage_page;
+
+	res = vmassTierInit();
 	if(res < 0)
-		res = vmassInitImageHeader();
+		goto range_fini;
 
+	res = vmassImageInit(vmassPageGetTotalSize());
 	if(res < 0)
-		goto free_storage_page;
+		goto tier_fini;
+
+	res = vmassSnapshotInit(vmassPageGetTotalSize());
+	if(res < 0)
+		goto image_fini;
+
+	res = vmassReclaimInit();
+	if(res < 0)
+		goto snapshot_fini;
+
+	vmassTraceInit();
+	vmassCalibrateInit();
+
+	res = vmassLoadImage();
+	if(res >= 0)
+		vmassJournalInit(1);
+	else if((res = vmassInitImageHeader()) >= 0)
+		vmassJournalInit(0);
+
+	if(res < 0)
+		goto reclaim_fini;
 
 end:
 	return res;
 
+reclaim_fini:
+	vmassReclaimFini();
+
+snapshot_fini:
+	vmassSnapshotFini();
+
+image_fini:
+	vmassImageFini();
+
+tier_fini:
+	vmassTierFini();
+
+range_fini:
+	vmassRangeFini();
+
 free_storage_page:
 	vmassFreeStoragePage();
 
@@ -587,16 +495,7 @@ unregister_sys_event:
 	ksceKernelUnregisterSysEventHandler(sysevent_id);
 
 stop_thread:
-	ksceKernelSetEventFlag(evf_id, VMASS_REQ_EXIT);
-	ksceKernelWaitEventFlag(evf_id, VMASS_REQ_DONE, SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, NULL, NULL);
-
-	ksceKernelWaitThreadEnd(thid, NULL, NULL);
-
-del_thread:
-	ksceKernelDeleteThread(thid);
-
-del_evf:
-	ksceKernelDeleteEventFlag(evf_id);
+	vmassQueueFini();
 
 del_mtx:
 	ksceKernelDeleteFastMutex(&lw_mtx);
@@ -1,38 +1,251 @@
-﻿/*
- * PlayStation(R)Vita Virtual Mass Header
- * Copyright (C) 2020 Princess of Slepping
- *
- * This program is free software: you can redistribute it and/or modify
- * it under the terms of the GNU General Public License as published by
- * the Free Software Foundation, version 3 of the License.
- * This program is distributed in the hope that it will be useful,
- * but WITHOUT ANY WARRANTY; without even the implied warranty of
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
- * GNU General Public License for more details.
- * You should have received a copy of the GNU General Public License
- * along with this program.  If not, see <https://www.gnu.org/licenses/>.
- */
-
-#ifndef _VMASS_H_
-#define _VMASS_H_
-
-#include <stdint.h>
-#include <psp2/types.h>
-
-typedef struct SceUsbMassDevInfo {
-	SceSize number_of_all_sector;
-	int data_04;
-	SceSize sector_size;
-	int data_0C;
-} SceUsbMassDevInfo;
-
-int vmassInit(void);
-
-int vmassCreateImage(void);
-int vmassLoadImage(void);
-
-int vmassGetDevInfo(SceUsbMassDevInfo *info);
-int vmassReadSector(SceSize sector_pos, void *data, SceSize sector_num);
-int vmassWriteSector(SceSize sector_pos, const void *data, SceSize sector_num);
-
-#endif	/* _VMASS_H_ */
+﻿/*
+ * PlayStation(R)Vita Virtual Mass Header
+ * Copyright (C) 2020 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VMASS_H_
+#define _VMASS_H_
+
+#include <stdint.h>
+#include <psp2/types.h>
+
+typedef struct SceUsbMassDevInfo {
+	SceSize number_of_all_sector;
+	int data_04;
+	SceSize sector_size;
+	int data_0C;
+} SceUsbMassDevInfo;
+
+int vmassInit(void);
+
+int vmassCreateImage(void);
+int vmassLoadImage(void);
+
+/*
+ * Saves write a copy-on-write snapshot of the storage, so uma0: stays usable while they run. vmassSaveSnapshot starts
+ * one in the background, vmassWaitSnapshot waits for it and returns what vmassCreateImage returned. If no memory is
+ * left to copy a frozen block aside before a write, the save fails rather than write a torn image.
+ */
+int vmassSaveSnapshot(void);
+int vmassWaitSnapshot(void);
+
+/*
+ * Writes are tracked in granules of sector_num sectors (a power of two, 64KiB by default).
+ * vmassCreateImage only rewrites the dirty granules of the image the storage was loaded from or last saved to.
+ * A sparse image has no room for data outside its extents, so a non-zero write there makes the next save a full one.
+ */
+int vmassSetDirtyGranularity(SceSize sector_num);
+int vmassGetDirtySize(SceSize *dirty_size);
+
+/*
+ * Format of full saves. LZ images are compressed in 64KiB blocks, they are smaller but always saved in full.
+ * "image_format" in vmass.cfg sets it at boot.
+ */
+#define VMASS_IMAGE_SPARSE (0)
+#define VMASS_IMAGE_LZ     (1)
+
+int vmassSetImageFormat(int format);
+
+/*
+ * With VMASS_LOAD_LAZY, vmassLoadImage only reads the image header and a thread streams in the rest from the start
+ * of the storage. A request that reaches a part not loaded yet loads it first. vmassInit loads the image from
+ * module_start, so the boot load follows "load_mode" in vmass.cfg and vmassSetLoadMode only affects later loads.
+ */
+#define VMASS_LOAD_SYNC (0)
+#define VMASS_LOAD_LAZY (1)
+
+int vmassSetLoadMode(int mode);
+int vmassGetLoadProgress(SceSize *loaded_size, SceSize *total_size);
+
+/*
+ * Saves and loads stream the image file in chunks of size bytes (a power of two from 64KiB to 4MiB, 256KiB by default)
+ * through an I/O thread, which transfers one chunk while the next one is prepared.
+ */
+typedef struct VmassImageIoStat {
+	SceUInt64 read_bytes;
+	SceUInt64 read_time;      // us spent reading image files
+	SceUInt64 write_bytes;
+	SceUInt64 write_time;     // us spent writing image files
+	SceUInt64 last_load_time; // us from the start of the last vmassLoadImage until the storage was loaded
+	SceUInt64 last_save_time; // us the last vmassCreateImage took
+} VmassImageIoStat;
+
+int vmassSetImageIoChunk(SceSize size);
+int vmassGetImageIoStat(VmassImageIoStat *stat);
+
+/*
+ * With VMASS_JOURNAL_ON every accepted write is also appended to a journal on the card, committed at least every
+ * latency us (0 for 100ms). vmassInit replays a journal left on the card over the loaded image and saves, so a crash
+ * loses at most that window. "journal" and "journal_latency" in vmass.cfg turn it on from boot. It can also be turned on
+ * at runtime: nothing is replayed then, the writes not in the image yet are saved and the new journal starts after them.
+ * Turning it off removes the journal, writes since the last save then need vmassCreateImage.
+ */
+#define VMASS_JOURNAL_OFF (0)
+#define VMASS_JOURNAL_ON  (1)
+
+#define VMASS_JOURNAL_LATENCY_MIN (1000)
+#define VMASS_JOURNAL_LATENCY_MAX (10000000)
+
+int vmassSetJournalMode(int mode, SceUInt32 latency);
+int vmassFlushJournal(void);
+
+int vmassGetDevInfo(SceUsbMassDevInfo *info);
+int vmassReadSector(SceSize sector_pos, void *data, SceSize sector_num);
+int vmassWriteSector(SceSize sector_pos, const void *data, SceSize sector_num);
+
+/*
+ * Thin-provisioned storage only holds memory for chunks that were written with non-zero data.
+ */
+int vmassGetStorageUsage(SceSize *backed_size, SceSize *total_size);
+
+/*
+ * vmassReclaim reads the FAT of uma0: and gives back the memory of chunks that only hold free clusters.
+ * It trusts the FAT on the storage, so flush it with ksceIoSync("uma0:") first, and never call it while a USB host
+ * has the volume mounted: clusters allocated in a FAT that was not written back yet would lose their data.
+ * With VMASS_RECLAIM_AUTO it also runs in the background when a chunk can not be backed, only while uma0: is mounted
+ * and after syncing it. VMASS_RECLAIM_MANUAL is the default.
+ */
+#define VMASS_RECLAIM_MANUAL (0)
+#define VMASS_RECLAIM_AUTO   (1)
+
+int vmassReclaim(SceSize *reclaimed_size);
+int vmassSetReclaimMode(int mode);
+
+/*
+ * Compressed tier. Chunks idle for a few seconds are LZ compressed into a pool and decompressed on their next access.
+ */
+#define VMASS_TIER_OFF (0)
+#define VMASS_TIER_ON  (1)
+
+typedef struct VmassTierStat {
+	SceUInt64 hit_count;      // accesses served from uncompressed chunks while the tier is on
+	SceUInt64 miss_count;     // accesses that decompressed a chunk
+	SceUInt64 compress_count;
+	SceUInt64 reject_count;   // chunks that did not compress by an eighth or did not fit in the pool
+	SceUInt64 bounce_count;   // reads of compressed chunks served without memory to decompress them into
+	SceSize compressed_num;   // chunks currently compressed
+	SceSize compressed_size;  // pool bytes they use
+	SceSize original_size;    // bytes they hold
+} VmassTierStat;
+
+int vmassSetTierMode(int mode);
+int vmassTierScan(SceUInt32 idle_scans); // compress chunks idle for idle_scans scans, 0 compresses every chunk now
+int vmassGetTierStat(VmassTierStat *stat);
+
+/*
+ * Requests are split across the RW workers when each chunk gets at least the split threshold sectors.
+ * Thresholds are kept per page memtype, memtype 0 is the default for every other memtype.
+ */
+#define VMASS_SPLIT_NEVER (0xFFFFFFFF)
+
+#define VMASS_CALIBRATE_OFF  (0) // keep the built-in or vmassSetSplitThreshold values
+#define VMASS_CALIBRATE_INIT (1) // calibrate at vmassInit and on vmassCalibrate
+
+int vmassCalibrate(void);
+int vmassSetCalibrateMode(int mode);
+int vmassGetSplitThreshold(SceUInt32 memtype, SceSize *read_split_sector, SceSize *write_split_sector);
+int vmassSetSplitThreshold(SceUInt32 memtype, SceSize read_split_sector, SceSize write_split_sector);
+
+/*
+ * Sector copies of at least the DMAC threshold whose buffers share cache line alignment go through ksceDmacMemcpy.
+ */
+#define VMASS_DMAC_COPY_OFF (0)
+
+typedef struct VmassCopyStat {
+	SceUInt64 cpu_count;
+	SceUInt64 cpu_bytes;
+	SceUInt64 dmac_count;
+	SceUInt64 dmac_bytes;
+	SceUInt64 aligned_count;   // CPU copies that used the aligned kernel
+	SceUInt64 unaligned_count; // CPU copies that used the unaligned kernel
+} VmassCopyStat;
+
+int vmassSetDmacCopyThreshold(SceSize size);
+int vmassGetCopyStat(VmassCopyStat *stat);
+
+/*
+ * Request counters and latency histograms, always on. Latencies are in us from the request entering vmass until it completes.
+ * Bucket n of a histogram counts latencies from 2^(n-1) to 2^n - 1 us, bucket 0 those under 1us and the last one everything longer.
+ * Size classes are requests of up to 4KiB, 64KiB, 512KiB and larger.
+ */
+#define VMASS_STAT_SIZE_NUM    (4)
+#define VMASS_STAT_LATENCY_NUM (16)
+
+#define VMASS_STAT_RESET (1)
+
+typedef struct VmassStat {
+	SceUInt64 read_count;
+	SceUInt64 read_bytes;
+	SceUInt64 write_count;
+	SceUInt64 write_bytes;
+	SceUInt64 queue_count;     // request chunks queued for the RW workers
+	SceUInt64 inline_count;    // request chunks run directly by the submitting thread
+	SceUInt64 lock_wait_count; // requests that waited for an overlapping request
+	SceUInt64 lock_wait_time;  // us they waited
+	SceUInt64 read_latency[VMASS_STAT_SIZE_NUM][VMASS_STAT_LATENCY_NUM];
+	SceUInt64 write_latency[VMASS_STAT_SIZE_NUM][VMASS_STAT_LATENCY_NUM];
+} VmassStat;
+
+int vmassGetStat(VmassStat *stat, int reset); // VMASS_STAT_RESET also zeroes the counters it returns
+
+/*
+ * With VMASS_TRACE_ON every request is recorded in a ring of record_num entries (a power of two from 0x100 to 0x40000,
+ * 0 for 0x4000), the oldest overwritten first. vmassDumpTrace writes the ring to path, VMASS_TRACE_PATH if NULL,
+ * and it is also dumped on shutdown. Turning it on again starts an empty trace.
+ */
+#define VMASS_TRACE_OFF (0)
+#define VMASS_TRACE_ON  (1)
+
+#define VMASS_TRACE_PATH "ux0:data/vmass.trace"
+
+#define VMASS_TRACE_RECORD_MIN (0x100)
+#define VMASS_TRACE_RECORD_MAX (0x40000)
+#define VMASS_TRACE_RECORD_DEF (0x4000)
+
+int vmassSetTraceMode(int mode, SceSize record_num);
+int vmassDumpTrace(const char *path);
+
+/*
+ * Asynchronous requests. Each submitted request must be reaped with vmassWaitRequest or vmassPollRequest.
+ * Requests that overlap run in submit order, disjoint requests run concurrently. A reaped request, or one whose
+ * submit failed, has a tag of -1, and waiting on or polling it again returns < 0.
+ */
+#define VMASS_REQUEST_PENDING (1)
+
+typedef struct VmassRequest VmassRequest;
+
+typedef void (* VmassRequestCallback)(VmassRequest *req, void *argp);
+
+struct VmassRequest {
+	// set by the submitter, cb is called by the thread that completes the request
+	VmassRequestCallback cb;
+	void *argp;
+
+	// owned by vmass while the request is in flight
+	int res;
+	int tag;
+	int internal;
+	unsigned int opcode;
+	SceSize sector_pos;
+	SceSize sector_num;
+	void *data;
+	SceSize remaining;
+	SceUInt32 time_s;
+};
+
+int vmassSubmitReadSector(VmassRequest *req, SceSize sector_pos, void *data, SceSize sector_num);
+int vmassSubmitWriteSector(VmassRequest *req, SceSize sector_pos, const void *data, SceSize sector_num);
+int vmassWaitRequest(VmassRequest *req, SceUInt *timeout);
+int vmassPollRequest(VmassRequest *req);
+
+#endif	/* _VMASS_H_ */
@@ -0,0 +1,273 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Split Threshold Calibration
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/threadmgr.h>
+#include <psp2kern/kernel/sysmem.h>
+#include <psp2kern/kernel/sysclib.h>
+#include <psp2kern/kernel/dmac.h>
+#include "vmass.h"
+#include "vmass_page.h"
+#include "vmass_internal.h"
+
+#define VMASS_SPLIT_INFO_MAX (8)
+
+#define VMASS_CALIB_BUFFER_SIZE (0x40000)
+#define VMASS_CALIB_SPLIT_MIN   (0x8)
+#define VMASS_CALIB_LOOP        (0x10)
+#define VMASS_CALIB_ROUND       (3)
+
+typedef struct VmassSplitInfo {
+	SceUInt32 memtype;
+	int calibrated;
+	SceSize read_split_sector;
+	SceSize write_split_sector;
+} VmassSplitInfo;
+
+/*
+ * Entry 0 holds the defaults used for pages whose memtype has no entry of its own.
+ */
+VmassSplitInfo vmass_split_info[VMASS_SPLIT_INFO_MAX] = {
+	{0, 0, 0x50, 0x20}
+};
+int vmass_split_info_num = 1;
+
+int vmass_calibrate_mode = VMASS_CALIBRATE_INIT;
+
+VmassSplitInfo *vmassFindSplitInfo(SceUInt32 memtype){
+
+	int i;
+
+	for(i=1;i<vmass_split_info_num;i++){
+		if(vmass_split_info[i].memtype == memtype)
+			return &vmass_split_info[i];
+	}
+
+	return NULL;
+}
+
+VmassSplitInfo *vmassAddSplitInfo(SceUInt32 memtype){
+
+	VmassSplitInfo *info;
+
+	if(memtype == 0)
+		return &vmass_split_info[0];
+
+	info = vmassFindSplitInfo(memtype);
+	if(info != NULL)
+		return info;
+
+	if(vmass_split_info_num == VMASS_SPLIT_INFO_MAX)
+		return NULL;
+
+	info = &vmass_split_info[vmass_split_info_num];
+	info->memtype            = memtype;
+	info->calibrated         = 0;
+	info->read_split_sector  = vmass_split_info[0].read_split_sector;
+	info->write_split_sector = vmass_split_info[0].write_split_sector;
+
+	vmass_split_info_num++;
+
+	return info;
+}
+
+VmassSplitInfo *vmassGetSplitInfo(SceSize sector_pos){
+
+	int page_idx;
+	VmassSplitInfo *info = NULL;
+
+	page_idx = vmassPageLookup(sector_pos << 9);
+	if(page_idx >= 0 && vmass_split_info_num > 1)
+		info = vmassFindSplitInfo(vmass_page_list[page_idx].memtype);
+
+	return (info != NULL) ? info : &vmass_split_info[0];
+}
+
+SceSize vmassGetReadSplitSector(SceSize sector_pos){
+	return vmassGetSplitInfo(sector_pos)->read_split_sector;
+}
+
+SceSize vmassGetWriteSplitSector(SceSize sector_pos){
+	return vmassGetSplitInfo(sector_pos)->write_split_sector;
+}
+
+SceInt64 vmassCalibrateTime(unsigned int opcode, SceSize sector_pos, void *buf, SceSize sector_num, SceSize split_sector){
+
+	int i, round;
+	SceInt64 time_s, time, time_min = -1;
+
+	for(round=0;round<VMASS_CALIB_ROUND;round++){
+		time_s = ksceKernelGetSystemTimeWide();
+
+		for(i=0;i<VMASS_CALIB_LOOP;i++)
+			vmassSplitSector(opcode, sector_pos, buf, sector_num, split_sector);
+
+		time = ksceKernelGetSystemTimeWide() - time_s;
+		if(time_min < 0 || time < time_min)
+			time_min = time;
+	}
+
+	return time_min;
+}
+
+/*
+ * Find the smallest per-worker chunk for which fanning the copy out to every worker beats copying it inline.
+ * Writes put back what was just read from the page, so the storage content is not changed.
+ */
+SceSize vmassCalibrateOp(unsigned int opcode, const VmassPageInfo *page, void *buf){
+
+	SceSize split, sector_pos, sector_num, max_sector;
+	SceInt64 time_inline, time_split;
+
+	if(vmass_worker_num <= 1)
+		return VMASS_SPLIT_NEVER;
+
+	sector_pos = page->offset >> 9;
+	max_sector = vmassPageGetTotalSize() - page->offset;
+	if(max_sector > VMASS_CALIB_BUFFER_SIZE)
+		max_sector = VMASS_CALIB_BUFFER_SIZE;
+
+	max_sector >>= 9;
+
+	for(split=VMASS_CALIB_SPLIT_MIN;(split * vmass_worker_num)<=max_sector;split<<=1){
+		sector_num = split * vmass_worker_num;
+
+		if(opcode == VMASS_REQ_WRITE)
+			_vmassReadSector(sector_pos, buf, sector_num);
+
+		time_inline = vmassCalibrateTime(opcode, sector_pos, buf, sector_num, VMASS_SPLIT_NEVER);
+		time_split  = vmassCalibrateTime(opcode, sector_pos, buf, sector_num, split);
+
+		if(time_split < time_inline)
+			return split;
+	}
+
+	return VMASS_SPLIT_NEVER;
+}
+
+int vmassCalibrate(void){
+
+	int i;
+	void *buf, *borrow;
+	SceUID memid, borrow_id = -1;
+	VmassSplitInfo *info;
+
+	memid = ksceKernelAllocMemBlock("VmassCalibBuffer", 0x1020D006, VMASS_CALIB_BUFFER_SIZE, NULL);
+	if(memid < 0)
+		return memid;
+
+	ksceKernelGetMemBlockBase(memid, &buf);
+
+	vmassQueueBlock();
+
+	for(i=0;i<vmass_split_info_num;i++)
+		vmass_split_info[i].calibrated = 0;
+
+	for(i=0;i<vmass_page_num;i++){
+		info = vmassAddSplitInfo(vmass_page_list[i].memtype);
+		if(info == NULL || info->calibrated != 0)
+			continue;
+
+		/*
+		 * Unbacked thin pages would only time memset, so they borrow a zeroed block of their memtype instead.
+		 */
+		if((vmass_page_list[i].flags & VMASS_PAGE_THIN) != 0){
+			borrow_id = ksceKernelAllocMemBlock("VmassCalibStorage", vmass_page_list[i].memtype, VMASS_CALIB_BUFFER_SIZE, NULL);
+			if(borrow_id < 0)
+				continue;
+
+			ksceKernelGetMemBlockBase(borrow_id, &borrow);
+			ksceDmacMemset(borrow, 0, VMASS_CALIB_BUFFER_SIZE);
+
+			vmassPageBorrow(vmass_page_list[i].offset, borrow, VMASS_CALIB_BUFFER_SIZE);
+		}
+
+		info->read_split_sector  = vmassCalibrateOp(VMASS_REQ_READ, &vmass_page_list[i], buf);
+		info->write_split_sector = vmassCalibrateOp(VMASS_REQ_WRITE, &vmass_page_list[i], buf);
+		info->calibrated         = 1;
+
+		if(borrow_id >= 0){
+			vmassPageReturn(vmass_page_list[i].offset, VMASS_CALIB_BUFFER_SIZE);
+			ksceKernelFreeMemBlock(borrow_id);
+			borrow_id = -1;
+		}
+
+		/*
+		 * The first page also sets the defaults for memtypes without an entry.
+		 */
+		if(i == 0 && info != &vmass_split_info[0]){
+			vmass_split_info[0].read_split_sector  = info->read_split_sector;
+			vmass_split_info[0].write_split_sector = info->write_split_sector;
+		}
+	}
+
+	vmassQueueUnblock();
+
+	ksceKernelFreeMemBlock(memid);
+
+	return 0;
+}
+
+int vmassCalibrateInit(void){
+
+	if(vmass_calibrate_mode == VMASS_CALIBRATE_OFF)
+		return 0;
+
+	return vmassCalibrate();
+}
+
+int vmassSetCalibrateMode(int mode){
+
+	if(mode != VMASS_CALIBRATE_OFF && mode != VMASS_CALIBRATE_INIT)
+		return -1;
+
+	vmass_calibrate_mode = mode;
+
+	return 0;
+}
+
+int vmassGetSplitThreshold(SceUInt32 memtype, SceSize *read_split_sector, SceSize *write_split_sector){
+
+	VmassSplitInfo *info;
+
+	info = (memtype == 0) ? &vmass_split_info[0] : vmassFindSplitInfo(memtype);
+	if(info == NULL)
+		return -1;
+
+	if(read_split_sector != NULL)
+		*read_split_sector = info->read_split_sector;
+
+	if(write_split_sector != NULL)
+		*write_split_sector = info->write_split_sector;
+
+	return 0;
+}
+
+int vmassSetSplitThreshold(SceUInt32 memtype, SceSize read_split_sector, SceSize write_split_sector){
+
+	VmassSplitInfo *info;
+
+	if(read_split_sector == 0 || write_split_sector == 0)
+		return -1;
+
+	info = vmassAddSplitInfo(memtype);
+	if(info == NULL)
+		return -1;
+
+	info->read_split_sector  = read_split_sector;
+	info->write_split_sector = write_split_sector;
+	info->calibrated         = 1;
+
+	return 0;
+}
@@ -0,0 +1,513 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Config
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/sysmem.h>
+#include <psp2kern/kernel/sysclib.h>
+#include <psp2kern/kernel/iofilemgr.h>
+#include <psp2kern/io/fcntl.h>
+#include "vmass.h"
+#include "vmass_config.h"
+#include "vmass_internal.h"
+
+#define VMASS_CONFIG_PRIORITY_MIN   (0x01)
+#define VMASS_CONFIG_PRIORITY_MAX   (0xFE)
+#define VMASS_CONFIG_STACK_SIZE_MIN (0x1000)
+#define VMASS_CONFIG_STACK_SIZE_MAX (0x10000)
+#define VMASS_CONFIG_CPU_MASK       (0xF)
+#define VMASS_CONFIG_SIZE_MIN       (0x10000)
+
+/*
+ * The value of a line, split into whitespace separated words.
+ */
+#define VMASS_CONFIG_WORD_MAX (4)
+
+typedef struct VmassConfigLine {
+	const char *key;
+	SceSize key_len;
+	int word_num;
+	const char *word[VMASS_CONFIG_WORD_MAX];
+	SceSize word_len[VMASS_CONFIG_WORD_MAX];
+} VmassConfigLine;
+
+static int vmassConfigIsSpace(char c){
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static int vmassConfigKeyIs(const VmassConfigLine *line, const char *key){
+	return line->key_len == strlen(key) && memcmp(line->key, key, line->key_len) == 0;
+}
+
+static int vmassConfigWordIs(const VmassConfigLine *line, int idx, const char *word){
+	return line->word_len[idx] == strlen(word) && memcmp(line->word[idx], word, line->word_len[idx]) == 0;
+}
+
+/*
+ * Decimal or 0x hex, with an optional K, M or G suffix. Returns < 0 on anything else or on overflow.
+ */
+static int vmassConfigNumber(const char *s, SceSize len, SceSize *value){
+
+	int base = 10, shift = 0, digit;
+	SceUInt64 v = 0;
+	SceSize i = 0;
+
+	if(len > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')){
+		base = 16;
+		i    = 2;
+	}
+
+	switch((len > i) ? s[len - 1] : 0){
+	case 'K': case 'k': shift = 10; len--; break;
+	case 'M': case 'm': shift = 20; len--; break;
+	case 'G': case 'g': shift = 30; len--; break;
+	}
+
+	if(i == len)
+		return -1;
+
+	for(;i<len;i++){
+		if(s[i] >= '0' && s[i] <= '9')
+			digit = s[i] - '0';
+		else if(base == 16 && s[i] >= 'a' && s[i] <= 'f')
+			digit = s[i] - 'a' + 10;
+		else if(base == 16 && s[i] >= 'A' && s[i] <= 'F')
+			digit = s[i] - 'A' + 10;
+		else
+			return -1;
+
+		v = v * base + digit;
+		if(v > 0xFFFFFFFF)
+			return -1;
+	}
+
+	v <<= shift;
+	if(v > 0xFFFFFFFF)
+		return -1;
+
+	*value = (SceSize)v;
+
+	return 0;
+}
+
+static int vmassConfigWordNumber(const VmassConfigLine *line, int idx, SceSize *value){
+	return vmassConfigNumber(line->word[idx], line->word_len[idx], value);
+}
+
+static int vmassConfigSize(const VmassConfigLine *line, int idx, SceSize *size){
+
+	if(vmassConfigWordNumber(line, idx, size) < 0)
+		return -1;
+
+	if(*size < VMASS_CONFIG_SIZE_MIN || (*size & (VMASS_CONFIG_SIZE_MIN - 1)) != 0)
+		return -1;
+
+	return 0;
+}
+
+static int vmassConfigSplitSector(const VmassConfigLine *line, int idx, SceSize *sector_num){
+
+	if(vmassConfigWordIs(line, idx, "never")){
+		*sector_num = VMASS_SPLIT_NEVER;
+		return 0;
+	}
+
+	if(vmassConfigWordNumber(line, idx, sector_num) < 0 || *sector_num == 0)
+		return -1;
+
+	return 0;
+}
+
+static int vmassConfigPriority(const VmassConfigLine *line, int *priority){
+
+	SceSize value;
+
+	if(line->word_num != 1 || vmassConfigWordNumber(line, 0, &value) < 0)
+		return -1;
+
+	if(value < VMASS_CONFIG_PRIORITY_MIN || value > VMASS_CONFIG_PRIORITY_MAX)
+		return -1;
+
+	*priority = value;
+
+	return 0;
+}
+
+static int vmassConfigApplyLine(VmassConfig *cfg, const VmassConfigLine *line){
+
+	SceSize value;
+	VmassStorageMemtype *memtype;
+	VmassConfigSplit *split;
+
+	if(vmassConfigKeyIs(line, "capacity")){
+		if(line->word_num != 1 || vmassConfigSize(line, 0, &value) < 0)
+			return -1;
+
+		cfg->capacity = value;
+
+	}else if(vmassConfigKeyIs(line, "memtype")){
+		if(line->word_num < 1 || line->word_num > 2 || cfg->memtype_num == VMASS_STORAGE_MEMTYPE_MAX)
+			return -1;
+
+		memtype = &cfg->memtype[cfg->memtype_num];
+
+		if(vmassConfigWordNumber(line, 0, &value) < 0 || value == 0)
+			return -1;
+
+		memtype->memtype  = value;
+		memtype->max_size = 0;
+
+		if(line->word_num == 2 && vmassConfigSize(line, 1, &memtype->max_size) < 0)
+			return -1;
+
+		cfg->memtype_num++;
+
+	}else if(vmassConfigKeyIs(line, "cluster_size")){
+		if(line->word_num != 1 || vmassConfigWordNumber(line, 0, &value) < 0)
+			return -1;
+
+		if(value < 0x200 || value > 0x10000 || (value & (value - 1)) != 0)
+			return -1;
+
+		cfg->cluster_size = value;
+
+	}else if(vmassConfigKeyIs(line, "cluster_align")){
+		if(line->word_num != 1 || vmassConfigWordNumber(line, 0, &value) < 0)
+			return -1;
+
+		if(value < 0x200 || value > 0x100000 || (value & (value - 1)) != 0)
+			return -1;
+
+		cfg->cluster_align = value;
+
+	}else if(vmassConfigKeyIs(line, "trace")){
+		if(line->word_num != 1 || vmassConfigWordNumber(line, 0, &value) < 0)
+			return -1;
+
+		if(value < VMASS_TRACE_RECORD_MIN || value > VMASS_TRACE_RECORD_MAX || (value & (value - 1)) != 0)
+			return -1;
+
+		cfg->trace_record_num = value;
+
+	}else if(vmassConfigKeyIs(line, "rw_priority")){
+		return vmassConfigPriority(line, &cfg->rw_priority);
+
+	}else if(vmassConfigKeyIs(line, "rw_work_priority")){
+		return vmassConfigPriority(line, &cfg->rw_work_priority);
+
+	}else if(vmassConfigKeyIs(line, "rw_stack_size")){
+		if(line->word_num != 1 || vmassConfigWordNumber(line, 0, &value) < 0)
+			return -1;
+
+		if(value < VMASS_CONFIG_STACK_SIZE_MIN || value > VMASS_CONFIG_STACK_SIZE_MAX || (value & 0xFFF) != 0)
+			return -1;
+
+		cfg->rw_stack_size = value;
+
+	}else if(vmassConfigKeyIs(line, "rw_cpu_mask")){
+		if(line->word_num != 1 || vmassConfigWordNumber(line, 0, &value) < 0)
+			return -1;
+
+		if(value == 0 || (value & ~VMASS_CONFIG_CPU_MASK) != 0)
+			return -1;
+
+		cfg->rw_cpu_mask = value;
+
+	}else if(vmassConfigKeyIs(line, "split")){
+		if(line->word_num != 3 || cfg->split_num == VMASS_CONFIG_SPLIT_MAX)
+			return -1;
+
+		split = &cfg->split[cfg->split_num];
+
+		if(vmassConfigWordNumber(line, 0, &value) < 0
+			|| vmassConfigSplitSector(line, 1, &split->read_split_sector) < 0
+			|| vmassConfigSplitSector(line, 2, &split->write_split_sector) < 0)
+			return -1;
+
+		split->memtype = value;
+
+		cfg->split_num++;
+
+	}else if(vmassConfigKeyIs(line, "calibrate")){
+		if(line->word_num != 1)
+			return -1;
+
+		if(vmassConfigWordIs(line, 0, "off"))
+			cfg->calibrate_mode = VMASS_CALIBRATE_OFF;
+		else if(vmassConfigWordIs(line, 0, "init"))
+			cfg->calibrate_mode = VMASS_CALIBRATE_INIT;
+		else
+			return -1;
+
+	}else if(vmassConfigKeyIs(line, "thin")){
+		if(line->word_num != 1)
+			return -1;
+
+		if(vmassConfigWordIs(line, 0, "off"))
+			cfg->thin_mode = 0;
+		else if(vmassConfigWordIs(line, 0, "on"))
+			cfg->thin_mode = 1;
+		else
+			return -1;
+
+	}else if(vmassConfigKeyIs(line, "reclaim")){
+		if(line->word_num != 1)
+			return -1;
+
+		if(vmassConfigWordIs(line, 0, "manual"))
+			cfg->reclaim_mode = VMASS_RECLAIM_MANUAL;
+		else if(vmassConfigWordIs(line, 0, "auto"))
+			cfg->reclaim_mode = VMASS_RECLAIM_AUTO;
+		else
+			return -1;
+
+	}else if(vmassConfigKeyIs(line, "load_mode")){
+		if(line->word_num != 1)
+			return -1;
+
+		if(vmassConfigWordIs(line, 0, "sync"))
+			cfg->load_mode = VMASS_LOAD_SYNC;
+		else if(vmassConfigWordIs(line, 0, "lazy"))
+			cfg->load_mode = VMASS_LOAD_LAZY;
+		else
+			return -1;
+
+	}else if(vmassConfigKeyIs(line, "image_format")){
+		if(line->word_num != 1)
+			return -1;
+
+		if(vmassConfigWordIs(line, 0, "sparse"))
+			cfg->image_format = VMASS_IMAGE_SPARSE;
+		else if(vmassConfigWordIs(line, 0, "lz"))
+			cfg->image_format = VMASS_IMAGE_LZ;
+		else
+			return -1;
+
+	}else if(vmassConfigKeyIs(line, "journal")){
+		if(line->word_num != 1)
+			return -1;
+
+		if(vmassConfigWordIs(line, 0, "off"))
+			cfg->journal_mode = VMASS_JOURNAL_OFF;
+		else if(vmassConfigWordIs(line, 0, "on"))
+			cfg->journal_mode = VMASS_JOURNAL_ON;
+		else
+			return -1;
+
+	}else if(vmassConfigKeyIs(line, "journal_latency")){
+		if(line->word_num != 1 || vmassConfigWordNumber(line, 0, &value) < 0)
+			return -1;
+
+		if(value < VMASS_JOURNAL_LATENCY_MIN || value > VMASS_JOURNAL_LATENCY_MAX)
+			return -1;
+
+		cfg->journal_latency = value;
+
+	}else if(vmassConfigKeyIs(line, "image_path")){
+		if(line->word_num != 1 || cfg->image_path_num == VMASS_IMAGE_PATH_MAX)
+			return -1;
+
+		if(line->word_len[0] >= VMASS_IMAGE_PATH_LEN || memchr(line->word[0], ':', line->word_len[0]) == NULL)
+			return -1;
+
+		memcpy(cfg->image_path[cfg->image_path_num], line->word[0], line->word_len[0]);
+		cfg->image_path[cfg->image_path_num][line->word_len[0]] = 0;
+
+		cfg->image_path_num++;
+
+	}else{
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Split [s, end) into key and words. Returns 0 for a blank or comment line, 1 for a line to apply, < 0 if malformed.
+ */
+static int vmassConfigSplitLine(VmassConfigLine *line, const char *s, const char *end){
+
+	const char *p;
+
+	p = memchr(s, '#', end - s);
+	if(p != NULL)
+		end = p;
+
+	while(s < end && vmassConfigIsSpace(*s))
+		s++;
+
+	while(end > s && vmassConfigIsSpace(end[-1]))
+		end--;
+
+	if(s == end)
+		return 0;
+
+	p = memchr(s, '=', end - s);
+	if(p == NULL)
+		return -1;
+
+	line->key = s;
+	for(s=p;s>line->key && vmassConfigIsSpace(s[-1]);s--);
+
+	line->key_len  = s - line->key;
+	line->word_num = 0;
+
+	for(s=p+1;s<end;){
+		if(vmassConfigIsSpace(*s)){
+			s++;
+			continue;
+		}
+
+		if(line->word_num == VMASS_CONFIG_WORD_MAX)
+			return -1;
+
+		line->word[line->word_num] = s;
+		while(s < end && !vmassConfigIsSpace(*s))
+			s++;
+
+		line->word_len[line->word_num] = s - line->word[line->word_num];
+		line->word_num++;
+	}
+
+	if(line->key_len == 0 || line->word_num == 0)
+		return -1;
+
+	return 1;
+}
+
+void vmassConfigClear(VmassConfig *cfg){
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->calibrate_mode = -1;
+	cfg->thin_mode      = -1;
+	cfg->reclaim_mode   = -1;
+	cfg->load_mode      = -1;
+	cfg->image_format   = -1;
+	cfg->journal_mode   = -1;
+}
+
+int vmassConfigParse(VmassConfig *cfg, const char *text, SceSize size){
+
+	int res;
+	const char *end = text + size, *eol;
+	SceSize line_no = 0;
+	VmassConfigLine line;
+
+	while(text < end){
+		eol = memchr(text, '\n', end - text);
+		if(eol == NULL)
+			eol = end;
+
+		line_no++;
+
+		res = vmassConfigSplitLine(&line, text, eol);
+		if(res > 0)
+			res = vmassConfigApplyLine(cfg, &line);
+
+		if(res < 0){
+			if(cfg->reject_num == 0)
+				cfg->reject_line = line_no;
+
+			cfg->reject_num++;
+		}
+
+		text = eol + 1;
+	}
+
+	return cfg->reject_num;
+}
+
+int vmassConfigLoad(VmassConfig *cfg, const char *path){
+
+	int res;
+	char *text;
+	SceUID fd;
+
+	vmassConfigClear(cfg);
+
+	fd = ksceIoOpen(path, SCE_O_RDONLY, 0);
+	if(fd < 0)
+		return fd;
+
+	text = ksceKernelAllocHeapMemory(VMASS_KERNEL_HEAP, VMASS_CONFIG_FILE_MAX);
+	if(text == NULL){
+		ksceIoClose(fd);
+		return -1;
+	}
+
+	res = ksceIoRead(fd, text, VMASS_CONFIG_FILE_MAX);
+	if(res >= 0)
+		res = vmassConfigParse(cfg, text, res);
+
+	ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, text);
+	ksceIoClose(fd);
+
+	return res;
+}
+
+int vmassConfigApply(const VmassConfig *cfg){
+
+	SceSize i, capacity, memtype_num;
+	VmassStorageMemtype memtype[VMASS_STORAGE_MEMTYPE_MAX];
+
+	if(cfg->capacity != 0 || cfg->memtype_num != 0){
+		capacity    = (cfg->capacity != 0) ? cfg->capacity : vmass_storage_capacity;
+		memtype_num = (cfg->memtype_num != 0) ? cfg->memtype_num : vmass_storage_memtype_num;
+
+		memcpy(memtype, (cfg->memtype_num != 0) ? cfg->memtype : vmass_storage_memtype, sizeof(*memtype) * memtype_num);
+
+		vmassSetStorageCapacity(capacity, memtype, memtype_num);
+	}
+
+	if(cfg->cluster_size != 0)
+		vmassSetFormatClusterSize(cfg->cluster_size);
+
+	if(cfg->cluster_align != 0)
+		vmassSetFormatAlign(cfg->cluster_align);
+
+	if(cfg->trace_record_num != 0)
+		vmassSetTraceMode(VMASS_TRACE_ON, cfg->trace_record_num);
+
+	vmassQueueSetWorker(cfg->rw_priority, cfg->rw_work_priority, cfg->rw_stack_size, cfg->rw_cpu_mask);
+
+	for(i=0;i<cfg->split_num;i++)
+		vmassSetSplitThreshold(cfg->split[i].memtype, cfg->split[i].read_split_sector, cfg->split[i].write_split_sector);
+
+	// calibrating would replace the splits just given
+	if(cfg->calibrate_mode >= 0)
+		vmassSetCalibrateMode(cfg->calibrate_mode);
+	else if(cfg->split_num != 0)
+		vmassSetCalibrateMode(VMASS_CALIBRATE_OFF);
+
+	if(cfg->thin_mode >= 0)
+		vmass_thin_provision = cfg->thin_mode;
+
+	if(cfg->reclaim_mode >= 0)
+		vmassSetReclaimMode(cfg->reclaim_mode);
+
+	if(cfg->load_mode >= 0)
+		vmassSetLoadMode(cfg->load_mode);
+
+	if(cfg->image_format >= 0)
+		vmassSetImageFormat(cfg->image_format);
+
+	// before vmassJournalInit, so a journal turned on here also replays
+	if(cfg->journal_mode >= 0 || cfg->journal_latency != 0)
+		vmassSetJournalMode((cfg->journal_mode >= 0) ? cfg->journal_mode : VMASS_JOURNAL_OFF, cfg->journal_latency);
+
+	if(cfg->image_path_num != 0){
+		vmassImageSetPath(cfg->image_path, cfg->image_path_num);
+		vmassJournalSetPath(cfg->image_path, cfg->image_path_num);
+	}
+
+	return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Config Header
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VMASS_CONFIG_H_
+#define _VMASS_CONFIG_H_
+
+#include <psp2kern/types.h>
+#include "vmass.h"
+#include "vmass_page.h"
+
+/*
+ * vmassInit reads VMASS_CONFIG_PATH if it exists. Each line is "key = value", "#" starts a comment.
+ * Numbers are decimal or 0x hex with an optional K, M or G suffix. A line that does not parse or is out of range
+ * is skipped and the value keeps its built-in default.
+ *
+ *   capacity = 32M
+ *   memtype = 0x1080D006 8M    # memtype [max size], repeated in priority order
+ *   cluster_size = 0x8000      # cluster size when uma0: is formatted
+ *   cluster_align = 64K        # alignment of its data region
+ *   trace = 0x4000             # trace the requests in a ring of that many records
+ *   rw_priority = 0x6E         # RW workers while idle
+ *   rw_work_priority = 0x28    # RW workers while copying
+ *   rw_stack_size = 0x1000
+ *   rw_cpu_mask = 0xF          # one RW worker is pinned to each core of the mask
+ *   split = 0 0x50 0x20        # memtype read write, 0 is the default memtype, "never" never splits
+ *   calibrate = off            # off or init, off by default once a split is given
+ *   thin = on                  # on or off, back the storage in 64KiB chunks on the first non-zero write
+ *   reclaim = auto             # manual or auto, auto reclaims in the background once uma0: is synced
+ *   load_mode = lazy           # sync or lazy, how vmassInit loads the image
+ *   image_format = lz          # sparse or lz, format of full saves
+ *   journal = on               # on or off
+ *   journal_latency = 50000    # us between journal commits
+ *   image_path = sd0:vmass.img # repeated in priority order, the journal goes next to it as .jnl
+ */
+#define VMASS_CONFIG_PATH "ux0:data/vmass.cfg"
+
+#define VMASS_CONFIG_FILE_MAX (0x2000)
+
+#define VMASS_CONFIG_SPLIT_MAX (8)
+
+#define VMASS_IMAGE_PATH_MAX (4)
+#define VMASS_IMAGE_PATH_LEN (0x80)
+
+typedef struct VmassConfigSplit {
+	SceUInt32 memtype;
+	SceSize read_split_sector;
+	SceSize write_split_sector;
+} VmassConfigSplit;
+
+/*
+ * Zero, or -1 for the modes, leaves a value at its built-in default.
+ */
+typedef struct VmassConfig {
+	SceSize capacity;
+	SceSize memtype_num;
+	VmassStorageMemtype memtype[VMASS_STORAGE_MEMTYPE_MAX];
+	SceSize cluster_size;
+	SceSize cluster_align;
+	SceSize trace_record_num;
+	int rw_priority;
+	int rw_work_priority;
+	SceSize rw_stack_size;
+	SceUInt32 rw_cpu_mask;
+	SceSize split_num;
+	VmassConfigSplit split[VMASS_CONFIG_SPLIT_MAX];
+	int calibrate_mode;
+	int thin_mode;
+	int reclaim_mode;
+	int load_mode;
+	int image_format;
+	int journal_mode;
+	SceUInt32 journal_latency;
+	SceSize image_path_num;
+	char image_path[VMASS_IMAGE_PATH_MAX][VMASS_IMAGE_PATH_LEN];
+
+	SceSize reject_num;  // lines skipped
+	SceSize reject_line; // first skipped line, 1 based
+} VmassConfig;
+
+void vmassConfigClear(VmassConfig *cfg);
+int vmassConfigParse(VmassConfig *cfg, const char *text, SceSize size);
+
+/*
+ * Reads and parses path. Returns < 0 if it can not be read, cfg is cleared then.
+ */
+int vmassConfigLoad(VmassConfig *cfg, const char *path);
+
+/*
+ * Applies the values cfg sets. Call it at the start of vmassInit.
+ */
+int vmassConfigApply(const VmassConfig *cfg);
+
+#endif	/* _VMASS_CONFIG_H_ */
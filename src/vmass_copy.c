@@ -0,0 +1,180 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Copy
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/sysclib.h>
+#include <psp2kern/kernel/dmac.h>
+#include "vmass.h"
+#include "vmass_copy.h"
+
+/*
+ * The DMAC only gets the cache line aligned body of a copy, the head and tail are copied by the CPU.
+ */
+#define VMASS_DMAC_ALIGN (0x40)
+
+SceSize g_dmac_copy_min = 0x10000;
+
+VmassCopyStat vmass_copy_stat;
+
+#if defined(__arm__)
+
+/*
+ * Cortex-A9 kernels, 64 bytes (two cache lines on the L1 read port) per iteration with the source prefetched 4 lines ahead.
+ * size must be a non-zero multiple of VMASS_COPY_KERNEL_BLOCK.
+ */
+void vmassCopyKernelAligned(void *dst, const void *src, SceSize size){
+	asm volatile (
+		".fpu neon\n"
+		"1:\n"
+		"pld [%1, #0x100]\n"
+		"vld1.64 {d0-d3}, [%1, :128]!\n"
+		"vld1.64 {d4-d7}, [%1, :128]!\n"
+		"subs %2, %2, #0x40\n"
+		"vst1.64 {d0-d3}, [%0, :128]!\n"
+		"vst1.64 {d4-d7}, [%0, :128]!\n"
+		"bne 1b\n"
+		: "+r"(dst), "+r"(src), "+r"(size)
+		:
+		: "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7", "cc", "memory"
+	);
+}
+
+void vmassCopyKernelUnaligned(void *dst, const void *src, SceSize size){
+	asm volatile (
+		".fpu neon\n"
+		"1:\n"
+		"pld [%1, #0x100]\n"
+		"vld1.8 {d0-d3}, [%1]!\n"
+		"vld1.8 {d4-d7}, [%1]!\n"
+		"subs %2, %2, #0x40\n"
+		"vst1.8 {d0-d3}, [%0]!\n"
+		"vst1.8 {d4-d7}, [%0]!\n"
+		"bne 1b\n"
+		: "+r"(dst), "+r"(src), "+r"(size)
+		:
+		: "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7", "cc", "memory"
+	);
+}
+
+#else
+
+/*
+ * Portable kernels for the host build.
+ */
+void vmassCopyKernelAligned(void *dst, const void *src, SceSize size){
+
+	dst = __builtin_assume_aligned(dst, VMASS_COPY_KERNEL_ALIGN);
+	src = __builtin_assume_aligned(src, VMASS_COPY_KERNEL_ALIGN);
+
+	do {
+		__builtin_prefetch(src + 0x100);
+
+		memcpy(dst, src, VMASS_COPY_KERNEL_BLOCK);
+
+		dst  += VMASS_COPY_KERNEL_BLOCK;
+		src  += VMASS_COPY_KERNEL_BLOCK;
+		size -= VMASS_COPY_KERNEL_BLOCK;
+	} while(size != 0);
+}
+
+void vmassCopyKernelUnaligned(void *dst, const void *src, SceSize size){
+	do {
+		__builtin_prefetch(src + 0x100);
+
+		memcpy(dst, src, VMASS_COPY_KERNEL_BLOCK);
+
+		dst  += VMASS_COPY_KERNEL_BLOCK;
+		src  += VMASS_COPY_KERNEL_BLOCK;
+		size -= VMASS_COPY_KERNEL_BLOCK;
+	} while(size != 0);
+}
+
+#endif
+
+void vmassCopyCpu(void *dst, const void *src, SceSize size){
+
+	SceSize body = size & ~(VMASS_COPY_KERNEL_BLOCK - 1);
+
+	if(body != 0){
+		if(((((uintptr_t)dst) | ((uintptr_t)src)) & (VMASS_COPY_KERNEL_ALIGN - 1)) == 0){
+			vmassCopyKernelAligned(dst, src, body);
+			__atomic_add_fetch(&vmass_copy_stat.aligned_count, 1, __ATOMIC_RELAXED);
+		}else{
+			vmassCopyKernelUnaligned(dst, src, body);
+			__atomic_add_fetch(&vmass_copy_stat.unaligned_count, 1, __ATOMIC_RELAXED);
+		}
+	}
+
+	if(body != size)
+		memcpy(dst + body, src + body, size - body);
+}
+
+int vmassCopy(void *dst, const void *src, SceSize size){
+
+	SceSize head, body;
+
+	if(g_dmac_copy_min == VMASS_DMAC_COPY_OFF || size < g_dmac_copy_min
+		|| ((((uintptr_t)dst) ^ ((uintptr_t)src)) & (VMASS_DMAC_ALIGN - 1)) != 0){
+
+		vmassCopyCpu(dst, src, size);
+
+		__atomic_add_fetch(&vmass_copy_stat.cpu_count, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&vmass_copy_stat.cpu_bytes, size, __ATOMIC_RELAXED);
+
+		return VMASS_COPY_CPU;
+	}
+
+	head = (VMASS_DMAC_ALIGN - ((uintptr_t)dst & (VMASS_DMAC_ALIGN - 1))) & (VMASS_DMAC_ALIGN - 1);
+	body = (size - head) & ~(VMASS_DMAC_ALIGN - 1);
+
+	if(head != 0)
+		vmassCopyCpu(dst, src, head);
+
+	ksceDmacMemcpy(dst + head, src + head, body);
+
+	if((head + body) != size)
+		vmassCopyCpu(dst + head + body, src + head + body, size - (head + body));
+
+	__atomic_add_fetch(&vmass_copy_stat.dmac_count, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&vmass_copy_stat.dmac_bytes, body, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&vmass_copy_stat.cpu_bytes, size - body, __ATOMIC_RELAXED);
+
+	return VMASS_COPY_DMAC;
+}
+
+int vmassSetDmacCopyThreshold(SceSize size){
+
+	if(size != VMASS_DMAC_COPY_OFF && size < VMASS_DMAC_ALIGN)
+		return -1;
+
+	g_dmac_copy_min = size;
+
+	return 0;
+}
+
+int vmassGetCopyStat(VmassCopyStat *stat){
+
+	if(stat == NULL)
+		return -1;
+
+	stat->cpu_count  = __atomic_load_n(&vmass_copy_stat.cpu_count, __ATOMIC_RELAXED);
+	stat->cpu_bytes  = __atomic_load_n(&vmass_copy_stat.cpu_bytes, __ATOMIC_RELAXED);
+	stat->dmac_count = __atomic_load_n(&vmass_copy_stat.dmac_count, __ATOMIC_RELAXED);
+	stat->dmac_bytes = __atomic_load_n(&vmass_copy_stat.dmac_bytes, __ATOMIC_RELAXED);
+
+	stat->aligned_count   = __atomic_load_n(&vmass_copy_stat.aligned_count, __ATOMIC_RELAXED);
+	stat->unaligned_count = __atomic_load_n(&vmass_copy_stat.unaligned_count, __ATOMIC_RELAXED);
+
+	return 0;
+}
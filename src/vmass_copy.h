@@ -0,0 +1,45 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Copy Header
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VMASS_COPY_H_
+#define _VMASS_COPY_H_
+
+#include <psp2kern/types.h>
+
+#define VMASS_COPY_CPU  (0)
+#define VMASS_COPY_DMAC (1)
+
+/*
+ * CPU copy kernels move VMASS_COPY_KERNEL_BLOCK bytes per iteration.
+ * The aligned kernel needs dst and src aligned to VMASS_COPY_KERNEL_ALIGN.
+ */
+#define VMASS_COPY_KERNEL_BLOCK (0x40)
+#define VMASS_COPY_KERNEL_ALIGN (0x10)
+
+void vmassCopyKernelAligned(void *dst, const void *src, SceSize size);
+void vmassCopyKernelUnaligned(void *dst, const void *src, SceSize size);
+
+/*
+ * Pick a kernel by alignment for the block multiple and memcpy the rest.
+ */
+void vmassCopyCpu(void *dst, const void *src, SceSize size);
+
+/*
+ * Copy one sector payload between a request buffer and a storage page.
+ * Returns the VMASS_COPY_* backend that moved the bulk of the data.
+ */
+int vmassCopy(void *dst, const void *src, SceSize size);
+
+#endif	/* _VMASS_COPY_H_ */
@@ -0,0 +1,1251 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Storage Image
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/threadmgr.h>
+#include <psp2kern/kernel/sysmem.h>
+#include <psp2kern/kernel/sysclib.h>
+#include <psp2kern/io/fcntl.h>
+#include <psp2kern/io/stat.h>
+#include "vmass.h"
+#include "vmass_page.h"
+#include "vmass_tier.h"
+#include "vmass_image.h"
+#include "vmass_lz.h"
+#include "vmass_io.h"
+#include "vmass_internal.h"
+
+/*
+ * Every write marks the granules it touched in the dirty bitmap. Once the storage matches an image file,
+ * vmassCreateImage only rewrites the dirty granules of that file in place, or nothing if none are dirty.
+ */
+#define VMASS_DIRTY_SHIFT_DEF (7) // 64KiB
+
+/*
+ * Image paths in priority order, see vmassImageSetPath.
+ */
+char vmass_image_path[VMASS_IMAGE_PATH_MAX][VMASS_IMAGE_PATH_LEN] = {
+	"sd0:vmass.img",
+	"ux0:data/vmass.img"
+};
+SceSize vmass_image_path_num = 2;
+
+/*
+ * Storage is copied out and scanned for zero extent units one window at a time, so no run is larger than a block.
+ */
+#define VMASS_IMAGE_SCAN_SIZE (VMASS_IMAGE_BLOCK_SIZE)
+
+/*
+ * The save buffer holds the window, a cold page, the LZ output block and the LZ work area.
+ */
+#define VMASS_IMAGE_SAVE_SCRATCH (VMASS_IMAGE_SCAN_SIZE)
+#define VMASS_IMAGE_SAVE_BLOCK   (VMASS_IMAGE_SAVE_SCRATCH + VMASS_THIN_CHUNK_SIZE)
+#define VMASS_IMAGE_SAVE_WORK    (VMASS_IMAGE_SAVE_BLOCK + sizeof(VmassImageBlock) + VMASS_IMAGE_BLOCK_SIZE)
+#define VMASS_IMAGE_SAVE_SIZE    ((VMASS_IMAGE_SAVE_WORK + VMASS_LZ_WORK_SIZE + 0xFFF) & ~0xFFF)
+
+/*
+ * The image is loaded in granules of VMASS_IMAGE_SCAN_SIZE. The load buffer holds one and the file data of an LZ block.
+ */
+#define VMASS_LOAD_SHIFT (7)
+
+#define VMASS_IMAGE_LOAD_SIZE ((VMASS_IMAGE_SCAN_SIZE + sizeof(VmassImageBlock) + VMASS_IMAGE_BLOCK_SIZE + 0xFFF) & ~0xFFF)
+
+#define VMASS_LOAD_THREAD_PRIORITY (0xA0)
+
+SceUInt32 *vmass_dirty_map;
+SceSize vmass_dirty_num;
+int vmass_dirty_shift = VMASS_DIRTY_SHIFT_DEF;
+
+/*
+ * A save takes the dirty map of the snapshot it writes into vmass_save_map. save_mtx serialises saves.
+ */
+SceUInt32 *vmass_save_map;
+SceKernelLwMutexWork save_mtx;
+
+/*
+ * Index of the image path the storage was last loaded from or saved to, < 0 if the storage does not match any image.
+ */
+int vmass_image_synced = -1;
+
+int vmass_image_format = VMASS_IMAGE_SPARSE;
+
+/*
+ * Layout of the synced image. The extent table of a sparse image is kept to patch it in place.
+ */
+int vmass_image_sparse;
+SceUInt32 vmass_image_flags;
+SceOff vmass_image_file_size;
+SceOff vmass_image_data_end; // end of the extent data
+VmassImageExtent *vmass_image_extent;
+SceSize vmass_image_extent_num, vmass_image_extent_max;
+
+/*
+ * While vmass_image_loading is set, the granules without their bit in vmass_load_map are still in the image file.
+ */
+int vmass_load_mode = VMASS_LOAD_SYNC;
+int vmass_image_loading;
+SceKernelLwMutexWork load_mtx;
+SceUID load_fd = -1, load_memid = -1, load_thid = -1;
+void *load_buffer;
+SceInt64 load_time_s;
+
+/*
+ * The granules loaded in order read through load_stream, faults read the file directly.
+ */
+VmassIoStream load_stream;
+int load_stream_open;
+SceUInt32 *vmass_load_map;
+SceSize vmass_load_num, vmass_load_done;
+
+static int vmassDirtyTest(SceSize idx){
+	return (__atomic_load_n(&vmass_dirty_map[idx >> 5], __ATOMIC_RELAXED) & (1 << (idx & 0x1F))) != 0;
+}
+
+static void vmassDirtySet(SceSize idx){
+	__atomic_or_fetch(&vmass_dirty_map[idx >> 5], 1 << (idx & 0x1F), __ATOMIC_RELAXED);
+}
+
+static int vmassSaveTest(SceSize idx){
+	return (vmass_save_map[idx >> 5] & (1 << (idx & 0x1F))) != 0;
+}
+
+void vmassImageMarkDirty(SceSize sector_pos, SceSize sector_num){
+
+	SceSize idx, last;
+
+	last = (sector_pos + sector_num - 1) >> vmass_dirty_shift;
+
+	for(idx=(sector_pos >> vmass_dirty_shift);idx<=last;idx++){
+		if(vmassDirtyTest(idx) == 0)
+			vmassDirtySet(idx);
+	}
+}
+
+static SceSize vmassDirtyCount(void){
+
+	SceSize i, count = 0;
+
+	for(i=0;i<((vmass_dirty_num + 0x1F) >> 5);i++)
+		count += __builtin_popcount(__atomic_load_n(&vmass_dirty_map[i], __ATOMIC_RELAXED));
+
+	return count;
+}
+
+int vmassGetDirtySize(SceSize *dirty_size){
+
+	if(dirty_size == NULL)
+		return -1;
+
+	*dirty_size = (vmassDirtyCount() << vmass_dirty_shift) << 9;
+
+	return 0;
+}
+
+static SceUInt32 *vmassDirtyAlloc(SceSize dirty_num){
+
+	SceUInt32 *map;
+
+	map = ksceKernelAllocHeapMemory(VMASS_KERNEL_HEAP, ((dirty_num + 0x1F) >> 5) * sizeof(SceUInt32));
+	if(map != NULL)
+		memset(map, 0, ((dirty_num + 0x1F) >> 5) * sizeof(SceUInt32));
+
+	return map;
+}
+
+/*
+ * sector_num must be a power of two. If anything is dirty, the whole storage is dirty at the new granularity.
+ */
+int vmassSetDirtyGranularity(SceSize sector_num){
+
+	int shift, dirty;
+	SceSize dirty_num, i;
+	SceUInt32 *map, *save_map;
+
+	if(sector_num == 0 || (sector_num & (sector_num - 1)) != 0)
+		return -1;
+
+	shift     = __builtin_ctz(sector_num);
+	dirty_num = ((vmassPageGetTotalSize() >> 9) + sector_num - 1) >> shift;
+
+	map      = vmassDirtyAlloc(dirty_num);
+	save_map = vmassDirtyAlloc(dirty_num);
+	if(map == NULL || save_map == NULL){
+		if(map != NULL)
+			ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, map);
+
+		if(save_map != NULL)
+			ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, save_map);
+
+		return -1;
+	}
+
+	ksceKernelLockFastMutex(&save_mtx);
+	vmassQueueBlock();
+
+	dirty = (vmassDirtyCount() != 0);
+
+	ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, vmass_dirty_map);
+	ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, vmass_save_map);
+	vmass_dirty_map   = map;
+	vmass_save_map    = save_map;
+	vmass_dirty_num   = dirty_num;
+	vmass_dirty_shift = shift;
+
+	for(i=0;dirty != 0 && i<dirty_num;i++)
+		vmassDirtySet(i);
+
+	vmassQueueUnblock();
+	ksceKernelUnlockFastMutex(&save_mtx);
+
+	return 0;
+}
+
+/*
+ * Clear the dirty map, or mark every granule dirty.
+ */
+static void vmassDirtyReset(int dirty){
+
+	SceSize i;
+
+	memset(vmass_dirty_map, 0, ((vmass_dirty_num + 0x1F) >> 5) * sizeof(SceUInt32));
+
+	for(i=0;dirty != 0 && i<vmass_dirty_num;i++)
+		vmassDirtySet(i);
+}
+
+static int vmassImageExtentReserve(SceSize extent_num){
+
+	SceSize extent_max;
+	VmassImageExtent *extent;
+
+	if(extent_num <= vmass_image_extent_max)
+		return 0;
+
+	extent_max = (vmass_image_extent_max != 0) ? vmass_image_extent_max : 0x40;
+	while(extent_max < extent_num)
+		extent_max <<= 1;
+
+	extent = ksceKernelAllocHeapMemory(VMASS_KERNEL_HEAP, extent_max * sizeof(VmassImageExtent));
+	if(extent == NULL)
+		return -1;
+
+	if(vmass_image_extent != NULL){
+		memcpy(extent, vmass_image_extent, vmass_image_extent_num * sizeof(VmassImageExtent));
+		ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, vmass_image_extent);
+	}
+
+	vmass_image_extent     = extent;
+	vmass_image_extent_max = extent_max;
+
+	return 0;
+}
+
+/*
+ * Append an extent, merging it into the last one when both the sectors and the data are contiguous.
+ * The extents of an LZ image are never merged, each is one block.
+ */
+static int vmassImageExtentAdd(SceSize sector_pos, SceSize sector_num, SceOff file_offset, SceUInt32 flags){
+
+	VmassImageExtent *extent;
+
+	if(vmass_image_extent_num != 0 && (flags & VMASS_IMAGE_FLAG_LZ) == 0){
+		extent = &vmass_image_extent[vmass_image_extent_num - 1];
+
+		if((extent->sector_pos + extent->sector_num) == sector_pos && (extent->file_offset + ((SceOff)extent->sector_num << 9)) == file_offset){
+			extent->sector_num += sector_num;
+			return 0;
+		}
+	}
+
+	if(vmassImageExtentReserve(vmass_image_extent_num + 1) < 0)
+		return -1;
+
+	extent = &vmass_image_extent[vmass_image_extent_num++];
+	extent->sector_pos  = sector_pos;
+	extent->sector_num  = sector_num;
+	extent->file_offset = file_offset;
+
+	return 0;
+}
+
+/*
+ * Index of the first extent that ends after sector_pos, vmass_image_extent_num if none.
+ */
+static SceSize vmassImageExtentFind(SceSize sector_pos){
+
+	SceSize lo = 0, hi = vmass_image_extent_num, mid;
+
+	while(lo < hi){
+		mid = lo + ((hi - lo) >> 1);
+
+		if((vmass_image_extent[mid].sector_pos + vmass_image_extent[mid].sector_num) <= sector_pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Copy storage bytes [off, off + size) to dst without backing or warming any page. Cold pages are decompressed
+ * to scratch, which holds a whole page. The caller holds the range lock.
+ */
+int vmassImageCopyOut(SceSize off, void *dst, SceSize size, void *scratch){
+
+	int page_idx;
+	SceSize page_off, work_size;
+	VmassPageInfo *page;
+
+	page_idx = vmassPageLookup(off);
+	if(page_idx < 0)
+		return -1;
+
+	page_off = off - vmass_page_list[page_idx].offset;
+
+	while(size != 0 && page_idx < vmass_page_num){
+		page = &vmass_page_list[page_idx];
+
+		work_size = page->size - page_off;
+		if(work_size > size)
+			work_size = size;
+
+		if(page->base != NULL){
+			memcpy(dst, page->base + page_off, work_size);
+		}else if(page->comp != NULL){
+			vmassTierRead(page, scratch);
+			memcpy(dst, scratch + page_off, work_size);
+		}else{
+			memset(dst, 0, work_size);
+		}
+
+		dst     += work_size;
+		size    -= work_size;
+		page_off = 0;
+		page_idx++;
+	}
+
+	return (size == 0) ? 0 : -1;
+}
+
+/*
+ * Update sectors [sector_pos, sector_pos + sector_num) of the synced image in place. A sparse image can only take
+ * non-zero data inside its extents, anything else returns < 0 and needs a full save.
+ */
+static int vmassImagePatch(SceUID fd, SceSize sector_pos, const void *data, SceSize sector_num){
+
+	int res;
+	SceSize idx, end = sector_pos + sector_num, work_end;
+	const VmassImageExtent *extent;
+
+	if(vmass_image_flags != 0)
+		return -1;
+
+	if(vmass_image_sparse == 0)
+		return vmassIoPwrite(fd, data, sector_num << 9, (SceOff)sector_pos << 9);
+
+	idx = vmassImageExtentFind(sector_pos);
+
+	while(sector_pos < end){
+		extent = (idx < vmass_image_extent_num) ? &vmass_image_extent[idx] : NULL;
+
+		if(extent != NULL && extent->sector_pos <= sector_pos){
+			work_end = extent->sector_pos + extent->sector_num;
+			if(work_end > end)
+				work_end = end;
+
+			res = vmassIoPwrite(fd, data, (work_end - sector_pos) << 9, extent->file_offset + ((SceOff)(sector_pos - extent->sector_pos) << 9));
+			if(res < 0)
+				return res;
+
+			idx++;
+		}else{
+			work_end = (extent != NULL && extent->sector_pos < end) ? extent->sector_pos : end;
+
+			if(vmassPageIsZero(data, (work_end - sector_pos) << 9) == 0)
+				return -1;
+		}
+
+		data      += (work_end - sector_pos) << 9;
+		sector_pos = work_end;
+	}
+
+	return 0;
+}
+
+/*
+ * Rewrite every granule of the synced image that was dirty when the snapshot was taken.
+ */
+static int vmassImageWriteDirty(SceUID fd, void *buffer){
+
+	int res = 0;
+	SceSize idx, sector_pos, sector_num, work_pos, work_num, all_sector = g_vmass_size >> 9;
+
+	for(idx=0;idx<vmass_dirty_num;idx++){
+		if(vmassSaveTest(idx) == 0)
+			continue;
+
+		sector_pos = idx << vmass_dirty_shift;
+		if(sector_pos >= all_sector)
+			break;
+
+		sector_num = 1 << vmass_dirty_shift;
+		if(sector_num > (all_sector - sector_pos))
+			sector_num = all_sector - sector_pos;
+
+		for(work_pos=sector_pos;work_pos<(sector_pos + sector_num);work_pos+=work_num){
+			work_num = sector_pos + sector_num - work_pos;
+			if(work_num > (VMASS_IMAGE_SCAN_SIZE >> 9))
+				work_num = VMASS_IMAGE_SCAN_SIZE >> 9;
+
+			// the full save this falls back to reads the snapshot again
+			res = vmassSnapshotCopyOut(work_pos, buffer, work_num, buffer + VMASS_IMAGE_SAVE_SCRATCH, 0);
+			if(res >= 0)
+				res = vmassImagePatch(fd, work_pos, buffer, work_num);
+
+			if(res < 0)
+				return res;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Append one run of extent data to the stream, as an LZ block if flags asks for it. Returns the bytes written.
+ * The run is compressed while the I/O thread writes the previous chunk.
+ */
+static int vmassImageWriteRun(VmassIoStream *stream, const void *data, SceSize size, SceUInt32 flags, void *buffer){
+
+	int res, comp_size;
+	VmassImageBlock *block = buffer + VMASS_IMAGE_SAVE_BLOCK;
+
+	if((flags & VMASS_IMAGE_FLAG_LZ) == 0){
+		res = vmassIoWrite(stream, data, size);
+		return (res < 0) ? res : (int)size;
+	}
+
+	comp_size = vmassLzCompress(&block[1], size - 1, data, size, buffer + VMASS_IMAGE_SAVE_WORK);
+	if(comp_size < 0){
+		memcpy(&block[1], data, size);
+		comp_size = size;
+	}
+
+	block->comp_size = comp_size;
+
+	res = vmassIoWrite(stream, block, sizeof(*block) + comp_size);
+
+	return (res < 0) ? res : (int)(sizeof(*block) + comp_size);
+}
+
+/*
+ * Write the storage as a sparse image, one VMASS_IMAGE_SCAN_SIZE window at a time. Runs of non-zero extent units
+ * are written back to back and become the extent table.
+ */
+static int vmassImageWriteSparse(SceUID fd, SceUInt32 flags, void *buffer){
+
+	int res = 0;
+	SceSize sector_pos, sector_num, unit_pos, unit_num, run_end, size, all_sector = g_vmass_size >> 9;
+	SceOff file_offset = VMASS_IMAGE_DATA_OFFSET;
+	VmassImageHeader header;
+	VmassIoStream stream;
+
+	res = vmassIoOpen(&stream, fd, VMASS_IO_WRITE, VMASS_IMAGE_DATA_OFFSET, 0);
+	if(res < 0)
+		return res;
+
+	vmass_image_extent_num = 0;
+
+	for(sector_pos=0;sector_pos<all_sector;sector_pos+=sector_num){
+		sector_num = all_sector - sector_pos;
+		if(sector_num > (VMASS_IMAGE_SCAN_SIZE >> 9))
+			sector_num = VMASS_IMAGE_SCAN_SIZE >> 9;
+
+		res = vmassSnapshotCopyOut(sector_pos, buffer, sector_num, buffer + VMASS_IMAGE_SAVE_SCRATCH, 1);
+		if(res < 0)
+			goto close;
+
+		for(unit_pos=0;unit_pos<sector_num;unit_pos=run_end){
+			run_end  = unit_pos;
+			unit_num = 0;
+
+			while(run_end < sector_num){
+				unit_num = sector_num - run_end;
+				if(unit_num > (VMASS_IMAGE_EXTENT_UNIT >> 9))
+					unit_num = VMASS_IMAGE_EXTENT_UNIT >> 9;
+
+				if(vmassPageIsZero(buffer + (run_end << 9), unit_num << 9))
+					break;
+
+				run_end += unit_num;
+			}
+
+			if(run_end == unit_pos){
+				run_end += unit_num;
+				continue;
+			}
+
+			res = vmassImageWriteRun(&stream, buffer + (unit_pos << 9), (run_end - unit_pos) << 9, flags, buffer);
+			if(res < 0)
+				goto close;
+
+			size = res;
+
+			res = vmassImageExtentAdd(sector_pos + unit_pos, run_end - unit_pos, file_offset, flags);
+			if(res < 0)
+				goto close;
+
+			file_offset += size;
+		}
+	}
+
+	res = vmassIoWrite(&stream, vmass_image_extent, vmass_image_extent_num * sizeof(VmassImageExtent));
+
+close:
+	if(res < 0)
+		vmassIoClose(&stream);
+	else
+		res = vmassIoClose(&stream);
+
+	if(res < 0)
+		goto end;
+
+	memset(&header, 0, sizeof(header));
+	header.magic         = VMASS_IMAGE_MAGIC;
+	header.version       = VMASS_IMAGE_VERSION;
+	header.header_size   = sizeof(header);
+	header.flags         = flags;
+	header.extent_num    = vmass_image_extent_num;
+	header.storage_size  = g_vmass_size;
+	header.extent_offset = file_offset;
+	header.data_size     = file_offset - VMASS_IMAGE_DATA_OFFSET;
+
+	res = vmassIoPwrite(fd, &header, sizeof(header), 0);
+	if(res < 0)
+		goto end;
+
+	vmass_image_sparse    = 1;
+	vmass_image_flags     = flags;
+	vmass_image_file_size = file_offset + vmass_image_extent_num * sizeof(VmassImageExtent);
+
+end:
+	if(res < 0)
+		vmassDirtyReset(1);
+
+	return res;
+}
+
+/*
+ * Flags of the image a full save writes.
+ */
+static SceUInt32 vmassImageGetFlags(void){
+	return (vmass_image_format == VMASS_IMAGE_LZ) ? VMASS_IMAGE_FLAG_LZ : 0;
+}
+
+int vmassSetImageFormat(int format){
+
+	if(format != VMASS_IMAGE_SPARSE && format != VMASS_IMAGE_LZ)
+		return -1;
+
+	vmass_image_format = format;
+
+	return 0;
+}
+
+/*
+ * Rewrite the dirty granules of the image the storage matches. Returns < 0 if that image can not be updated in place,
+ * which an LZ image never can. Neither can a sparse one once a granule holds non-zero data outside its extents:
+ * the extents are laid out in storage order for the streamed load, so new ones are not appended.
+ */
+static int vmassImageSaveIncremental(void *buffer){
+
+	int res;
+	SceIoStat stat;
+	SceUID fd;
+
+	if(vmass_image_flags != 0 || vmassImageGetFlags() != 0)
+		return -1;
+
+	fd = ksceIoOpen(vmass_image_path[vmass_image_synced], SCE_O_WRONLY, 0);
+	if(fd < 0)
+		return fd;
+
+	res = ksceIoGetstatByFd(fd, &stat);
+	if(res >= 0 && stat.st_size != vmass_image_file_size)
+		res = -1;
+
+	if(res >= 0)
+		res = vmassImageWriteDirty(fd, buffer);
+
+	ksceIoClose(fd);
+
+	return res;
+}
+
+/*
+ * The temporary file of a full save is the image path with .tmp appended.
+ */
+static void vmassImageTempPath(char *tmp_path, const char *path){
+
+	SceSize len;
+
+	len = strnlen(path, VMASS_IMAGE_PATH_LEN);
+
+	memcpy(tmp_path, path, len);
+	memcpy(&tmp_path[len], ".tmp", 5);
+}
+
+static int vmassImageSaveFull(void *buffer){
+
+	int res, i;
+	char tmp_path[VMASS_IMAGE_PATH_LEN + 4];
+	SceUID fd = -1;
+	VmassImageHeader header;
+
+	vmass_image_synced = -1;
+
+	for(i=0;i<vmass_image_path_num;i++){
+		vmassImageTempPath(tmp_path, vmass_image_path[i]);
+
+		fd = ksceIoOpen(tmp_path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0666);
+		if(fd >= 0)
+			break;
+	}
+
+	if(fd < 0)
+		return fd;
+
+	memset(&header, 0, sizeof(header));
+	header.magic       = VMASS_IMAGE_MAGIC_PARTIAL;
+	header.version     = VMASS_IMAGE_VERSION;
+	header.header_size = sizeof(header);
+
+	res = vmassIoPwrite(fd, &header, sizeof(header), 0);
+	if(res >= 0)
+		res = vmassImageWriteSparse(fd, vmassImageGetFlags(), buffer);
+
+	if(res >= 0)
+		res = ksceIoSyncByFd(fd);
+
+	ksceIoClose(fd);
+
+	if(res < 0){
+		ksceIoRemove(tmp_path);
+		return res;
+	}
+
+	// FAT does not rename over an existing file. Once the image is removed the load falls back to the temporary file.
+	res = ksceIoRename(tmp_path, vmass_image_path[i]);
+	if(res < 0){
+		ksceIoRemove(vmass_image_path[i]);
+		res = ksceIoRename(tmp_path, vmass_image_path[i]);
+	}
+
+	if(res >= 0)
+		vmass_image_synced = i;
+
+	return res;
+}
+
+static void vmassImageLoadWait(void);
+
+/*
+ * Save the storage as it was when the snapshot was taken, requests go on meanwhile.
+ */
+int vmassCreateImage(void){
+
+	int res;
+	void *buffer;
+	SceUID memid;
+	SceInt64 time_s;
+	SceUInt64 seq;
+	SceSize i;
+
+	ksceKernelLockFastMutex(&save_mtx);
+
+	vmassImageLoadWait();
+
+	time_s = ksceKernelGetSystemTimeWide();
+
+	memid = ksceKernelAllocMemBlock("VmassSaveBuffer", 0x1020D006, VMASS_IMAGE_SAVE_SIZE, NULL);
+	if(memid < 0){
+		res = memid;
+		goto unlock;
+	}
+
+	ksceKernelGetMemBlockBase(memid, &buffer);
+
+	vmassQueueBlock();
+
+	seq = vmassJournalMark();
+
+	if(vmass_image_synced >= 0 && vmassDirtyCount() == 0 && vmass_image_flags == vmassImageGetFlags()){
+		vmassQueueUnblock();
+		res = vmassJournalCompact(seq);
+		goto free_buffer;
+	}
+
+	memcpy(vmass_save_map, vmass_dirty_map, ((vmass_dirty_num + 0x1F) >> 5) * sizeof(SceUInt32));
+	vmassDirtyReset(0);
+
+	vmassSnapshotTake();
+
+	vmassQueueUnblock();
+
+	res = -1;
+	if(vmass_image_synced >= 0)
+		res = vmassImageSaveIncremental(buffer);
+
+	if(res < 0)
+		res = vmassImageSaveFull(buffer);
+
+	vmassSnapshotRelease();
+
+	__atomic_store_n(&vmass_io_stat.last_save_time, ksceKernelGetSystemTimeWide() - time_s, __ATOMIC_RELAXED);
+
+	if(res >= 0){
+		vmassJournalCompact(seq);
+	}else{
+		for(i=0;i<((vmass_dirty_num + 0x1F) >> 5);i++)
+			__atomic_or_fetch(&vmass_dirty_map[i], vmass_save_map[i], __ATOMIC_RELAXED);
+	}
+
+free_buffer:
+	ksceKernelFreeMemBlock(memid);
+
+unlock:
+	ksceKernelUnlockFastMutex(&save_mtx);
+
+	return res;
+}
+
+/*
+ * Minimum file bytes behind an extent. The size of an LZ block is only known once its header is read.
+ */
+static SceOff vmassImageExtentDataSize(const VmassImageHeader *header, const VmassImageExtent *extent){
+
+	if((header->flags & VMASS_IMAGE_FLAG_LZ) != 0)
+		return sizeof(VmassImageBlock);
+
+	return (SceOff)extent->sector_num << 9;
+}
+
+/*
+ * Read image data for a load, through load_stream if seq is set.
+ */
+static int vmassImageLoadRead(void *data, SceSize size, SceOff offset, int seq){
+
+	if(seq != 0 && load_stream_open != 0)
+		return vmassIoRead(&load_stream, data, size, offset);
+
+	return vmassIoPread(load_fd, data, size, offset);
+}
+
+/*
+ * Read the LZ block of an extent to dst. Its file data ends at data_end, where the next one starts, and is read to block.
+ */
+static int vmassImageReadBlock(const VmassImageExtent *extent, SceOff data_end, void *dst, VmassImageBlock *block, int seq){
+
+	int res;
+	SceSize size = extent->sector_num << 9, file_size;
+
+	if((data_end - extent->file_offset) > (sizeof(*block) + size))
+		return -1;
+
+	file_size = data_end - extent->file_offset;
+
+	res = vmassImageLoadRead(block, file_size, extent->file_offset, seq);
+	if(res < 0)
+		return res;
+
+	if(block->comp_size != (file_size - sizeof(*block)))
+		return -1;
+
+	if(block->comp_size == size){
+		memcpy(dst, &block[1], size);
+		return 0;
+	}
+
+	if(vmassLzDecompress(dst, size, &block[1], block->comp_size) != size)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Check the header and read the extent table of a sparse image.
+ */
+static int vmassImageOpenSparse(SceUID fd, const VmassImageHeader *header, SceOff file_size){
+
+	int res;
+	SceSize i, all_sector, prev_end = 0;
+	SceOff prev_offset = VMASS_IMAGE_DATA_OFFSET;
+	const VmassImageExtent *extent;
+
+	if(header->version > VMASS_IMAGE_VERSION || header->header_size < sizeof(VmassImageHeader) || (header->flags & ~VMASS_IMAGE_FLAG_LZ) != 0)
+		return -1;
+
+	if(header->storage_size == 0 || (header->storage_size & 0x1FF) != 0 || header->storage_size > vmassPageGetTotalSize())
+		return -1;
+
+	if(header->extent_offset > file_size || header->extent_num > ((file_size - header->extent_offset) / sizeof(VmassImageExtent)))
+		return -1;
+
+	all_sector = header->storage_size >> 9;
+
+	vmass_image_extent_num = 0;
+
+	res = vmassImageExtentReserve(header->extent_num);
+	if(res < 0)
+		return res;
+
+	if(header->extent_num != 0){
+		res = vmassIoPread(fd, vmass_image_extent, header->extent_num * sizeof(VmassImageExtent), header->extent_offset);
+		if(res < 0)
+			return res;
+	}
+
+	for(i=0;i<header->extent_num;i++){
+		extent = &vmass_image_extent[i];
+
+		if(extent->sector_num == 0 || extent->sector_pos < prev_end || extent->sector_pos >= all_sector
+			|| extent->sector_num > (all_sector - extent->sector_pos))
+			return -1;
+
+		if(extent->file_offset < prev_offset || (extent->file_offset + vmassImageExtentDataSize(header, extent)) > header->extent_offset)
+			return -1;
+
+		// an LZ block is loaded with its granule
+		if((header->flags & VMASS_IMAGE_FLAG_LZ) != 0
+			&& (extent->sector_pos >> VMASS_LOAD_SHIFT) != ((extent->sector_pos + extent->sector_num - 1) >> VMASS_LOAD_SHIFT))
+			return -1;
+
+		prev_end    = extent->sector_pos + extent->sector_num;
+		prev_offset = extent->file_offset + vmassImageExtentDataSize(header, extent);
+	}
+
+	g_vmass_size = (SceSize)header->storage_size;
+
+	vmass_image_extent_num = header->extent_num;
+	vmass_image_sparse     = 1;
+	vmass_image_flags      = header->flags;
+	vmass_image_file_size  = file_size;
+	vmass_image_data_end   = header->extent_offset;
+
+	return 0;
+}
+
+static int vmassImageOpenRaw(SceOff file_size){
+
+	if(file_size == 0 || file_size > (SceOff)(g_vmass_size))
+		return -1;
+
+	g_vmass_size = (SceSize)file_size;
+
+	vmass_image_extent_num = 0;
+	vmass_image_sparse     = 0;
+	vmass_image_flags      = 0;
+	vmass_image_file_size  = file_size;
+	vmass_image_data_end   = file_size;
+
+	return 0;
+}
+
+static int vmassLoadTest(SceSize idx){
+	return (__atomic_load_n(&vmass_load_map[idx >> 5], __ATOMIC_ACQUIRE) & (1 << (idx & 0x1F))) != 0;
+}
+
+static void vmassLoadSet(SceSize idx){
+	__atomic_or_fetch(&vmass_load_map[idx >> 5], 1 << (idx & 0x1F), __ATOMIC_RELEASE);
+}
+
+/*
+ * Read load granule idx of the image to buffer, with zeros where the image has no data.
+ */
+static int vmassImageReadGranule(SceSize idx, void *buffer, int seq){
+
+	int res;
+	SceSize sector_pos, sector_num, i, work_pos, work_end;
+	const VmassImageExtent *extent;
+
+	sector_pos = idx << VMASS_LOAD_SHIFT;
+	sector_num = (g_vmass_size >> 9) - sector_pos;
+	if(sector_num > (1 << VMASS_LOAD_SHIFT))
+		sector_num = 1 << VMASS_LOAD_SHIFT;
+
+	if(vmass_image_sparse == 0)
+		return vmassImageLoadRead(buffer, sector_num << 9, (SceOff)sector_pos << 9, seq);
+
+	memset(buffer, 0, sector_num << 9);
+
+	for(i=vmassImageExtentFind(sector_pos);i<vmass_image_extent_num && vmass_image_extent[i].sector_pos < (sector_pos + sector_num);i++){
+		extent = &vmass_image_extent[i];
+
+		if((vmass_image_flags & VMASS_IMAGE_FLAG_LZ) != 0){
+			res = vmassImageReadBlock(extent, ((i + 1) < vmass_image_extent_num) ? extent[1].file_offset : vmass_image_data_end,
+				buffer + ((extent->sector_pos - sector_pos) << 9), buffer + VMASS_IMAGE_SCAN_SIZE, seq);
+		}else{
+			work_pos = (extent->sector_pos > sector_pos) ? extent->sector_pos : sector_pos;
+			work_end = extent->sector_pos + extent->sector_num;
+			if(work_end > (sector_pos + sector_num))
+				work_end = sector_pos + sector_num;
+
+			res = vmassImageLoadRead(buffer + ((work_pos - sector_pos) << 9), (work_end - work_pos) << 9,
+				extent->file_offset + ((SceOff)(work_pos - extent->sector_pos) << 9), seq);
+		}
+
+		if(res < 0)
+			return res;
+	}
+
+	return 0;
+}
+
+/*
+ * Load granule idx unless it already is. Faulting requests and the load thread serialise on load_mtx.
+ * A granule that can not be read stays zero and the next save is a full one. seq is set by the in-order loaders.
+ */
+static int vmassImageLoadGranule(SceSize idx, int seq){
+
+	int res = 0;
+	SceSize sector_pos, sector_num;
+
+	if(vmassLoadTest(idx) != 0)
+		return 0;
+
+	ksceKernelLockFastMutex(&load_mtx);
+
+	if(vmassLoadTest(idx) == 0){
+		sector_pos = idx << VMASS_LOAD_SHIFT;
+		sector_num = (g_vmass_size >> 9) - sector_pos;
+		if(sector_num > (1 << VMASS_LOAD_SHIFT))
+			sector_num = 1 << VMASS_LOAD_SHIFT;
+
+		res = vmassImageReadGranule(idx, load_buffer, seq);
+		if(res >= 0){
+			vmassRangeLock(-1, VMASS_REQ_WRITE, sector_pos, sector_num);
+			res = _vmassWriteSector(sector_pos, load_buffer, sector_num);
+			vmassRangeUnlock(VMASS_REQ_WRITE, sector_pos, sector_num);
+		}
+
+		if(res < 0){
+			vmass_image_synced = -1;
+			vmassDirtyReset(1);
+		}
+
+		vmassLoadSet(idx);
+		__atomic_add_fetch(&vmass_load_done, 1, __ATOMIC_RELAXED);
+	}
+
+	ksceKernelUnlockFastMutex(&load_mtx);
+
+	return res;
+}
+
+/*
+ * Load the granules a request touches before it takes its range lock.
+ */
+int vmassImageFault(SceSize sector_pos, SceSize sector_num){
+
+	int res;
+	SceSize idx, last;
+
+	if(__atomic_load_n(&vmass_image_loading, __ATOMIC_ACQUIRE) == 0)
+		return 0;
+
+	last = (sector_pos + sector_num - 1) >> VMASS_LOAD_SHIFT;
+
+	for(idx=(sector_pos >> VMASS_LOAD_SHIFT);idx<=last;idx++){
+		res = vmassImageLoadGranule(idx, 0);
+		if(res < 0)
+			return res;
+	}
+
+	return 0;
+}
+
+static void vmassImageLoadEnd(void){
+
+	__atomic_store_n(&vmass_image_loading, 0, __ATOMIC_RELEASE);
+
+	if(load_stream_open != 0){
+		vmassIoClose(&load_stream);
+		load_stream_open = 0;
+	}
+
+	__atomic_store_n(&vmass_io_stat.last_load_time, ksceKernelGetSystemTimeWide() - load_time_s, __ATOMIC_RELAXED);
+
+	ksceKernelFreeMemBlock(load_memid);
+	load_memid  = -1;
+	load_buffer = NULL;
+
+	ksceIoClose(load_fd);
+	load_fd = -1;
+}
+
+/*
+ * Streams the image in from the start of the storage, where the FAT metadata is read first.
+ */
+static int sceVmassLoadThread(SceSize args, void *argp){
+
+	SceSize idx;
+
+	for(idx=0;idx<vmass_load_num;idx++){
+		vmassQueueEnter();
+		vmassImageLoadGranule(idx, 1);
+		vmassQueueLeave();
+	}
+
+	vmassImageLoadEnd();
+
+	return 0;
+}
+
+/*
+ * Finish a lazy load in the calling thread.
+ */
+static void vmassImageLoadWait(void){
+
+	if(load_thid < 0)
+		return;
+
+	vmassImageFault(0, g_vmass_size >> 9);
+
+	ksceKernelWaitThreadEnd(load_thid, NULL, NULL);
+	ksceKernelDeleteThread(load_thid);
+	load_thid = -1;
+}
+
+int vmassSetLoadMode(int mode){
+
+	if(mode != VMASS_LOAD_SYNC && mode != VMASS_LOAD_LAZY)
+		return -1;
+
+	vmass_load_mode = mode;
+
+	return 0;
+}
+
+int vmassGetLoadProgress(SceSize *loaded_size, SceSize *total_size){
+
+	SceSize loaded = g_vmass_size;
+
+	if(__atomic_load_n(&vmass_image_loading, __ATOMIC_ACQUIRE) != 0)
+		loaded = (__atomic_load_n(&vmass_load_done, __ATOMIC_RELAXED) << VMASS_LOAD_SHIFT) << 9;
+
+	if(loaded > g_vmass_size)
+		loaded = g_vmass_size;
+
+	if(loaded_size != NULL)
+		*loaded_size = loaded;
+
+	if(total_size != NULL)
+		*total_size = g_vmass_size;
+
+	return 0;
+}
+
+/*
+ * Load a sparse image, or a raw one if the file does not start with the sparse header. The file of an interrupted
+ * full save is refused.
+ * In VMASS_LOAD_LAZY mode only the header is read here and the load thread streams in the rest.
+ */
+int vmassLoadImage(void){
+
+	int res, i;
+	char tmp_path[VMASS_IMAGE_PATH_LEN + 4];
+	SceIoStat stat;
+	SceSize idx;
+	VmassImageHeader header;
+
+	vmassImageLoadWait();
+
+	load_time_s = ksceKernelGetSystemTimeWide();
+
+	for(i=0;i<vmass_image_path_num;i++){
+		load_fd = ksceIoOpen(vmass_image_path[i], SCE_O_RDONLY, 0);
+		if(load_fd >= 0)
+			break;
+
+		// a full save that stopped between removing the image and renaming its temporary file
+		vmassImageTempPath(tmp_path, vmass_image_path[i]);
+
+		load_fd = ksceIoOpen(tmp_path, SCE_O_RDONLY, 0);
+		if(load_fd >= 0)
+			break;
+	}
+
+	if(load_fd < 0)
+		return load_fd;
+
+	res = ksceIoGetstatByFd(load_fd, &stat);
+	if(res < 0)
+		goto io_close;
+
+	if(stat.st_size < sizeof(header) || vmassIoPread(load_fd, &header, sizeof(header), 0) < 0)
+		header.magic = 0;
+
+	if(header.magic == VMASS_IMAGE_MAGIC)
+		res = vmassImageOpenSparse(load_fd, &header, stat.st_size);
+	else if(header.magic == VMASS_IMAGE_MAGIC_PARTIAL)
+		res = -1;
+	else
+		res = vmassImageOpenRaw(stat.st_size);
+
+	if(res < 0)
+		goto io_close;
+
+	load_memid = ksceKernelAllocMemBlock("VmassLoadBuffer", 0x1020D006, VMASS_IMAGE_LOAD_SIZE, NULL);
+	if(load_memid < 0){
+		res = load_memid;
+		goto io_close;
+	}
+
+	ksceKernelGetMemBlockBase(load_memid, &load_buffer);
+
+	if(vmass_load_map != NULL)
+		ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, vmass_load_map);
+
+	vmass_load_num  = ((g_vmass_size >> 9) + (1 << VMASS_LOAD_SHIFT) - 1) >> VMASS_LOAD_SHIFT;
+	vmass_load_done = 0;
+
+	vmass_load_map = vmassDirtyAlloc(vmass_load_num);
+	if(vmass_load_map == NULL){
+		res = -1;
+		goto free_buffer;
+	}
+
+	vmassDirtyReset(0);
+	vmass_image_synced = i;
+
+	// without the stream the granules are read directly
+	load_stream_open = (vmassIoOpen(&load_stream, load_fd, VMASS_IO_READ, (vmass_image_sparse != 0) ? VMASS_IMAGE_DATA_OFFSET : 0, vmass_image_data_end) >= 0);
+
+	__atomic_store_n(&vmass_image_loading, 1, __ATOMIC_RELEASE);
+
+	if(vmass_load_mode == VMASS_LOAD_LAZY){
+		load_thid = ksceKernelCreateThread("SceVmassLoadThread", sceVmassLoadThread, VMASS_LOAD_THREAD_PRIORITY, 0x1000, 0, 0, NULL);
+		if(load_thid >= 0 && ksceKernelStartThread(load_thid, 0, NULL) >= 0)
+			return 0;
+
+		if(load_thid >= 0)
+			ksceKernelDeleteThread(load_thid);
+
+		load_thid = -1;
+	}
+
+	for(idx=0;idx<vmass_load_num;idx++){
+		res = vmassImageLoadGranule(idx, 1);
+		if(res < 0)
+			break;
+	}
+
+	vmassImageLoadEnd();
+
+	return res;
+
+free_buffer:
+	ksceKernelFreeMemBlock(load_memid);
+	load_memid  = -1;
+	load_buffer = NULL;
+
+io_close:
+	ksceIoClose(load_fd);
+	load_fd = -1;
+
+	return res;
+}
+
+int vmassImageSetPath(const char (*path)[VMASS_IMAGE_PATH_LEN], SceSize num){
+
+	if(num == 0 || num > VMASS_IMAGE_PATH_MAX)
+		return -1;
+
+	memcpy(vmass_image_path, path, sizeof(*path) * num);
+	vmass_image_path_num = num;
+
+	return 0;
+}
+
+int vmassImageInit(SceSize size){
+
+	int res;
+
+	vmass_dirty_num = ((size >> 9) + (1 << vmass_dirty_shift) - 1) >> vmass_dirty_shift;
+
+	vmass_dirty_map = vmassDirtyAlloc(vmass_dirty_num);
+	if(vmass_dirty_map == NULL)
+		return -1;
+
+	vmass_save_map = vmassDirtyAlloc(vmass_dirty_num);
+	if(vmass_save_map == NULL){
+		res = -1;
+		goto free_dirty_map;
+	}
+
+	res = ksceKernelInitializeFastMutex(&load_mtx, "VmassLoadMutex", 0, 0);
+	if(res < 0)
+		goto free_save_map;
+
+	res = ksceKernelInitializeFastMutex(&save_mtx, "VmassSaveMutex", 0, 0);
+	if(res < 0)
+		goto del_load_mtx;
+
+	vmass_image_synced = -1;
+
+	return 0;
+
+del_load_mtx:
+	ksceKernelDeleteFastMutex(&load_mtx);
+
+free_save_map:
+	ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, vmass_save_map);
+	vmass_save_map = NULL;
+
+free_dirty_map:
+	ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, vmass_dirty_map);
+	vmass_dirty_map = NULL;
+
+	return res;
+}
+
+int vmassImageFini(void){
+
+	vmassImageLoadWait();
+
+	ksceKernelDeleteFastMutex(&save_mtx);
+	ksceKernelDeleteFastMutex(&load_mtx);
+
+	ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, vmass_save_map);
+	vmass_save_map = NULL;
+
+	ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, vmass_dirty_map);
+	vmass_dirty_map = NULL;
+	vmass_dirty_num = 0;
+
+	if(vmass_load_map != NULL)
+		ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, vmass_load_map);
+
+	vmass_load_map = NULL;
+	vmass_load_num = 0;
+
+	if(vmass_image_extent != NULL)
+		ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, vmass_image_extent);
+
+	vmass_image_extent     = NULL;
+	vmass_image_extent_num = 0;
+	vmass_image_extent_max = 0;
+
+	return 0;
+}
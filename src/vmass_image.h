@@ -0,0 +1,70 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Storage Image Format
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VMASS_IMAGE_H_
+#define _VMASS_IMAGE_H_
+
+#include <psp2kern/types.h>
+
+/*
+ * A sparse image is a header, the data of every non-zero extent and the extent table, all little endian.
+ * Sectors outside the extents are zero. A file that does not start with the magic is a raw image,
+ * a flat dump of the storage.
+ *
+ * A full save writes a header with VMASS_IMAGE_MAGIC_PARTIAL to a temporary file next to the image first, the real header
+ * last, and then renames the file over the image. An interrupted save leaves the old image, and a partial file is never
+ * loaded, not even as a raw image.
+ */
+#define VMASS_IMAGE_MAGIC         (0x49534D56) // "VMSI"
+#define VMASS_IMAGE_MAGIC_PARTIAL (0x50534D56) // "VMSP"
+#define VMASS_IMAGE_VERSION (1)
+
+/*
+ * Extent data starts here and extents are found in units of VMASS_IMAGE_EXTENT_UNIT.
+ */
+#define VMASS_IMAGE_DATA_OFFSET (0x1000)
+#define VMASS_IMAGE_EXTENT_UNIT (0x1000)
+
+/*
+ * With VMASS_IMAGE_FLAG_LZ no extent crosses a VMASS_IMAGE_BLOCK_SIZE boundary of the storage and its data is
+ * a VmassImageBlock followed by comp_size bytes, LZ compressed (see vmass_lz.h) unless comp_size is the extent size.
+ */
+#define VMASS_IMAGE_FLAG_LZ (1 << 0)
+
+#define VMASS_IMAGE_BLOCK_SIZE (0x10000)
+
+typedef struct VmassImageHeader { // size is 0x40
+	SceUInt32 magic;
+	SceUInt16 version;
+	SceUInt16 header_size;
+	SceUInt32 flags;
+	SceUInt32 extent_num;
+	SceUInt64 storage_size;
+	SceUInt64 extent_offset;  // file offset of the extent table
+	SceUInt64 data_size;      // bytes of extent data from VMASS_IMAGE_DATA_OFFSET
+	SceUInt8  reserved[0x18];
+} VmassImageHeader;
+
+typedef struct VmassImageExtent { // size is 0x10
+	SceUInt32 sector_pos;
+	SceUInt32 sector_num;
+	SceUInt64 file_offset;
+} VmassImageExtent;
+
+typedef struct VmassImageBlock {
+	SceUInt32 comp_size;
+} VmassImageBlock;
+
+#endif	/* _VMASS_IMAGE_H_ */
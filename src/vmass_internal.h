@@ -0,0 +1,124 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Internal Header
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VMASS_INTERNAL_H_
+#define _VMASS_INTERNAL_H_
+
+#include <psp2kern/types.h>
+#include <psp2kern/kernel/threadmgr.h>
+#include "vmass.h"
+#include "vmass_config.h"
+
+#define VMASS_REQ_READ  (1 << 0)
+#define VMASS_REQ_WRITE (1 << 1)
+#define VMASS_REQ_DONE  (1 << 16)
+
+#define VMASS_KERNEL_HEAP (0x1000B)
+
+extern SceSize g_vmass_size;
+extern SceKernelLwMutexWork lw_mtx;
+extern int vmass_worker_num;
+extern SceUID queue_evf_id;
+extern VmassStorageMemtype vmass_storage_memtype[];
+extern SceSize vmass_storage_memtype_num;
+extern SceSize vmass_storage_capacity;
+
+int _vmassReadSector(SceSize sector_pos, void *data, SceSize sector_num);
+int _vmassWriteSector(SceSize sector_pos, const void *data, SceSize sector_num);
+
+int vmassCheckSector(SceSize sector_pos, SceSize sector_num);
+
+/*
+ * Storage is allocated by vmassInit from the memtypes of the list in priority order until it reaches capacity bytes,
+ * taking at most max_size bytes from each. It ends up smaller if the memory runs out first. module_start calls
+ * vmassInit, so only the capacity and memtype lines of vmass.cfg get here in time. The default is 6MiB of
+ * ScePhyMemPartPhyCont.
+ */
+int vmassSetStorageCapacity(SceSize capacity, const VmassStorageMemtype *list, SceSize num);
+
+/*
+ * Cluster size used when vmassInit formats uma0:, a power of two from 0x200 to 0x10000, 0 picks it from the capacity.
+ * FAT12, FAT16 or FAT32 follows from the resulting cluster count. Set from the cluster_size line of vmass.cfg.
+ */
+int vmassSetFormatClusterSize(SceSize size);
+
+/*
+ * The data region of a formatted uma0: starts on a multiple of size, a power of two from 0x200 to 0x100000, 64KiB by default.
+ * Clusters then line up with the 64KiB thin pages. Set from the cluster_align line of vmass.cfg.
+ */
+int vmassSetFormatAlign(SceSize size);
+
+/* vmass_queue.c */
+int vmassQueueInit(void);
+int vmassQueueSetWorker(int priority, int work_priority, SceSize stack_size, SceUInt32 cpu_mask);
+int vmassQueueFini(void);
+int vmassQueueEnter(void);
+void vmassQueueLeave(void);
+int vmassQueueBlock(void);
+int vmassQueueUnblock(void);
+int vmassQueueGetTag(void);
+void vmassQueuePutTag(int tag);
+int vmassSplitSector(unsigned int opcode, SceSize sector_pos, void *data, SceSize sector_num, SceSize split_sector);
+
+/* vmass_range.c */
+int vmassRangeInit(SceSize size);
+int vmassRangeFini(void);
+int vmassRangeLock(int tag, unsigned int opcode, SceSize sector_pos, SceSize sector_num);
+void vmassRangeUnlock(unsigned int opcode, SceSize sector_pos, SceSize sector_num);
+
+/* vmass_image.c */
+int vmassImageInit(SceSize size);
+int vmassImageFini(void);
+void vmassImageMarkDirty(SceSize sector_pos, SceSize sector_num);
+int vmassImageFault(SceSize sector_pos, SceSize sector_num);
+int vmassImageCopyOut(SceSize off, void *dst, SceSize size, void *scratch);
+int vmassImageSetPath(const char (*path)[VMASS_IMAGE_PATH_LEN], SceSize num);
+
+/* vmass_snapshot.c */
+int vmassSnapshotInit(SceSize size);
+int vmassSnapshotFini(void);
+int vmassSnapshotFault(SceSize sector_pos, SceSize sector_num);
+int vmassSnapshotCopyOut(SceSize sector_pos, void *dst, SceSize sector_num, void *scratch, int consume);
+void vmassSnapshotTake(void);
+void vmassSnapshotRelease(void);
+
+/* vmass_reclaim.c */
+int vmassReclaimInit(void);
+int vmassReclaimFini(void);
+void vmassReclaimKick(void);
+void vmassReclaimNoteWrite(void);
+
+/* vmass_journal.c */
+int vmassJournalInit(int replay);
+int vmassJournalSetPath(const char (*image_path)[VMASS_IMAGE_PATH_LEN], SceSize num);
+void vmassJournalAppend(SceSize sector_pos, const void *data, SceSize sector_num);
+SceUInt64 vmassJournalMark(void);
+int vmassJournalCompact(SceUInt64 seq);
+
+/* vmass_stat.c */
+void vmassStatRequest(unsigned int opcode, SceSize sector_num, SceUInt32 time);
+void vmassStatChunk(SceSize queue_num, SceSize inline_num);
+void vmassStatLockWait(SceUInt32 time);
+
+/* vmass_trace.c */
+int vmassTraceInit(void);
+void vmassTraceRecord(unsigned int opcode, SceSize sector_pos, SceSize sector_num, SceUInt32 time_s, SceUInt32 latency, int flags);
+
+/* vmass_calib.c */
+SceSize vmassGetReadSplitSector(SceSize sector_pos);
+SceSize vmassGetWriteSplitSector(SceSize sector_pos);
+int vmassCalibrateInit(void);
+
+#endif	/* _VMASS_INTERNAL_H_ */
@@ -0,0 +1,369 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Image I/O
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/threadmgr.h>
+#include <psp2kern/kernel/sysmem.h>
+#include <psp2kern/kernel/sysclib.h>
+#include <psp2kern/io/fcntl.h>
+#include "vmass.h"
+#include "vmass_io.h"
+
+#define VMASS_IO_THREAD_PRIORITY (0x60)
+
+#define VMASS_IO_CHUNK_MIN (0x10000)
+#define VMASS_IO_CHUNK_MAX (0x400000)
+#define VMASS_IO_CHUNK_DEF (0x40000)
+
+#define VMASS_IO_REQ  (1 << 0)
+#define VMASS_IO_DONE (1 << 1)
+#define VMASS_IO_EXIT (1 << 2)
+
+SceSize vmass_io_chunk_size = VMASS_IO_CHUNK_DEF;
+
+VmassImageIoStat vmass_io_stat;
+
+int vmassIoPread(SceUID fd, void *data, SceSize size, SceOff offset){
+
+	int res;
+	SceInt64 time_s;
+
+	time_s = ksceKernelGetSystemTimeWide();
+
+	while(size != 0){
+		res = ksceIoPread(fd, data, size, offset);
+		if(res <= 0)
+			return (res < 0) ? res : -1;
+
+		__atomic_add_fetch(&vmass_io_stat.read_bytes, res, __ATOMIC_RELAXED);
+
+		data   += res;
+		size   -= res;
+		offset += res;
+	}
+
+	__atomic_add_fetch(&vmass_io_stat.read_time, ksceKernelGetSystemTimeWide() - time_s, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+int vmassIoPwrite(SceUID fd, const void *data, SceSize size, SceOff offset){
+
+	int res;
+	SceInt64 time_s;
+
+	time_s = ksceKernelGetSystemTimeWide();
+
+	while(size != 0){
+		res = ksceIoPwrite(fd, data, size, offset);
+		if(res <= 0)
+			return (res < 0) ? res : -1;
+
+		__atomic_add_fetch(&vmass_io_stat.write_bytes, res, __ATOMIC_RELAXED);
+
+		data   += res;
+		size   -= res;
+		offset += res;
+	}
+
+	__atomic_add_fetch(&vmass_io_stat.write_time, ksceKernelGetSystemTimeWide() - time_s, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+/*
+ * Bytes from offset to the end of its chunk.
+ */
+static SceSize vmassIoChunkLeft(const VmassIoStream *stream, SceOff offset){
+	return stream->chunk_size - (SceSize)(offset & (stream->chunk_size - 1));
+}
+
+/*
+ * Transfer one buffer. A read stops short at the end of the stream.
+ */
+static int vmassIoTransfer(VmassIoStream *stream, int idx){
+
+	if(stream->mode == VMASS_IO_WRITE)
+		return vmassIoPwrite(stream->fd, stream->buf[idx], stream->buf_size[idx], stream->buf_offset[idx]);
+
+	if(stream->buf_size[idx] > (stream->end - stream->buf_offset[idx]))
+		stream->buf_size[idx] = stream->end - stream->buf_offset[idx];
+
+	return vmassIoPread(stream->fd, stream->buf[idx], stream->buf_size[idx], stream->buf_offset[idx]);
+}
+
+static int sceVmassIoThread(SceSize args, void *argp){
+
+	int res;
+	unsigned int bits;
+	VmassIoStream *stream = *(VmassIoStream **)argp;
+
+	while(1){
+		bits = 0;
+		res = ksceKernelWaitEventFlag(stream->evf_id, VMASS_IO_REQ | VMASS_IO_EXIT, SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, &bits, NULL);
+		if(res < 0)
+			continue;
+
+		if((bits & VMASS_IO_REQ) != 0){
+			res = vmassIoTransfer(stream, stream->pending);
+			if(res < 0 && stream->res >= 0)
+				stream->res = res;
+
+			ksceKernelSetEventFlag(stream->evf_id, VMASS_IO_DONE);
+		}
+
+		if((bits & VMASS_IO_EXIT) != 0)
+			break;
+	}
+
+	return 0;
+}
+
+static void vmassIoWaitPending(VmassIoStream *stream){
+
+	if(stream->pending < 0)
+		return;
+
+	ksceKernelWaitEventFlag(stream->evf_id, VMASS_IO_DONE, SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, NULL, NULL);
+	stream->pending = -1;
+}
+
+static void vmassIoSubmit(VmassIoStream *stream, int idx){
+	stream->pending = idx;
+	ksceKernelSetEventFlag(stream->evf_id, VMASS_IO_REQ);
+}
+
+/*
+ * Hand the filled buffer to the thread and continue in the other one once its previous chunk is written.
+ */
+static int vmassIoFlushBuffer(VmassIoStream *stream){
+
+	int idx = stream->cur;
+
+	if(stream->buf_size[idx] == 0)
+		return 0;
+
+	vmassIoWaitPending(stream);
+
+	if(stream->res < 0)
+		return stream->res;
+
+	vmassIoSubmit(stream, idx);
+
+	stream->cur = idx ^ 1;
+	stream->buf_offset[idx ^ 1] = stream->buf_offset[idx] + stream->buf_size[idx];
+	stream->buf_size[idx ^ 1]   = 0;
+
+	return 0;
+}
+
+int vmassIoWrite(VmassIoStream *stream, const void *data, SceSize size){
+
+	int idx, res;
+	SceSize work_size;
+
+	while(size != 0){
+		idx = stream->cur;
+
+		work_size = vmassIoChunkLeft(stream, stream->buf_offset[idx] + stream->buf_size[idx]);
+		if(work_size > size)
+			work_size = size;
+
+		memcpy(stream->buf[idx] + stream->buf_size[idx], data, work_size);
+		stream->buf_size[idx] += work_size;
+
+		data += work_size;
+		size -= work_size;
+
+		if(vmassIoChunkLeft(stream, stream->buf_offset[idx] + stream->buf_size[idx]) == stream->chunk_size){
+			res = vmassIoFlushBuffer(stream);
+			if(res < 0)
+				return res;
+		}
+	}
+
+	return 0;
+}
+
+static int vmassIoCovers(const VmassIoStream *stream, int idx, SceOff offset){
+	return offset >= stream->buf_offset[idx] && offset < (stream->buf_offset[idx] + stream->buf_size[idx]);
+}
+
+/*
+ * Make the caller's buffer hold offset and prefetch the chunk after it. A jump forward reads its chunk in the caller.
+ */
+static int vmassIoReadChunk(VmassIoStream *stream, SceOff offset){
+
+	int res, idx = stream->cur;
+	SceOff next;
+
+	if(vmassIoCovers(stream, idx, offset))
+		return 0;
+
+	vmassIoWaitPending(stream);
+
+	if(stream->res < 0)
+		return stream->res;
+
+	if(vmassIoCovers(stream, idx ^ 1, offset)){
+		idx ^= 1;
+	}else{
+		stream->buf_offset[idx] = offset & ~(SceOff)(stream->chunk_size - 1);
+		stream->buf_size[idx]   = stream->chunk_size;
+
+		res = vmassIoTransfer(stream, idx);
+		if(res < 0)
+			return res;
+	}
+
+	stream->cur = idx;
+
+	next = stream->buf_offset[idx] + stream->chunk_size;
+	if(next < stream->end){
+		stream->buf_offset[idx ^ 1] = next;
+		stream->buf_size[idx ^ 1]   = stream->chunk_size;
+		vmassIoSubmit(stream, idx ^ 1);
+	}
+
+	return 0;
+}
+
+/*
+ * Reads are expected to move forward, each at or after the previous one.
+ */
+int vmassIoRead(VmassIoStream *stream, void *data, SceSize size, SceOff offset){
+
+	int res, idx;
+	SceSize work_size;
+
+	if(offset + size > stream->end)
+		return -1;
+
+	while(size != 0){
+		res = vmassIoReadChunk(stream, offset);
+		if(res < 0)
+			return res;
+
+		idx = stream->cur;
+
+		work_size = stream->buf_offset[idx] + stream->buf_size[idx] - offset;
+		if(work_size > size)
+			work_size = size;
+
+		memcpy(data, stream->buf[idx] + (SceSize)(offset - stream->buf_offset[idx]), work_size);
+
+		data   += work_size;
+		size   -= work_size;
+		offset += work_size;
+	}
+
+	return 0;
+}
+
+int vmassIoOpen(VmassIoStream *stream, SceUID fd, int mode, SceOff offset, SceOff end){
+
+	int res;
+
+	memset(stream, 0, sizeof(*stream));
+
+	stream->fd         = fd;
+	stream->mode       = mode;
+	stream->chunk_size = vmass_io_chunk_size;
+	stream->end        = end;
+	stream->pending    = -1;
+
+	stream->memid = ksceKernelAllocMemBlock("VmassIoBuffer", 0x1020D006, stream->chunk_size * 2, NULL);
+	if(stream->memid < 0)
+		return stream->memid;
+
+	ksceKernelGetMemBlockBase(stream->memid, &stream->buf[0]);
+	stream->buf[1] = stream->buf[0] + stream->chunk_size;
+
+	stream->buf_offset[0] = offset;
+	stream->buf_offset[1] = offset;
+
+	stream->evf_id = ksceKernelCreateEventFlag("VmassIoEvf", 0, 0, NULL);
+	if(stream->evf_id < 0){
+		res = stream->evf_id;
+		goto free_buffer;
+	}
+
+	stream->thid = ksceKernelCreateThread("SceVmassIoThread", sceVmassIoThread, VMASS_IO_THREAD_PRIORITY, 0x1000, 0, 0, NULL);
+	if(stream->thid < 0){
+		res = stream->thid;
+		goto del_evf;
+	}
+
+	res = ksceKernelStartThread(stream->thid, sizeof(stream), &stream);
+	if(res < 0)
+		goto del_thread;
+
+	return 0;
+
+del_thread:
+	ksceKernelDeleteThread(stream->thid);
+
+del_evf:
+	ksceKernelDeleteEventFlag(stream->evf_id);
+
+free_buffer:
+	ksceKernelFreeMemBlock(stream->memid);
+
+	return res;
+}
+
+/*
+ * Write out what is left of a write stream and stop the thread. Returns the first error of the stream.
+ */
+int vmassIoClose(VmassIoStream *stream){
+
+	if(stream->mode == VMASS_IO_WRITE)
+		vmassIoFlushBuffer(stream);
+
+	vmassIoWaitPending(stream);
+
+	ksceKernelSetEventFlag(stream->evf_id, VMASS_IO_EXIT);
+	ksceKernelWaitThreadEnd(stream->thid, NULL, NULL);
+	ksceKernelDeleteThread(stream->thid);
+
+	ksceKernelDeleteEventFlag(stream->evf_id);
+	ksceKernelFreeMemBlock(stream->memid);
+
+	return stream->res;
+}
+
+int vmassSetImageIoChunk(SceSize size){
+
+	if(size < VMASS_IO_CHUNK_MIN || size > VMASS_IO_CHUNK_MAX || (size & (size - 1)) != 0)
+		return -1;
+
+	vmass_io_chunk_size = size;
+
+	return 0;
+}
+
+int vmassGetImageIoStat(VmassImageIoStat *stat){
+
+	if(stat == NULL)
+		return -1;
+
+	stat->read_bytes     = __atomic_load_n(&vmass_io_stat.read_bytes, __ATOMIC_RELAXED);
+	stat->read_time      = __atomic_load_n(&vmass_io_stat.read_time, __ATOMIC_RELAXED);
+	stat->write_bytes    = __atomic_load_n(&vmass_io_stat.write_bytes, __ATOMIC_RELAXED);
+	stat->write_time     = __atomic_load_n(&vmass_io_stat.write_time, __ATOMIC_RELAXED);
+	stat->last_load_time = __atomic_load_n(&vmass_io_stat.last_load_time, __ATOMIC_RELAXED);
+	stat->last_save_time = __atomic_load_n(&vmass_io_stat.last_save_time, __ATOMIC_RELAXED);
+
+	return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Image I/O
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VMASS_IO_H_
+#define _VMASS_IO_H_
+
+#include <psp2kern/types.h>
+#include "vmass.h"
+
+#define VMASS_IO_READ  (0)
+#define VMASS_IO_WRITE (1)
+
+/*
+ * Sequential image file stream. Two chunk buffers alternate between the caller, which fills or drains one,
+ * and SceVmassIoThread, which writes or reads the other. Chunk boundaries fall on multiples of the chunk size in the file.
+ */
+typedef struct VmassIoStream {
+	SceUID fd;
+	int mode;
+	SceSize chunk_size;
+	SceOff end;           // read streams stop here
+	SceUID memid, evf_id, thid;
+	void *buf[2];
+	SceOff buf_offset[2];
+	SceSize buf_size[2];  // bytes filled, or read by the thread
+	int cur;              // buffer the caller owns
+	int pending;          // buffer owned by the thread, -1 if none
+	int res;              // first error of the thread
+} VmassIoStream;
+
+extern SceSize vmass_io_chunk_size;
+extern VmassImageIoStat vmass_io_stat;
+
+/*
+ * Whole transfers at offset, retried on short counts. Both count into the image I/O statistics.
+ */
+int vmassIoPread(SceUID fd, void *data, SceSize size, SceOff offset);
+int vmassIoPwrite(SceUID fd, const void *data, SceSize size, SceOff offset);
+
+/*
+ * A write stream appends from offset, a read stream reads forward from offset up to end.
+ */
+int vmassIoOpen(VmassIoStream *stream, SceUID fd, int mode, SceOff offset, SceOff end);
+int vmassIoClose(VmassIoStream *stream);
+
+int vmassIoWrite(VmassIoStream *stream, const void *data, SceSize size);
+int vmassIoRead(VmassIoStream *stream, void *data, SceSize size, SceOff offset);
+
+#endif	/* _VMASS_IO_H_ */
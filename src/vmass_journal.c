@@ -0,0 +1,582 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Journal
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/threadmgr.h>
+#include <psp2kern/kernel/sysmem.h>
+#include <psp2kern/kernel/sysclib.h>
+#include <psp2kern/io/fcntl.h>
+#include <psp2kern/io/stat.h>
+#include "vmass.h"
+#include "vmass_journal.h"
+#include "vmass_io.h"
+#include "vmass_internal.h"
+
+#define VMASS_JOURNAL_THREAD_PRIORITY (0x60)
+
+/*
+ * Writes are appended to one of two buffers while SceVmassJournalThread commits the other.
+ */
+#define VMASS_JOURNAL_BUFFER_SIZE (0x40000)
+
+#define VMASS_JOURNAL_LATENCY_DEF (100000)
+
+#define VMASS_JOURNAL_COMMIT (1 << 0)
+#define VMASS_JOURNAL_FREE   (1 << 1)
+#define VMASS_JOURNAL_EXIT   (1 << 2)
+
+/*
+ * One journal path next to each image path, see vmassJournalSetPath.
+ */
+char vmass_journal_path[VMASS_IMAGE_PATH_MAX][VMASS_IMAGE_PATH_LEN] = {
+	"sd0:vmass.jnl",
+	"ux0:data/vmass.jnl"
+};
+SceSize vmass_journal_path_num = 2;
+
+int vmass_journal_mode = VMASS_JOURNAL_OFF;
+SceUInt32 vmass_journal_latency = VMASS_JOURNAL_LATENCY_DEF;
+
+int journal_ready, journal_active, journal_path_idx = -1;
+SceUID journal_fd = -1, journal_memid = -1, journal_evf_id = -1, journal_thid = -1;
+
+SceKernelLwMutexWork journal_mtx; // owns the buffers and journal_seq
+SceKernelLwMutexWork commit_mtx;  // owns the file
+
+void *journal_buf[2];
+SceSize journal_fill[2];
+int journal_cur;
+SceOff journal_offset;  // end of the committed records
+SceUInt64 journal_seq;  // bytes appended since the journal started
+
+SceUInt32 vmassJournalChecksum(SceUInt32 sum, const void *data, SceSize size){
+
+	const SceUInt32 *word = data;
+
+	while(size != 0){
+		sum = (sum ^ *word++) * 0x01000193;
+		size -= 4;
+	}
+
+	return sum;
+}
+
+static SceUInt32 vmassJournalRecordChecksum(const VmassJournalRecord *record){
+
+	VmassJournalRecord header = *record;
+
+	header.checksum = 0;
+
+	return vmassJournalChecksum(vmassJournalChecksum(VMASS_JOURNAL_CHECKSUM_INIT, &header, sizeof(header)), &record[1], record->sector_num << 9);
+}
+
+/*
+ * Called with the write's range lock held, so overlapping writes are journaled in the order they were applied.
+ * Only waits when both buffers are full.
+ */
+void vmassJournalAppend(SceSize sector_pos, const void *data, SceSize sector_num){
+
+	SceSize work_num, size;
+	VmassJournalRecord *record;
+
+	if(__atomic_load_n(&journal_active, __ATOMIC_ACQUIRE) == 0)
+		return;
+
+	ksceKernelLockFastMutex(&journal_mtx);
+
+	while(sector_num != 0 && journal_active != 0){
+		work_num = sector_num;
+		if(work_num > VMASS_JOURNAL_RECORD_SECTOR)
+			work_num = VMASS_JOURNAL_RECORD_SECTOR;
+
+		size = sizeof(*record) + (work_num << 9);
+
+		if((journal_fill[journal_cur] + size) > VMASS_JOURNAL_BUFFER_SIZE){
+			ksceKernelClearEventFlag(journal_evf_id, ~VMASS_JOURNAL_FREE);
+			ksceKernelUnlockFastMutex(&journal_mtx);
+
+			ksceKernelSetEventFlag(journal_evf_id, VMASS_JOURNAL_COMMIT);
+			ksceKernelWaitEventFlag(journal_evf_id, VMASS_JOURNAL_FREE, SCE_EVENT_WAITOR, NULL, NULL);
+
+			ksceKernelLockFastMutex(&journal_mtx);
+			continue;
+		}
+
+		record = journal_buf[journal_cur] + journal_fill[journal_cur];
+		record->magic      = VMASS_JOURNAL_MAGIC;
+		record->sector_pos = sector_pos;
+		record->sector_num = work_num;
+		record->checksum   = 0;
+
+		memcpy(&record[1], data, work_num << 9);
+
+		journal_fill[journal_cur] += size;
+		journal_seq += size;
+
+		sector_pos += work_num;
+		data       += work_num << 9;
+		sector_num -= work_num;
+	}
+
+	ksceKernelUnlockFastMutex(&journal_mtx);
+}
+
+/*
+ * Write the records appended so far and sync the file. A failed commit turns the journal off and removes it,
+ * as it would no longer match the image after the next save.
+ */
+static int vmassJournalCommit(void){
+
+	int res = 0, idx;
+	SceSize size, offset;
+	VmassJournalRecord *record;
+
+	ksceKernelLockFastMutex(&commit_mtx);
+
+	ksceKernelLockFastMutex(&journal_mtx);
+
+	idx  = journal_cur;
+	size = journal_fill[idx];
+	if(size != 0)
+		journal_cur = idx ^ 1;
+
+	ksceKernelUnlockFastMutex(&journal_mtx);
+
+	if(size != 0 && journal_fd >= 0){
+		for(offset=0;offset<size;offset+=sizeof(*record) + (record->sector_num << 9)){
+			record = journal_buf[idx] + offset;
+			record->checksum = vmassJournalRecordChecksum(record);
+		}
+
+		res = vmassIoPwrite(journal_fd, journal_buf[idx], size, journal_offset);
+		if(res >= 0)
+			res = ksceIoSyncByFd(journal_fd);
+
+		if(res >= 0){
+			journal_offset += size;
+		}else{
+			__atomic_store_n(&journal_active, 0, __ATOMIC_RELEASE);
+			ksceIoRemove(vmass_journal_path[journal_path_idx]);
+		}
+	}
+
+	ksceKernelLockFastMutex(&journal_mtx);
+	journal_fill[idx] = 0;
+	ksceKernelUnlockFastMutex(&journal_mtx);
+
+	ksceKernelUnlockFastMutex(&commit_mtx);
+
+	ksceKernelSetEventFlag(journal_evf_id, VMASS_JOURNAL_FREE);
+
+	return res;
+}
+
+static int sceVmassJournalThread(SceSize args, void *argp){
+
+	unsigned int bits;
+	SceUInt timeout;
+
+	while(1){
+		bits    = 0;
+		timeout = vmass_journal_latency;
+
+		ksceKernelWaitEventFlag(journal_evf_id, VMASS_JOURNAL_COMMIT | VMASS_JOURNAL_EXIT, SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, &bits, &timeout);
+
+		vmassJournalCommit();
+
+		if((bits & VMASS_JOURNAL_EXIT) != 0)
+			break;
+	}
+
+	return 0;
+}
+
+/*
+ * Apply the records of the journal found on the card. Returns the number of records applied and the end of
+ * the last one in end, or < 0 if there is no journal.
+ */
+static int vmassJournalReplay(SceOff *end){
+
+	int res, i, count = 0;
+	SceUID fd = -1;
+	SceIoStat stat;
+	SceOff offset = 0;
+	VmassIoStream stream;
+	VmassJournalRecord *record = journal_buf[0];
+
+	for(i=0;i<vmass_journal_path_num;i++){
+		fd = ksceIoOpen(vmass_journal_path[i], SCE_O_RDONLY, 0);
+		if(fd >= 0)
+			break;
+	}
+
+	if(fd < 0)
+		return fd;
+
+	journal_path_idx = i;
+
+	res = ksceIoGetstatByFd(fd, &stat);
+	if(res < 0)
+		goto io_close;
+
+	res = vmassIoOpen(&stream, fd, VMASS_IO_READ, 0, stat.st_size);
+	if(res < 0)
+		goto io_close;
+
+	while((offset + sizeof(*record)) <= stat.st_size){
+		if(vmassIoRead(&stream, record, sizeof(*record), offset) < 0)
+			break;
+
+		if(record->magic != VMASS_JOURNAL_MAGIC || record->sector_num == 0 || record->sector_num > VMASS_JOURNAL_RECORD_SECTOR
+			|| vmassCheckSector(record->sector_pos, record->sector_num) < 0
+			|| (offset + sizeof(*record) + (record->sector_num << 9)) > stat.st_size)
+			break;
+
+		if(vmassIoRead(&stream, &record[1], record->sector_num << 9, offset + sizeof(*record)) < 0)
+			break;
+
+		if(vmassJournalRecordChecksum(record) != record->checksum)
+			break;
+
+		if(vmassWriteSector(record->sector_pos, &record[1], record->sector_num) < 0)
+			break;
+
+		offset += sizeof(*record) + (record->sector_num << 9);
+		count++;
+	}
+
+	vmassIoClose(&stream);
+
+	*end = offset;
+	res  = count;
+
+io_close:
+	ksceIoClose(fd);
+
+	return res;
+}
+
+/*
+ * Open the journal file. Records that were replayed but not saved to the image yet are kept
+ * and the journal goes on after them.
+ */
+static int vmassJournalOpen(SceOff end){
+
+	int i;
+	SceIoStat stat;
+
+	if(journal_path_idx >= 0){
+		journal_fd = ksceIoOpen(vmass_journal_path[journal_path_idx], SCE_O_WRONLY | SCE_O_CREAT, 0666);
+		if(journal_fd >= 0){
+			stat.st_size = end;
+			ksceIoChstatByFd(journal_fd, &stat, SCE_CST_SIZE);
+			journal_offset = end;
+			return 0;
+		}
+	}
+
+	for(i=0;i<vmass_journal_path_num;i++){
+		journal_fd = ksceIoOpen(vmass_journal_path[i], SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0666);
+		if(journal_fd >= 0)
+			break;
+	}
+
+	if(journal_fd < 0)
+		return journal_fd;
+
+	journal_path_idx = i;
+	journal_offset   = 0;
+
+	return 0;
+}
+
+static void vmassJournalClose(void){
+
+	ksceIoClose(journal_fd);
+	journal_fd = -1;
+
+	ksceKernelFreeMemBlock(journal_memid);
+	journal_memid  = -1;
+	journal_buf[0] = NULL;
+	journal_buf[1] = NULL;
+}
+
+/*
+ * Start journaling. With replay the journal left on the card is applied first. Then every write is journaled
+ * and the storage is saved if it does not match the image, which compacts the journal.
+ */
+static int vmassJournalStart(int replay){
+
+	int res, count = 0;
+	SceOff end = 0;
+	SceSize dirty_size = 0;
+
+	journal_memid = ksceKernelAllocMemBlock("VmassJournalBuffer", 0x1020D006, VMASS_JOURNAL_BUFFER_SIZE * 2, NULL);
+	if(journal_memid < 0)
+		return journal_memid;
+
+	ksceKernelGetMemBlockBase(journal_memid, &journal_buf[0]);
+	journal_buf[1] = journal_buf[0] + VMASS_JOURNAL_BUFFER_SIZE;
+
+	journal_path_idx = -1;
+
+	if(replay != 0){
+		count = vmassJournalReplay(&end);
+		if(count < 0)
+			count = 0;
+	}
+
+	if(count == 0)
+		end = 0;
+
+	res = vmassJournalOpen(end);
+	if(res < 0)
+		goto close;
+
+	journal_fill[0] = 0;
+	journal_fill[1] = 0;
+	journal_cur     = 0;
+	journal_seq     = 0;
+
+	ksceKernelClearEventFlag(journal_evf_id, 0);
+
+	journal_thid = ksceKernelCreateThread("SceVmassJournalThread", sceVmassJournalThread, VMASS_JOURNAL_THREAD_PRIORITY, 0x1000, 0, 0, NULL);
+	if(journal_thid < 0){
+		res = journal_thid;
+		goto close;
+	}
+
+	res = ksceKernelStartThread(journal_thid, 0, NULL);
+	if(res < 0){
+		ksceKernelDeleteThread(journal_thid);
+		journal_thid = -1;
+		goto close;
+	}
+
+	__atomic_store_n(&journal_active, 1, __ATOMIC_RELEASE);
+
+	vmassGetDirtySize(&dirty_size);
+
+	if(count != 0 || dirty_size != 0)
+		vmassCreateImage();
+
+	return 0;
+
+close:
+	vmassJournalClose();
+
+	return res;
+}
+
+/*
+ * The journal only matches the image while it takes every write, so it is removed when turned off.
+ */
+static int vmassJournalStop(void){
+
+	__atomic_store_n(&journal_active, 0, __ATOMIC_RELEASE);
+
+	ksceKernelSetEventFlag(journal_evf_id, VMASS_JOURNAL_EXIT);
+	ksceKernelWaitThreadEnd(journal_thid, NULL, NULL);
+	ksceKernelDeleteThread(journal_thid);
+	journal_thid = -1;
+
+	vmassJournalClose();
+
+	ksceIoRemove(vmass_journal_path[journal_path_idx]);
+	journal_path_idx = -1;
+
+	return 0;
+}
+
+/*
+ * Position of the journal before a save.
+ */
+SceUInt64 vmassJournalMark(void){
+
+	SceUInt64 seq;
+
+	if(__atomic_load_n(&journal_active, __ATOMIC_ACQUIRE) == 0)
+		return 0;
+
+	ksceKernelLockFastMutex(&journal_mtx);
+	seq = journal_seq;
+	ksceKernelUnlockFastMutex(&journal_mtx);
+
+	return seq;
+}
+
+/*
+ * The image was saved from a storage holding every write journaled before seq. If nothing was journaled since,
+ * the journal is emptied. Otherwise it is kept whole, replaying it over the new image still gives the storage.
+ */
+int vmassJournalCompact(SceUInt64 seq){
+
+	int res = 0;
+	SceIoStat stat;
+
+	if(__atomic_load_n(&journal_active, __ATOMIC_ACQUIRE) == 0)
+		return 0;
+
+	ksceKernelLockFastMutex(&commit_mtx);
+	ksceKernelLockFastMutex(&journal_mtx);
+
+	if(journal_seq == seq){
+		stat.st_size = 0;
+
+		res = ksceIoChstatByFd(journal_fd, &stat, SCE_CST_SIZE);
+		if(res >= 0){
+			journal_fill[journal_cur] = 0;
+			journal_offset = 0;
+		}
+	}
+
+	ksceKernelUnlockFastMutex(&journal_mtx);
+	ksceKernelUnlockFastMutex(&commit_mtx);
+
+	return res;
+}
+
+int vmassFlushJournal(void){
+
+	if(__atomic_load_n(&journal_active, __ATOMIC_ACQUIRE) == 0)
+		return -1;
+
+	return vmassJournalCommit();
+}
+
+int vmassSetJournalMode(int mode, SceUInt32 latency){
+
+	int res = 0;
+
+	if(mode != VMASS_JOURNAL_OFF && mode != VMASS_JOURNAL_ON)
+		return -1;
+
+	if(latency == 0)
+		latency = VMASS_JOURNAL_LATENCY_DEF;
+
+	if(latency < VMASS_JOURNAL_LATENCY_MIN || latency > VMASS_JOURNAL_LATENCY_MAX)
+		return -1;
+
+	vmass_journal_latency = latency;
+
+	if(journal_ready == 0){
+		vmass_journal_mode = mode;
+		return 0;
+	}
+
+	if(mode == VMASS_JOURNAL_ON && journal_thid < 0){
+		res = vmassJournalStart(0);
+	}else if(mode == VMASS_JOURNAL_OFF && journal_thid >= 0){
+		vmassQueueBlock();
+		res = vmassJournalStop();
+		vmassQueueUnblock();
+	}
+
+	if(res >= 0)
+		vmass_journal_mode = mode;
+
+	return res;
+}
+
+/*
+ * The journal of an image path replaces its extension with .jnl.
+ */
+int vmassJournalSetPath(const char (*image_path)[VMASS_IMAGE_PATH_LEN], SceSize num){
+
+	SceSize i, len, ext;
+
+	if(num == 0 || num > VMASS_IMAGE_PATH_MAX)
+		return -1;
+
+	for(i=0;i<num;i++){
+		len = strnlen(image_path[i], VMASS_IMAGE_PATH_LEN);
+
+		for(ext=len;ext>0;ext--){
+			if(image_path[i][ext - 1] == '.' || image_path[i][ext - 1] == '/' || image_path[i][ext - 1] == ':')
+				break;
+		}
+
+		if(ext == 0 || image_path[i][ext - 1] != '.')
+			ext = len + 1;
+
+		if((ext + 4) > VMASS_IMAGE_PATH_LEN)
+			return -1;
+
+		memcpy(vmass_journal_path[i], image_path[i], ext - 1);
+		memcpy(&vmass_journal_path[i][ext - 1], ".jnl", 5);
+	}
+
+	vmass_journal_path_num = num;
+
+	return 0;
+}
+
+/*
+ * Called by vmassInit once the storage holds the image, with replay set if it was loaded from the card.
+ * A journal left by a session that had it on is still replayed, and kept on until it is saved to the image.
+ */
+int vmassJournalInit(int replay){
+
+	int res, i;
+	SceIoStat stat;
+	SceSize dirty_size = 0;
+
+	res = ksceKernelInitializeFastMutex(&journal_mtx, "VmassJournalMutex", 0, 0);
+	if(res < 0)
+		return res;
+
+	res = ksceKernelInitializeFastMutex(&commit_mtx, "VmassCommitMutex", 0, 0);
+	if(res < 0)
+		goto del_mtx;
+
+	journal_evf_id = ksceKernelCreateEventFlag("VmassJournalEvf", 0, 0, NULL);
+	if(journal_evf_id < 0){
+		res = journal_evf_id;
+		goto del_commit_mtx;
+	}
+
+	journal_ready = 1;
+
+	if(vmass_journal_mode == VMASS_JOURNAL_ON){
+		if(vmassJournalStart(replay) < 0)
+			vmass_journal_mode = VMASS_JOURNAL_OFF;
+
+		return 0;
+	}
+
+	for(i=0;i<vmass_journal_path_num;i++){
+		if(replay != 0 && ksceIoGetstat(vmass_journal_path[i], &stat) >= 0 && stat.st_size != 0)
+			break;
+	}
+
+	if(i == vmass_journal_path_num || vmassJournalStart(replay) < 0)
+		return 0;
+
+	vmassGetDirtySize(&dirty_size);
+
+	if(dirty_size == 0)
+		vmassJournalStop();
+	else
+		vmass_journal_mode = VMASS_JOURNAL_ON;
+
+	return 0;
+
+del_commit_mtx:
+	ksceKernelDeleteFastMutex(&commit_mtx);
+
+del_mtx:
+	ksceKernelDeleteFastMutex(&journal_mtx);
+
+	return res;
+}
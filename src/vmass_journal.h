@@ -0,0 +1,44 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Journal Format
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VMASS_JOURNAL_H_
+#define _VMASS_JOURNAL_H_
+
+#include <psp2kern/types.h>
+
+/*
+ * A journal is a list of records, each a VmassJournalRecord followed by sector_num sectors of data, in the order
+ * the writes were accepted. It holds every write since the image was last saved, so replaying it over that image
+ * gives back the storage. Replay stops at the first record that is torn or does not match its checksum.
+ */
+#define VMASS_JOURNAL_MAGIC (0x4A534D56) // "VMSJ"
+
+#define VMASS_JOURNAL_RECORD_SECTOR (0x80) // longer writes are split into 64KiB records
+
+typedef struct VmassJournalRecord { // size is 0x10
+	SceUInt32 magic;
+	SceUInt32 sector_pos;
+	SceUInt32 sector_num;
+	SceUInt32 checksum;   // vmassJournalChecksum of the record with checksum 0, then of its data
+} VmassJournalRecord;
+
+/*
+ * FNV-1a over 32-bit words, size is a multiple of 4. A checksum starts from VMASS_JOURNAL_CHECKSUM_INIT.
+ */
+#define VMASS_JOURNAL_CHECKSUM_INIT (0x811C9DC5)
+
+SceUInt32 vmassJournalChecksum(SceUInt32 sum, const void *data, SceSize size);
+
+#endif	/* _VMASS_JOURNAL_H_ */
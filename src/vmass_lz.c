@@ -0,0 +1,222 @@
+/*
+ * PlayStation(R)Vita Virtual Mass LZ Codec
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/sysclib.h>
+#include "vmass_lz.h"
+
+#define VMASS_LZ_MIN_MATCH (4)
+
+/*
+ * The last bytes are always emitted as literals so the match loop never reads past the input.
+ */
+#define VMASS_LZ_LAST_LITERALS (5)
+#define VMASS_LZ_MATCH_LIMIT   (12)
+
+static SceUInt32 vmassLzRead32(const SceUInt8 *p){
+
+	SceUInt32 v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+static SceUInt32 vmassLzHash(SceUInt32 v){
+	return (v * 2654435761U) >> (32 - VMASS_LZ_HASH_BITS);
+}
+
+static SceUInt8 *vmassLzPutLength(SceUInt8 *op, const SceUInt8 *op_end, SceSize len){
+
+	while(len >= 0xFF){
+		if(op >= op_end)
+			return NULL;
+
+		*op++ = 0xFF;
+		len  -= 0xFF;
+	}
+
+	if(op >= op_end)
+		return NULL;
+
+	*op++ = len;
+
+	return op;
+}
+
+/*
+ * match_len 0 emits the last, literal only sequence.
+ */
+static SceUInt8 *vmassLzPutSequence(SceUInt8 *op, const SceUInt8 *op_end, const SceUInt8 *lit, SceSize lit_len, SceSize offset, SceSize match_len){
+
+	SceSize ml = (match_len != 0) ? (match_len - VMASS_LZ_MIN_MATCH) : 0;
+
+	if(op >= op_end)
+		return NULL;
+
+	*op++ = (((lit_len >= 0xF) ? 0xF : lit_len) << 4) | ((ml >= 0xF) ? 0xF : ml);
+
+	if(lit_len >= 0xF){
+		op = vmassLzPutLength(op, op_end, lit_len - 0xF);
+		if(op == NULL)
+			return NULL;
+	}
+
+	if(lit_len > (SceSize)(op_end - op))
+		return NULL;
+
+	memcpy(op, lit, lit_len);
+	op += lit_len;
+
+	if(match_len == 0)
+		return op;
+
+	if((op_end - op) < 2)
+		return NULL;
+
+	*op++ = offset;
+	*op++ = offset >> 8;
+
+	if(ml >= 0xF)
+		op = vmassLzPutLength(op, op_end, ml - 0xF);
+
+	return op;
+}
+
+int vmassLzCompress(void *dst, SceSize dst_size, const void *src, SceSize src_size, void *work){
+
+	SceUInt16 *hash = work;
+	SceUInt32 h;
+	SceSize len;
+	const SceUInt8 *base = src, *ip = src, *anchor = src, *end = base + src_size, *limit, *ref;
+	SceUInt8 *op = dst, *op_end = op + dst_size;
+
+	if(src_size > VMASS_LZ_INPUT_MAX)
+		return -1;
+
+	memset(hash, 0, VMASS_LZ_WORK_SIZE);
+
+	limit = (src_size > VMASS_LZ_MATCH_LIMIT) ? (end - VMASS_LZ_MATCH_LIMIT) : base;
+
+	while(ip < limit){
+		h    = vmassLzHash(vmassLzRead32(ip));
+		ref  = base + hash[h];
+		hash[h] = ip - base;
+
+		if(ref >= ip || vmassLzRead32(ref) != vmassLzRead32(ip)){
+			// skip faster through data that does not match
+			ip += 1 + ((ip - anchor) >> 6);
+			continue;
+		}
+
+		len = VMASS_LZ_MIN_MATCH;
+		while((ip + len) < (end - VMASS_LZ_LAST_LITERALS) && ref[len] == ip[len])
+			len++;
+
+		op = vmassLzPutSequence(op, op_end, anchor, ip - anchor, ip - ref, len);
+		if(op == NULL)
+			return -1;
+
+		ip    += len;
+		anchor = ip;
+	}
+
+	op = vmassLzPutSequence(op, op_end, anchor, end - anchor, 0, 0);
+	if(op == NULL)
+		return -1;
+
+	return op - (SceUInt8 *)dst;
+}
+
+static const SceUInt8 *vmassLzGetLength(const SceUInt8 *ip, const SceUInt8 *ip_end, SceSize *len){
+
+	SceUInt8 b;
+
+	do {
+		if(ip >= ip_end)
+			return NULL;
+
+		b     = *ip++;
+		*len += b;
+	} while(b == 0xFF);
+
+	return ip;
+}
+
+int vmassLzDecompress(void *dst, SceSize dst_size, const void *src, SceSize src_size){
+
+	SceUInt8 token;
+	SceSize len, offset;
+	const SceUInt8 *ip = src, *ip_end = ip + src_size, *ref;
+	SceUInt8 *op = dst, *op_end = op + dst_size;
+
+	while(ip < ip_end){
+		token = *ip++;
+
+		len = token >> 4;
+		if(len == 0xF){
+			ip = vmassLzGetLength(ip, ip_end, &len);
+			if(ip == NULL)
+				return -1;
+		}
+
+		if(len > (SceSize)(ip_end - ip) || len > (SceSize)(op_end - op))
+			return -1;
+
+		memcpy(op, ip, len);
+		op += len;
+		ip += len;
+
+		if(ip == ip_end)
+			break;
+
+		if((ip_end - ip) < 2)
+			return -1;
+
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+
+		if(offset == 0 || offset > (SceSize)(op - (SceUInt8 *)dst))
+			return -1;
+
+		len = token & 0xF;
+		if(len == 0xF){
+			ip = vmassLzGetLength(ip, ip_end, &len);
+			if(ip == NULL)
+				return -1;
+		}
+
+		len += VMASS_LZ_MIN_MATCH;
+		if(len > (SceSize)(op_end - op))
+			return -1;
+
+		ref = op - offset;
+
+		if(offset >= 8){
+			while(len >= 8){
+				memcpy(op, ref, 8);
+				op  += 8;
+				ref += 8;
+				len -= 8;
+			}
+		}
+
+		while(len != 0){
+			*op++ = *ref++;
+			len--;
+		}
+	}
+
+	return op - (SceUInt8 *)dst;
+}
@@ -0,0 +1,42 @@
+/*
+ * PlayStation(R)Vita Virtual Mass LZ Codec Header
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VMASS_LZ_H_
+#define _VMASS_LZ_H_
+
+#include <psp2kern/types.h>
+
+/*
+ * LZ4-style byte codec for single storage chunks of up to VMASS_LZ_INPUT_MAX bytes.
+ * Each sequence is a token (literal length << 4 | match length - 4), the literals, a 16-bit match offset
+ * and the length extensions. The last sequence only has literals.
+ */
+#define VMASS_LZ_INPUT_MAX (0x10000)
+#define VMASS_LZ_HASH_BITS (12)
+
+// work area the compressor needs
+#define VMASS_LZ_WORK_SIZE (sizeof(SceUInt16) << VMASS_LZ_HASH_BITS)
+
+/*
+ * Returns the compressed size, or < 0 if the output would not fit in dst_size.
+ */
+int vmassLzCompress(void *dst, SceSize dst_size, const void *src, SceSize src_size, void *work);
+
+/*
+ * Returns the decompressed size, or < 0 if src is malformed or does not fit in dst_size.
+ */
+int vmassLzDecompress(void *dst, SceSize dst_size, const void *src, SceSize src_size);
+
+#endif	/* _VMASS_LZ_H_ */
@@ -0,0 +1,453 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Storage Page
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/sysmem.h>
+#include <psp2kern/kernel/sysclib.h>
+#include <psp2kern/kernel/dmac.h>
+#include "vmass_page.h"
+#include "vmass_copy.h"
+#include "vmass_tier.h"
+#include "vmass_internal.h"
+
+/*
+ * Largest block vmassPageAlloc asks a memtype for. A failed allocation is retried at half the size,
+ * down to VMASS_THIN_CHUNK_SIZE, before falling back to the next memtype.
+ */
+#define VMASS_PAGE_ALLOC_MAX (0x1000000)
+
+VmassPageInfo *vmass_page_list;
+SceSize vmass_page_num;
+SceSize vmass_page_max;
+SceSize vmass_page_total_size;
+SceSize vmass_page_backed_size;
+
+/*
+ * vmassPageAlloc hands out thin pages of VMASS_THIN_CHUNK_SIZE instead of one zeroed memblock.
+ * Off by default, "thin = on" in vmass.cfg turns it on.
+ */
+int vmass_thin_provision;
+
+/*
+ * While every page has the same power of two size, the page index is (off >> vmass_page_shift).
+ * Otherwise it is found by a binary search over the page offsets.
+ */
+int vmass_page_shift;
+
+int vmassPageLookup(SceSize off){
+
+	int lo, hi, mid;
+
+	if(off >= vmass_page_total_size)
+		return -1;
+
+	if(vmass_page_shift != 0)
+		return off >> vmass_page_shift;
+
+	lo = 0;
+	hi = vmass_page_num - 1;
+
+	while(lo < hi){
+		mid = (lo + hi + 1) >> 1;
+
+		if(vmass_page_list[mid].offset <= off)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	return lo;
+}
+
+SceSize vmassPageGetTotalSize(void){
+	return vmass_page_total_size;
+}
+
+int vmassPageAdd(void *base, SceSize size, SceUInt32 memtype, SceUInt32 flags){
+
+	VmassPageInfo *list;
+
+	if(vmass_page_num == vmass_page_max){
+		list = ksceKernelAllocHeapMemory(VMASS_KERNEL_HEAP, sizeof(*list) * (vmass_page_max + 0x20));
+		if(list == NULL)
+			return -1;
+
+		if(vmass_page_list != NULL){
+			memcpy(list, vmass_page_list, sizeof(*list) * vmass_page_num);
+			ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, vmass_page_list);
+		}
+
+		vmass_page_list = list;
+		vmass_page_max += 0x20;
+	}
+
+	if(vmass_page_num == 0)
+		vmass_page_shift = ((size & (size - 1)) == 0) ? __builtin_ctz(size) : 0;
+	else if(size != vmass_page_list[0].size)
+		vmass_page_shift = 0;
+
+	vmass_page_list[vmass_page_num].base    = base;
+	vmass_page_list[vmass_page_num].size    = size;
+	vmass_page_list[vmass_page_num].offset  = vmass_page_total_size;
+	vmass_page_list[vmass_page_num].memtype = memtype;
+	vmass_page_list[vmass_page_num].flags   = flags;
+	vmass_page_list[vmass_page_num].reserve = NULL;
+	vmass_page_list[vmass_page_num].comp    = NULL;
+	vmass_page_list[vmass_page_num].access  = 0;
+	vmass_page_list[vmass_page_num].idle    = 0;
+	vmass_page_num++;
+
+	vmass_page_total_size += size;
+	if(base != NULL)
+		vmass_page_backed_size += size;
+
+	return 0;
+}
+
+int vmassPageRegister(void *base, SceSize size, SceUInt32 memtype){
+	return vmassPageAdd(base, size, memtype, 0);
+}
+
+SceSize vmassPageGetBackedSize(void){
+	return __atomic_load_n(&vmass_page_backed_size, __ATOMIC_RELAXED);
+}
+
+int vmassPageIsZero(const void *data, SceSize size){
+	return (*(const char *)data == 0) && (memcmp(data, data + 1, size - 1) == 0);
+}
+
+/*
+ * Put an unused memblock of a thin page back into its reserve, or free it if the reserve is already refilled.
+ */
+void vmassPageKeep(VmassPageInfo *page, void *block){
+
+	void *expected = NULL;
+
+	if(!__atomic_compare_exchange_n(&page->reserve, &expected, block, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		ksceKernelFreeMemBlock(ksceKernelFindMemBlockByAddr(block, 0));
+}
+
+/*
+ * Back a thin page with its reserved memblock, zeroed, or with a new one once the tier gave the reserve away.
+ * Workers copying disjoint parts of one request can race here, the loser keeps its block and uses the winner's.
+ */
+static void *vmassPageBack(VmassPageInfo *page){
+
+	void *base, *expected = NULL;
+	SceUID memid;
+
+	base = __atomic_exchange_n(&page->reserve, NULL, __ATOMIC_ACQ_REL);
+	if(base == NULL){
+		memid = ksceKernelAllocMemBlock("VmassStorageChunk", page->memtype, page->size, NULL);
+		if(memid < 0){
+			vmassReclaimKick();
+			return NULL;
+		}
+
+		ksceKernelGetMemBlockBase(memid, &base);
+	}
+
+	ksceDmacMemset(base, 0, page->size);
+
+	if(!__atomic_compare_exchange_n(&page->base, &expected, base, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+		vmassPageKeep(page, base);
+		return expected;
+	}
+
+	__atomic_add_fetch(&vmass_page_backed_size, page->size, __ATOMIC_RELAXED);
+
+	return base;
+}
+
+/*
+ * Only a write that covers the whole page releases it, and that write holds the page's range lock exclusively.
+ */
+static void vmassPageRelease(VmassPageInfo *page){
+
+	void *base;
+
+	base = __atomic_exchange_n(&page->base, NULL, __ATOMIC_ACQ_REL);
+	if(base == NULL)
+		return;
+
+	vmassPageKeep(page, base);
+
+	__atomic_sub_fetch(&vmass_page_backed_size, page->size, __ATOMIC_RELAXED);
+}
+
+/*
+ * Resolve the memory behind a page, decompressing it first if the tier made it cold.
+ * *base is NULL for an unbacked thin page.
+ */
+static int vmassPageGetBase(VmassPageInfo *page, void **base){
+
+	*base = __atomic_load_n(&page->base, __ATOMIC_ACQUIRE);
+
+	if(*base == NULL){
+		if(__atomic_load_n(&page->comp, __ATOMIC_ACQUIRE) != NULL)
+			return vmassTierLoad(page, base);
+
+		// vmassTierLoad publishes base before it drops comp
+		*base = __atomic_load_n(&page->base, __ATOMIC_ACQUIRE);
+	}
+
+	if(vmass_tier_mode != VMASS_TIER_OFF)
+		vmassTierTouch(page, *base);
+
+	return 0;
+}
+
+int vmassPageRead(int page_idx, SceSize off, void *data, SceSize size){
+
+	int res;
+	void *base;
+
+	res = vmassPageGetBase(&vmass_page_list[page_idx], &base);
+	if(res < 0)
+		return vmassTierReadBounce(&vmass_page_list[page_idx], off, data, size);
+
+	if(base == NULL)
+		memset(data, 0, size);
+	else
+		vmassCopy(data, base + off, size);
+
+	return 0;
+}
+
+int vmassPageWrite(int page_idx, SceSize off, const void *data, SceSize size){
+
+	int res;
+	void *base;
+	VmassPageInfo *page = &vmass_page_list[page_idx];
+
+	res = vmassPageGetBase(page, &base);
+	if(res < 0)
+		return res;
+
+	if((page->flags & (VMASS_PAGE_THIN | VMASS_PAGE_BORROWED)) == VMASS_PAGE_THIN){
+		if(base == NULL){
+			if(vmassPageIsZero(data, size))
+				return 0;
+
+			base = vmassPageBack(page);
+			if(base == NULL)
+				return -1;
+		}else if(off == 0 && size == page->size && vmassPageIsZero(data, size)){
+			vmassPageRelease(page);
+			return 0;
+		}
+	}
+
+	vmassCopy(base + off, data, size);
+
+	return 0;
+}
+
+/*
+ * Release the thin pages a finished write request filled with zeros. A write split across the workers never hands
+ * a whole page to one vmassPageWrite, so this runs once the request is done, while it still holds its range lock.
+ */
+int vmassPageTrim(SceSize off, const void *data, SceSize size){
+
+	int page_idx;
+	VmassPageInfo *page;
+
+	page_idx = vmassPageLookup(off);
+	if(page_idx < 0)
+		return -1;
+
+	for(;page_idx < vmass_page_num;page_idx++){
+		page = &vmass_page_list[page_idx];
+		if(page->offset >= (off + size))
+			break;
+
+		if(page->offset < off || (page->offset + page->size) > (off + size))
+			continue;
+
+		if((page->flags & (VMASS_PAGE_THIN | VMASS_PAGE_BORROWED)) != VMASS_PAGE_THIN || page->base == NULL)
+			continue;
+
+		if(vmassPageIsZero(data + (page->offset - off), page->size))
+			vmassPageRelease(page);
+	}
+
+	return 0;
+}
+
+/*
+ * Drop the data of a thin page, hot or cold, so it reads as zeros again. The caller holds the queue blocked.
+ */
+int vmassPageDiscard(int page_idx){
+
+	VmassPageInfo *page = &vmass_page_list[page_idx];
+
+	if((page->flags & (VMASS_PAGE_THIN | VMASS_PAGE_BORROWED)) != VMASS_PAGE_THIN)
+		return -1;
+
+	vmassTierDrop(page);
+	vmassPageRelease(page);
+
+	return 0;
+}
+
+/*
+ * Back the unbacked thin pages of [off, off + size) with buf, which must be zeroed and live until vmassPageReturn.
+ * Lets calibration copy through real memory without allocating storage. The caller must hold the queue blocked.
+ */
+int vmassPageBorrow(SceSize off, void *buf, SceSize size){
+
+	int page_idx;
+	VmassPageInfo *page;
+
+	page_idx = vmassPageLookup(off);
+	if(page_idx < 0)
+		return -1;
+
+	for(;page_idx < vmass_page_num;page_idx++){
+		page = &vmass_page_list[page_idx];
+		if(page->offset >= (off + size))
+			break;
+
+		if(page->base == NULL && (page->flags & VMASS_PAGE_THIN) != 0){
+			page->base   = buf + (page->offset - off);
+			page->flags |= VMASS_PAGE_BORROWED;
+		}
+	}
+
+	return 0;
+}
+
+int vmassPageReturn(SceSize off, SceSize size){
+
+	int page_idx;
+	VmassPageInfo *page;
+
+	page_idx = vmassPageLookup(off);
+	if(page_idx < 0)
+		return -1;
+
+	for(;page_idx < vmass_page_num;page_idx++){
+		page = &vmass_page_list[page_idx];
+		if(page->offset >= (off + size))
+			break;
+
+		if((page->flags & VMASS_PAGE_BORROWED) != 0){
+			page->base   = NULL;
+			page->flags &= ~VMASS_PAGE_BORROWED;
+		}
+	}
+
+	return 0;
+}
+
+int vmassFreeStoragePage(void){
+
+	while(vmass_page_num != 0){
+		vmass_page_num--;
+		vmassTierDrop(&vmass_page_list[vmass_page_num]);
+
+		if(vmass_page_list[vmass_page_num].base != NULL)
+			ksceKernelFreeMemBlock(ksceKernelFindMemBlockByAddr(vmass_page_list[vmass_page_num].base, 0));
+
+		if(vmass_page_list[vmass_page_num].reserve != NULL)
+			ksceKernelFreeMemBlock(ksceKernelFindMemBlockByAddr(vmass_page_list[vmass_page_num].reserve, 0));
+	}
+
+	if(vmass_page_list != NULL)
+		ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, vmass_page_list);
+
+	vmass_page_list        = NULL;
+	vmass_page_max         = 0;
+	vmass_page_total_size  = 0;
+	vmass_page_backed_size = 0;
+	vmass_page_shift       = 0;
+
+	return 0;
+}
+
+/*
+ * Take up to size bytes of memtype in blocks as large as the partition still gives, returns the bytes taken.
+ * With thin provisioning every block is one thin page and stays reserved for it, so the storage never holds
+ * more than the memory it keeps.
+ */
+static SceSize vmassPageAllocMemtype(SceUInt32 memtype, SceSize size){
+
+	int res = 0;
+	void *base;
+	SceSize done = 0, chunk = VMASS_PAGE_ALLOC_MAX;
+	SceUID memid;
+
+	if(vmass_thin_provision != 0)
+		chunk = VMASS_THIN_CHUNK_SIZE;
+
+	while(res >= 0 && done < size){
+		while(chunk > (size - done))
+			chunk >>= 1;
+
+		if(chunk < VMASS_THIN_CHUNK_SIZE)
+			break;
+
+		memid = ksceKernelAllocMemBlock("VmassStoragePage", memtype, chunk, NULL);
+		if(memid < 0){
+			chunk >>= 1;
+			continue;
+		}
+
+		ksceKernelGetMemBlockBase(memid, &base);
+
+		if(vmass_thin_provision != 0){
+			res = vmassPageAdd(NULL, chunk, memtype, VMASS_PAGE_THIN);
+			if(res < 0){
+				ksceKernelFreeMemBlock(memid);
+				break;
+			}
+
+			vmass_page_list[vmass_page_num - 1].reserve = base;
+		}else{
+			ksceDmacMemset(base, 0, chunk);
+
+			res = vmassPageRegister(base, chunk, memtype);
+			if(res < 0){
+				ksceKernelFreeMemBlock(memid);
+				break;
+			}
+		}
+
+		done += chunk;
+	}
+
+	return done;
+}
+
+int vmassPageAlloc(const VmassStorageMemtype *list, SceSize num, SceSize capacity){
+
+	SceSize i, size, total = 0;
+
+	capacity &= ~(VMASS_THIN_CHUNK_SIZE - 1);
+
+	for(i=0;i<num && total<capacity;i++){
+		size = capacity - total;
+		if(list[i].max_size != 0 && size > list[i].max_size)
+			size = list[i].max_size & ~(VMASS_THIN_CHUNK_SIZE - 1);
+
+		total += vmassPageAllocMemtype(list[i].memtype, size);
+	}
+
+	if(total == 0){
+		vmassFreeStoragePage();
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Storage Page Header
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VMASS_PAGE_H_
+#define _VMASS_PAGE_H_
+
+#include <psp2kern/types.h>
+#include "vmass.h"
+
+/*
+ * Thin pages own a memblock reserved at init. It backs the page on the first non-zero write and goes back to the
+ * reserve when the page is fully zeroed. Their base is NULL while unbacked, and reads of it return zeros.
+ */
+#define VMASS_PAGE_THIN     (1 << 0)
+#define VMASS_PAGE_BORROWED (1 << 1) // temporarily backed by a caller buffer, never allocated or released
+
+#define VMASS_THIN_CHUNK_SIZE (0x10000)
+
+#define VMASS_STORAGE_MEMTYPE_MAX (8)
+
+typedef struct VmassStorageMemtype {
+	SceUInt32 memtype;
+	SceSize max_size; // 0 for no limit
+} VmassStorageMemtype;
+
+typedef struct VmassPageInfo {
+	void   *base;
+	SceSize size;
+	SceSize offset;    // storage byte offset of base
+	SceUInt32 memtype; // memblock type the page was allocated from, 0 if external
+	SceUInt32 flags;
+	void   *reserve;   // memblock kept for an unbacked thin page, NULL once the tier gave it back
+
+	// compressed tier, see vmass_tier.c
+	void   *comp;      // compressed copy while the page is cold, base is NULL then
+	SceSize comp_size;
+	SceUInt32 access;  // set on every access, cleared by the tier scan
+	SceUInt32 idle;    // tier scans since the last access
+} VmassPageInfo;
+
+extern VmassPageInfo *vmass_page_list;
+extern SceSize vmass_page_num;
+extern SceSize vmass_page_backed_size;
+extern int vmass_thin_provision;
+
+/*
+ * Returns the index of the page that backs storage byte offset off, or < 0 if off is out of the storage.
+ */
+int vmassPageLookup(SceSize off);
+
+SceSize vmassPageGetTotalSize(void);
+
+int vmassPageRegister(void *base, SceSize size, SceUInt32 memtype);
+/*
+ * Allocate capacity bytes of storage from the memtypes of list in order, taking at most max_size from each.
+ * Succeeds with less if memory runs out, the storage is then as large as the memory allowed.
+ */
+int vmassPageAlloc(const VmassStorageMemtype *list, SceSize num, SceSize capacity);
+int vmassFreeStoragePage(void);
+
+int vmassPageRead(int page_idx, SceSize off, void *data, SceSize size);
+int vmassPageWrite(int page_idx, SceSize off, const void *data, SceSize size);
+int vmassPageTrim(SceSize off, const void *data, SceSize size);
+int vmassPageIsZero(const void *data, SceSize size);
+int vmassPageDiscard(int page_idx);
+void vmassPageKeep(VmassPageInfo *page, void *block);
+
+int vmassPageBorrow(SceSize off, void *buf, SceSize size);
+int vmassPageReturn(SceSize off, SceSize size);
+
+SceSize vmassPageGetBackedSize(void);
+
+#endif	/* _VMASS_PAGE_H_ */
@@ -0,0 +1,639 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Request Queue
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/threadmgr.h>
+#include <psp2kern/kernel/sysclib.h>
+#include <psp2kern/kernel/cpu.h>
+#include "vmass.h"
+#include "vmass_page.h"
+#include "vmass_trace.h"
+#include "vmass_internal.h"
+
+#define VMASS_RW_THREAD_PRIORITY_DEF (0x6E)
+#define VMASS_RW_THREAD_PRIORITY_WRK (0x28)
+#define VMASS_RW_THREAD_STACK_SIZE   (0x1000)
+
+/*
+ * One RW worker is pinned to each core of vmass_rw_cpu_mask. Worker n owns the bits (VMASS_WORKER_* << (n * 4))
+ * and the exit completion bit (VMASS_REQ_DONE << n) of evf_id.
+ */
+#define VMASS_WORKER_MAX (4)
+
+#define VMASS_WORKER_QUEUE (1 << 0)
+#define VMASS_WORKER_EXIT  (1 << 1)
+#define VMASS_WORKER_MASK  (VMASS_WORKER_QUEUE | VMASS_WORKER_EXIT)
+
+#define VMASS_WORKER_BIT(worker, req) ((req) << ((worker) * 4))
+#define VMASS_DONE_BIT(worker)        (VMASS_REQ_DONE << (worker))
+
+/*
+ * vmassQueueBlock() closes the gate and waits for the in-flight requests to drain.
+ * Enter and Leave change vmass_queue_inflight then read vmass_queue_blocked, Block stores vmass_queue_blocked then
+ * reads vmass_queue_inflight. Both sides are seq_cst so that at least one of them sees the other's store.
+ */
+#define VMASS_GATE_OPEN    (1 << 28)
+#define VMASS_GATE_DRAINED (1 << 29)
+
+/*
+ * Chunks handed to workers are a multiple of 4KiB so two cores never share a cache line or page.
+ */
+#define VMASS_CHUNK_SECTOR_ALIGN (8)
+
+/*
+ * Bounded MPMC ring of request chunks. Every cell carries a sequence number so that producers and
+ * consumers only need a CAS on their own position.
+ */
+#define VMASS_QUEUE_SIZE (0x40)
+#define VMASS_QUEUE_MASK (VMASS_QUEUE_SIZE - 1)
+
+/*
+ * Each in-flight request owns a tag (0-31), which is its completion bit in queue_evf_id.
+ */
+
+typedef struct VmassQueueCell {
+	SceSize seq;
+	VmassRequest *req;
+	SceSize sector_pos;
+	SceSize sector_num;
+	void *data;
+} VmassQueueCell;
+
+typedef struct VmassWorker {
+	SceUID thid;
+	int cpu;
+} VmassWorker;
+
+VmassWorker vmass_worker[VMASS_WORKER_MAX];
+int vmass_worker_num;
+
+int vmass_rw_priority       = VMASS_RW_THREAD_PRIORITY_DEF;
+int vmass_rw_work_priority  = VMASS_RW_THREAD_PRIORITY_WRK;
+SceSize vmass_rw_stack_size = VMASS_RW_THREAD_STACK_SIZE;
+SceUInt32 vmass_rw_cpu_mask = (1 << VMASS_WORKER_MAX) - 1;
+SceUID evf_id, queue_evf_id;
+
+VmassQueueCell vmass_queue[VMASS_QUEUE_SIZE];
+SceSize vmass_queue_enqueue_pos;
+SceSize vmass_queue_dequeue_pos;
+SceUInt32 vmass_queue_tag_used;
+
+int vmass_queue_blocked;
+SceSize vmass_queue_inflight;
+
+int vmassQueuePush(VmassRequest *req, SceSize sector_pos, void *data, SceSize sector_num){
+
+	SceSize pos, seq;
+	VmassQueueCell *cell;
+
+	pos = __atomic_load_n(&vmass_queue_enqueue_pos, __ATOMIC_RELAXED);
+
+	while(1){
+		cell = &vmass_queue[pos & VMASS_QUEUE_MASK];
+		seq  = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+
+		if((int)(seq - pos) == 0){
+			if(__atomic_compare_exchange_n(&vmass_queue_enqueue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}else if((int)(seq - pos) < 0){
+			return -1;
+		}else{
+			pos = __atomic_load_n(&vmass_queue_enqueue_pos, __ATOMIC_RELAXED);
+		}
+	}
+
+	cell->req        = req;
+	cell->sector_pos = sector_pos;
+	cell->sector_num = sector_num;
+	cell->data       = data;
+
+	__atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+int vmassQueuePop(VmassQueueCell *out){
+
+	SceSize pos, seq;
+	VmassQueueCell *cell;
+
+	pos = __atomic_load_n(&vmass_queue_dequeue_pos, __ATOMIC_RELAXED);
+
+	while(1){
+		cell = &vmass_queue[pos & VMASS_QUEUE_MASK];
+		seq  = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+
+		if((int)(seq - (pos + 1)) == 0){
+			if(__atomic_compare_exchange_n(&vmass_queue_dequeue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}else if((int)(seq - (pos + 1)) < 0){
+			return -1;
+		}else{
+			pos = __atomic_load_n(&vmass_queue_dequeue_pos, __ATOMIC_RELAXED);
+		}
+	}
+
+	*out = *cell;
+
+	__atomic_store_n(&cell->seq, pos + VMASS_QUEUE_SIZE, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+int vmassQueueGetTag(void){
+
+	int tag;
+	SceUInt32 used;
+
+	used = __atomic_load_n(&vmass_queue_tag_used, __ATOMIC_RELAXED);
+
+	do {
+		if(used == 0xFFFFFFFF)
+			return -1;
+
+		tag = __builtin_ctz(~used);
+	} while(!__atomic_compare_exchange_n(&vmass_queue_tag_used, &used, used | (1 << tag), 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+
+	return tag;
+}
+
+void vmassQueuePutTag(int tag){
+	__atomic_and_fetch(&vmass_queue_tag_used, ~(1 << tag), __ATOMIC_RELEASE);
+}
+
+int vmassQueueEnter(void){
+
+	while(1){
+		if(__atomic_load_n(&vmass_queue_blocked, __ATOMIC_ACQUIRE) != 0){
+			ksceKernelWaitEventFlag(evf_id, VMASS_GATE_OPEN, SCE_EVENT_WAITOR, NULL, NULL);
+			continue;
+		}
+
+		__atomic_add_fetch(&vmass_queue_inflight, 1, __ATOMIC_SEQ_CST);
+
+		if(__atomic_load_n(&vmass_queue_blocked, __ATOMIC_SEQ_CST) == 0)
+			break;
+
+		vmassQueueLeave();
+	}
+
+	return 0;
+}
+
+void vmassQueueLeave(void){
+	if(__atomic_sub_fetch(&vmass_queue_inflight, 1, __ATOMIC_SEQ_CST) == 0 && __atomic_load_n(&vmass_queue_blocked, __ATOMIC_SEQ_CST) != 0)
+		ksceKernelSetEventFlag(evf_id, VMASS_GATE_DRAINED);
+}
+
+/*
+ * Wait for every in-flight request to finish and hold new ones at vmassQueueEnter until vmassQueueUnblock.
+ * Callers serialise on lw_mtx.
+ */
+int vmassQueueBlock(void){
+
+	ksceKernelLockFastMutex(&lw_mtx);
+
+	ksceKernelPollEventFlag(evf_id, VMASS_GATE_OPEN | VMASS_GATE_DRAINED, SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, NULL);
+	__atomic_store_n(&vmass_queue_blocked, 1, __ATOMIC_SEQ_CST);
+
+	if(__atomic_load_n(&vmass_queue_inflight, __ATOMIC_SEQ_CST) != 0)
+		ksceKernelWaitEventFlag(evf_id, VMASS_GATE_DRAINED, SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, NULL, NULL);
+
+	return 0;
+}
+
+int vmassQueueUnblock(void){
+
+	__atomic_store_n(&vmass_queue_blocked, 0, __ATOMIC_RELEASE);
+	ksceKernelSetEventFlag(evf_id, VMASS_GATE_OPEN);
+
+	ksceKernelUnlockFastMutex(&lw_mtx);
+
+	return 0;
+}
+
+void vmassQueueComplete(VmassRequest *req, int res){
+
+	SceUInt32 time;
+
+	if(res < 0)
+		__atomic_store_n(&req->res, res, __ATOMIC_RELAXED);
+
+	if(__atomic_sub_fetch(&req->remaining, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+
+	if(req->internal == 0){
+		if(req->opcode == VMASS_REQ_WRITE)
+			vmassReclaimNoteWrite();
+
+		if(req->opcode == VMASS_REQ_WRITE && req->res >= 0){
+			vmassPageTrim(req->sector_pos << 9, req->data, req->sector_num << 9);
+			vmassImageMarkDirty(req->sector_pos, req->sector_num);
+			vmassJournalAppend(req->sector_pos, req->data, req->sector_num);
+		}
+
+		vmassRangeUnlock(req->opcode, req->sector_pos, req->sector_num);
+
+		time = ksceKernelGetSystemTimeLow() - req->time_s;
+
+		vmassTraceRecord(req->opcode, req->sector_pos, req->sector_num, req->time_s, time,
+			VMASS_TRACE_FLAG_ASYNC | ((req->res < 0) ? VMASS_TRACE_FLAG_ERROR : 0));
+
+		vmassQueueLeave();
+
+		if(req->res >= 0)
+			vmassStatRequest(req->opcode, req->sector_num, time);
+	}
+
+	if(req->cb != NULL)
+		req->cb(req, req->argp);
+
+	ksceKernelSetEventFlag(queue_evf_id, 1 << req->tag);
+}
+
+int vmassQueueExec(unsigned int opcode, SceSize sector_pos, void *data, SceSize sector_num){
+
+	if(opcode == VMASS_REQ_READ)
+		return _vmassReadSector(sector_pos, data, sector_num);
+
+	return _vmassWriteSector(sector_pos, data, sector_num);
+}
+
+/*
+ * Run one queued chunk. Returns < 0 when the queue is empty.
+ */
+int vmassQueueRunOne(void){
+
+	VmassQueueCell cell;
+
+	if(vmassQueuePop(&cell) < 0)
+		return -1;
+
+	vmassQueueComplete(cell.req, vmassQueueExec(cell.req->opcode, cell.sector_pos, cell.data, cell.sector_num));
+
+	return 0;
+}
+
+int sceVmassRWThread(SceSize args, void *argp){
+
+	int res, worker_idx = *(int *)argp;
+	unsigned int bits;
+
+	while(1){
+		ksceKernelChangeThreadPriority(0, vmass_rw_priority);
+
+		bits = 0;
+		res = ksceKernelWaitEventFlag(evf_id, VMASS_WORKER_BIT(worker_idx, VMASS_WORKER_MASK), SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, &bits, NULL);
+		if(res < 0)
+			continue;
+
+		bits = (bits >> (worker_idx * 4)) & VMASS_WORKER_MASK;
+
+		if((bits & VMASS_WORKER_EXIT) != 0){
+			ksceKernelSetEventFlag(evf_id, VMASS_DONE_BIT(worker_idx));
+			break;
+		}
+
+		ksceKernelChangeThreadPriority(0, vmass_rw_work_priority);
+
+		while(vmassQueueRunOne() == 0);
+	}
+
+	return 0;
+}
+
+/*
+ * Index of the worker pinned to the current core, or -1 without one.
+ */
+static int vmassQueueSelf(void){
+
+	int cpu, i;
+
+	cpu = ksceKernelCpuGetCpuId();
+
+	for(i=0;i<vmass_worker_num;i++){
+		if(vmass_worker[i].cpu == cpu)
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * Queue the request as chunks of at least split_sector sectors and wake a worker per chunk. While another worker
+ * is left, the worker pinned to the current core is skipped and the request gets one chunk less than there are
+ * workers. Chunks that do not fit in the ring are run inline. The caller assigns req->tag.
+ */
+int vmassQueueSubmit(VmassRequest *req, unsigned int opcode, SceSize sector_pos, void *data, SceSize sector_num, SceSize split_sector){
+
+	int ways, ways_max, self, i;
+	unsigned int wake_bits = 0;
+	SceSize chunk, chunk_pos, chunk_num, inline_num = 0;
+
+	self = vmassQueueSelf();
+
+	ways_max = vmass_worker_num;
+	if(self >= 0 && ways_max > 1)
+		ways_max--;
+
+	// without a worker on this core, chunks start at worker 0
+	if(self < 0)
+		self = vmass_worker_num - 1;
+
+	ways = (split_sector != 0) ? (sector_num / split_sector) : ways_max;
+	if(ways > ways_max)
+		ways = ways_max;
+	if(ways < 1)
+		ways = 1;
+
+	chunk = (sector_num / ways) & ~(VMASS_CHUNK_SECTOR_ALIGN - 1);
+	if(chunk == 0){
+		chunk = sector_num;
+		ways  = 1;
+	}
+
+	req->opcode     = opcode;
+	req->sector_pos = sector_pos;
+	req->sector_num = sector_num;
+	req->data       = data;
+	req->res        = 0;
+	req->remaining  = ways;
+
+	for(i=0;i<ways;i++){
+		chunk_pos = chunk * i;
+		chunk_num = (i == (ways - 1)) ? (sector_num - chunk_pos) : chunk;
+
+		if(vmass_worker_num == 0 || vmassQueuePush(req, sector_pos + chunk_pos, data + (chunk_pos << 9), chunk_num) < 0){
+			vmassQueueComplete(req, vmassQueueExec(opcode, sector_pos + chunk_pos, data + (chunk_pos << 9), chunk_num));
+			inline_num++;
+			continue;
+		}
+
+		wake_bits |= VMASS_WORKER_BIT((self + 1 + i) % vmass_worker_num, VMASS_WORKER_QUEUE);
+	}
+
+	vmassStatChunk(ways - inline_num, inline_num);
+
+	if(wake_bits != 0)
+		ksceKernelSetEventFlag(evf_id, wake_bits);
+
+	return 0;
+}
+
+/*
+ * Hand the tag of a completed request back. The request has none afterwards, so it can not be reaped twice.
+ */
+static void vmassQueueReap(VmassRequest *req){
+
+	int tag = req->tag;
+
+	req->tag = -1;
+	vmassQueuePutTag(tag);
+}
+
+int vmassQueueWait(VmassRequest *req, SceUInt *timeout){
+
+	int res;
+
+	res = ksceKernelWaitEventFlag(queue_evf_id, 1 << req->tag, SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, NULL, timeout);
+	if(res < 0)
+		return res;
+
+	vmassQueueReap(req);
+
+	return req->res;
+}
+
+/*
+ * Synchronous split copy. The caller drains the queue alongside the workers until its own request is done.
+ */
+int vmassSplitSector(unsigned int opcode, SceSize sector_pos, void *data, SceSize sector_num, SceSize split_sector){
+
+	VmassRequest req;
+
+	if(split_sector == VMASS_SPLIT_NEVER || (split_sector != 0 && (sector_num / split_sector) < 2) || vmass_worker_num == 0){
+		vmassStatChunk(0, 1);
+		return vmassQueueExec(opcode, sector_pos, data, sector_num);
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.internal = 1;
+
+	req.tag = vmassQueueGetTag();
+	if(req.tag < 0){
+		vmassStatChunk(0, 1);
+		return vmassQueueExec(opcode, sector_pos, data, sector_num);
+	}
+
+	vmassQueueSubmit(&req, opcode, sector_pos, data, sector_num, split_sector);
+
+	while(__atomic_load_n(&req.remaining, __ATOMIC_ACQUIRE) != 0 && vmassQueueRunOne() == 0);
+
+	return vmassQueueWait(&req, NULL);
+}
+
+int vmassSubmitSector(VmassRequest *req, unsigned int opcode, SceSize sector_pos, void *data, SceSize sector_num, SceSize split_sector){
+
+	int res;
+
+	if(req == NULL)
+		return -1;
+
+	// a failed submit leaves nothing to reap
+	req->tag = -1;
+
+	res = vmassCheckSector(sector_pos, sector_num);
+	if(res < 0)
+		return res;
+
+	req->tag = vmassQueueGetTag();
+	if(req->tag < 0)
+		return -1;
+
+	req->time_s = ksceKernelGetSystemTimeLow();
+
+	vmassQueueEnter();
+
+	res = vmassImageFault(sector_pos, sector_num);
+	if(res < 0){
+		vmassQueueLeave();
+		vmassQueuePutTag(req->tag);
+		req->tag = -1;
+		return res;
+	}
+
+	if(opcode == VMASS_REQ_WRITE)
+		vmassSnapshotFault(sector_pos, sector_num);
+
+	vmassRangeLock(req->tag, opcode, sector_pos, sector_num);
+
+	req->internal = 0;
+
+	return vmassQueueSubmit(req, opcode, sector_pos, data, sector_num, split_sector);
+}
+
+int vmassSubmitReadSector(VmassRequest *req, SceSize sector_pos, void *data, SceSize sector_num){
+	return vmassSubmitSector(req, VMASS_REQ_READ, sector_pos, data, sector_num, vmassGetReadSplitSector(sector_pos));
+}
+
+int vmassSubmitWriteSector(VmassRequest *req, SceSize sector_pos, const void *data, SceSize sector_num){
+	return vmassSubmitSector(req, VMASS_REQ_WRITE, sector_pos, (void *)data, sector_num, vmassGetWriteSplitSector(sector_pos));
+}
+
+int vmassWaitRequest(VmassRequest *req, SceUInt *timeout){
+
+	if(req == NULL || req->tag < 0)
+		return -1;
+
+	return vmassQueueWait(req, timeout);
+}
+
+int vmassPollRequest(VmassRequest *req){
+
+	if(req == NULL || req->tag < 0)
+		return -1;
+
+	if(ksceKernelPollEventFlag(queue_evf_id, 1 << req->tag, SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, NULL) < 0)
+		return VMASS_REQUEST_PENDING;
+
+	vmassQueueReap(req);
+
+	return req->res;
+}
+
+int vmassStopWorker(void){
+
+	int i;
+	unsigned int done_bits = 0;
+
+	if(vmass_worker_num == 0)
+		return 0;
+
+	for(i=0;i<vmass_worker_num;i++){
+		done_bits |= VMASS_DONE_BIT(i);
+		ksceKernelSetEventFlag(evf_id, VMASS_WORKER_BIT(i, VMASS_WORKER_EXIT));
+	}
+
+	ksceKernelWaitEventFlag(evf_id, done_bits, SCE_EVENT_WAITAND | SCE_EVENT_WAITCLEAR_PAT, NULL, NULL);
+
+	for(i=0;i<vmass_worker_num;i++){
+		ksceKernelWaitThreadEnd(vmass_worker[i].thid, NULL, NULL);
+		ksceKernelDeleteThread(vmass_worker[i].thid);
+	}
+
+	vmass_worker_num = 0;
+
+	return 0;
+}
+
+int vmassStartWorker(void){
+
+	int res, cpu, i;
+	SceUID thid;
+
+	for(cpu=0;cpu<VMASS_WORKER_MAX;cpu++){
+		if((vmass_rw_cpu_mask & (1 << cpu)) == 0)
+			continue;
+
+		i = vmass_worker_num;
+
+		thid = ksceKernelCreateThread("SceVmassRWThread", sceVmassRWThread, vmass_rw_priority, vmass_rw_stack_size, 0, 1 << cpu, NULL);
+		if(thid < 0){
+			res = thid;
+			goto stop_worker;
+		}
+
+		res = ksceKernelStartThread(thid, sizeof(i), &i);
+		if(res < 0){
+			ksceKernelDeleteThread(thid);
+			goto stop_worker;
+		}
+
+		vmass_worker[i].thid = thid;
+		vmass_worker[i].cpu  = cpu;
+		vmass_worker_num++;
+	}
+
+	return 0;
+
+stop_worker:
+	vmassStopWorker();
+
+	return res;
+}
+
+/*
+ * Set the RW worker parameters before vmassQueueInit, 0 keeps a value.
+ */
+int vmassQueueSetWorker(int priority, int work_priority, SceSize stack_size, SceUInt32 cpu_mask){
+
+	if(vmass_worker_num != 0)
+		return -1;
+
+	if(priority != 0)
+		vmass_rw_priority = priority;
+
+	if(work_priority != 0)
+		vmass_rw_work_priority = work_priority;
+
+	if(stack_size != 0)
+		vmass_rw_stack_size = stack_size;
+
+	if((cpu_mask & ((1 << VMASS_WORKER_MAX) - 1)) != 0)
+		vmass_rw_cpu_mask = cpu_mask & ((1 << VMASS_WORKER_MAX) - 1);
+
+	return 0;
+}
+
+int vmassQueueInit(void){
+
+	int res, i;
+
+	for(i=0;i<VMASS_QUEUE_SIZE;i++)
+		vmass_queue[i].seq = i;
+
+	evf_id = ksceKernelCreateEventFlag("VmassEvf", SCE_EVENT_WAITMULTIPLE, VMASS_GATE_OPEN, NULL);
+	if(evf_id < 0)
+		return evf_id;
+
+	queue_evf_id = ksceKernelCreateEventFlag("VmassQueueEvf", SCE_EVENT_WAITMULTIPLE, 0, NULL);
+	if(queue_evf_id < 0){
+		res = queue_evf_id;
+		goto del_evf;
+	}
+
+	res = vmassStartWorker();
+	if(res < 0)
+		goto del_queue_evf;
+
+	return 0;
+
+del_queue_evf:
+	ksceKernelDeleteEventFlag(queue_evf_id);
+
+del_evf:
+	ksceKernelDeleteEventFlag(evf_id);
+
+	return res;
+}
+
+int vmassQueueFini(void){
+
+	vmassStopWorker();
+
+	ksceKernelDeleteEventFlag(queue_evf_id);
+	ksceKernelDeleteEventFlag(evf_id);
+
+	return 0;
+}
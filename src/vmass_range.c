@@ -0,0 +1,238 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Sector Range Lock
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/threadmgr.h>
+#include <psp2kern/kernel/sysmem.h>
+#include <psp2kern/kernel/sysclib.h>
+#include "vmass_internal.h"
+
+/*
+ * The storage is split into 64KiB stripes, each a reader-writer lock (> 0 readers, -1 writer).
+ * A request locks every stripe it touches at once, so a FAT sector update only waits for copies that share its stripe.
+ *
+ * Locks belong to the request, not the thread: async requests are locked at submit and unlocked by the worker that
+ * completes them. A blocked request queues on its tag and is handed the range by the unlocker in arrival order,
+ * so overlapping requests run in the order they were issued.
+ */
+#define VMASS_STRIPE_SHIFT (7)
+
+#define VMASS_RANGE_WAITER_MAX (32)
+
+typedef struct VmassRangeWaiter {
+	int next;
+	int write;
+	SceSize first;
+	SceSize last;
+} VmassRangeWaiter;
+
+SceKernelLwMutexWork range_mtx;
+SceInt32 *vmass_stripe_list;
+SceSize vmass_stripe_num;
+
+VmassRangeWaiter vmass_range_waiter[VMASS_RANGE_WAITER_MAX];
+int vmass_range_head = -1, vmass_range_tail = -1;
+
+static int vmassRangeOverlap(SceSize first_a, SceSize last_a, SceSize first_b, SceSize last_b){
+	return (first_a <= last_b) && (first_b <= last_a);
+}
+
+static int vmassRangeIsFree(SceSize first, SceSize last, int write){
+
+	SceSize i;
+
+	for(i=first;i<=last;i++){
+		if(vmass_stripe_list[i] < 0 || (write != 0 && vmass_stripe_list[i] != 0))
+			return 0;
+	}
+
+	return 1;
+}
+
+static void vmassRangeTake(SceSize first, SceSize last, int write){
+
+	SceSize i;
+
+	for(i=first;i<=last;i++){
+		if(write != 0)
+			vmass_stripe_list[i] = -1;
+		else
+			vmass_stripe_list[i]++;
+	}
+}
+
+/*
+ * Whether a queued waiter ahead of stop (-1 for the whole queue) conflicts with the range.
+ */
+static int vmassRangeIsQueued(SceSize first, SceSize last, int write, int stop){
+
+	int i;
+	VmassRangeWaiter *waiter;
+
+	for(i=vmass_range_head;i >= 0 && i != stop;i=waiter->next){
+		waiter = &vmass_range_waiter[i];
+
+		if((write != 0 || waiter->write != 0) && vmassRangeOverlap(first, last, waiter->first, waiter->last))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Lock the range for the request owning tag. Pass tag < 0 for synchronous requests, which borrow a tag only when they have to wait.
+ */
+int vmassRangeLock(int tag, unsigned int opcode, SceSize sector_pos, SceSize sector_num){
+
+	int own_tag = 0, write = (opcode == VMASS_REQ_WRITE);
+	SceUInt32 time_s = 0;
+	SceSize first, last;
+	VmassRangeWaiter *waiter;
+
+	first = sector_pos >> VMASS_STRIPE_SHIFT;
+	last  = (sector_pos + sector_num - 1) >> VMASS_STRIPE_SHIFT;
+
+	while(1){
+		ksceKernelLockFastMutex(&range_mtx);
+
+		if(vmassRangeIsFree(first, last, write) != 0 && vmassRangeIsQueued(first, last, write, -1) == 0){
+			vmassRangeTake(first, last, write);
+			ksceKernelUnlockFastMutex(&range_mtx);
+			break;
+		}
+
+		// only a contended lock reads the clock
+		if(time_s == 0)
+			time_s = ksceKernelGetSystemTimeLow() | 1;
+
+		if(tag < 0){
+			tag = vmassQueueGetTag();
+			if(tag < 0){
+				ksceKernelUnlockFastMutex(&range_mtx);
+				ksceKernelDelayThread(100);
+				continue;
+			}
+
+			own_tag = 1;
+		}
+
+		waiter = &vmass_range_waiter[tag];
+		waiter->next  = -1;
+		waiter->write = write;
+		waiter->first = first;
+		waiter->last  = last;
+
+		if(vmass_range_tail < 0)
+			vmass_range_head = tag;
+		else
+			vmass_range_waiter[vmass_range_tail].next = tag;
+
+		vmass_range_tail = tag;
+
+		ksceKernelUnlockFastMutex(&range_mtx);
+
+		ksceKernelWaitEventFlag(queue_evf_id, 1 << tag, SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, NULL, NULL);
+
+		if(own_tag != 0)
+			vmassQueuePutTag(tag);
+
+		vmassStatLockWait(ksceKernelGetSystemTimeLow() - time_s);
+
+		break;
+	}
+
+	return 0;
+}
+
+void vmassRangeUnlock(unsigned int opcode, SceSize sector_pos, SceSize sector_num){
+
+	int i, prev, next;
+	SceSize first, last, n;
+	VmassRangeWaiter *waiter;
+
+	first = sector_pos >> VMASS_STRIPE_SHIFT;
+	last  = (sector_pos + sector_num - 1) >> VMASS_STRIPE_SHIFT;
+
+	ksceKernelLockFastMutex(&range_mtx);
+
+	for(n=first;n<=last;n++){
+		if(opcode == VMASS_REQ_WRITE)
+			vmass_stripe_list[n] = 0;
+		else
+			vmass_stripe_list[n]--;
+	}
+
+	prev = -1;
+
+	for(i=vmass_range_head;i >= 0;i=next){
+		waiter = &vmass_range_waiter[i];
+		next   = waiter->next;
+
+		if(vmassRangeIsFree(waiter->first, waiter->last, waiter->write) == 0
+			|| vmassRangeIsQueued(waiter->first, waiter->last, waiter->write, i) != 0){
+			prev = i;
+			continue;
+		}
+
+		vmassRangeTake(waiter->first, waiter->last, waiter->write);
+
+		if(prev < 0)
+			vmass_range_head = next;
+		else
+			vmass_range_waiter[prev].next = next;
+
+		if(vmass_range_tail == i)
+			vmass_range_tail = prev;
+
+		ksceKernelSetEventFlag(queue_evf_id, 1 << i);
+	}
+
+	ksceKernelUnlockFastMutex(&range_mtx);
+}
+
+int vmassRangeInit(SceSize size){
+
+	int res;
+
+	vmass_stripe_num = ((size >> 9) + (1 << VMASS_STRIPE_SHIFT) - 1) >> VMASS_STRIPE_SHIFT;
+
+	vmass_stripe_list = ksceKernelAllocHeapMemory(VMASS_KERNEL_HEAP, vmass_stripe_num * sizeof(SceInt32));
+	if(vmass_stripe_list == NULL)
+		return -1;
+
+	memset(vmass_stripe_list, 0, vmass_stripe_num * sizeof(SceInt32));
+
+	res = ksceKernelInitializeFastMutex(&range_mtx, "VmassRangeMutex", 0, 0);
+	if(res < 0){
+		ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, vmass_stripe_list);
+		vmass_stripe_list = NULL;
+		return res;
+	}
+
+	vmass_range_head = -1;
+	vmass_range_tail = -1;
+
+	return 0;
+}
+
+int vmassRangeFini(void){
+
+	ksceKernelDeleteFastMutex(&range_mtx);
+
+	ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, vmass_stripe_list);
+	vmass_stripe_list = NULL;
+	vmass_stripe_num  = 0;
+
+	return 0;
+}
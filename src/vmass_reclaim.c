@@ -0,0 +1,383 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Free Space Reclaim
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/threadmgr.h>
+#include <psp2kern/kernel/sysmem.h>
+#include <psp2kern/kernel/sysclib.h>
+#include <psp2kern/kernel/iofilemgr.h>
+#include "vmass.h"
+#include "vmass_page.h"
+#include "vmass_internal.h"
+#include "fat.h"
+
+/*
+ * A reclaim reads the FAT of the volume and discards the thin pages whose sectors all lie in free clusters.
+ * The queue is blocked meanwhile, so the FAT can not change between the scan and the discard.
+ * A discarded page reads as zeros and is backed again on its next non-zero write.
+ *
+ * The FAT on the storage is only trusted once it is flushed. A file system that still caches newer FAT sectors
+ * would lose the data of the clusters it allocated since, so vmassReclaim must only be called after ksceIoSync("uma0:")
+ * and while no USB host has the volume mounted. The background reclaim of VMASS_RECLAIM_AUTO only runs while uma0:
+ * is mounted here: it syncs uma0: twice and gives up if any write reached the storage after the second sync began.
+ */
+#define VMASS_RECLAIM_THREAD_PRIORITY (0xA0)
+
+#define VMASS_RECLAIM_RUN  (1 << 0)
+#define VMASS_RECLAIM_EXIT (1 << 1)
+
+// FAT window followed by the scratch page of vmassImageCopyOut
+#define VMASS_RECLAIM_WINDOW_SIZE (VMASS_THIN_CHUNK_SIZE)
+#define VMASS_RECLAIM_BUFFER_SIZE (VMASS_RECLAIM_WINDOW_SIZE + VMASS_THIN_CHUNK_SIZE)
+
+typedef struct VmassFatLayout {
+	int type;              // 12, 16 or 32
+	SceSize fat_pos;       // first sector of the first FAT
+	SceSize fat_size;      // bytes of one FAT
+	SceSize data_pos;      // sector of cluster 2
+	SceSize cluster_shift; // sectors per cluster as a shift
+	SceSize cluster_num;
+} VmassFatLayout;
+
+typedef struct VmassFatWindow {
+	void *buf;
+	void *scratch;
+	SceSize off;  // FAT byte offset of buf
+	SceSize size; // bytes loaded, 0 if none
+} VmassFatWindow;
+
+int vmass_reclaim_mode = VMASS_RECLAIM_MANUAL;
+
+SceUInt32 reclaim_write_seq; // bumped by every write request
+
+SceUID reclaim_evf_id = -1, reclaim_thid = -1;
+
+SceKernelLwMutexWork reclaim_mtx;
+
+static int vmassReclaimLayout(const FatHeader *header, VmassFatLayout *layout){
+
+	const FAT_Base *base = &header->fat_base;
+	SceSize all_sector, fat_sector, root_sector, spc;
+
+	if(base->bootcode[0] != (char)0xEB || base->sector_size != 0x200 || base->media != 0xF8 || base->num_fats == 0)
+		return -1;
+
+	spc = base->allocation_sector;
+	if(spc == 0 || (spc & (spc - 1)) != 0)
+		return -1;
+
+	all_sector  = (base->all_sector_num != 0) ? base->all_sector_num : base->all_sector;
+	fat_sector  = (base->fat_size_16 != 0) ? base->fat_size_16 : header->fat32.fat_size;
+	root_sector = ((base->root_entry_sector * 0x20) + 0x1FF) >> 9;
+
+	if(all_sector == 0 || all_sector > (g_vmass_size >> 9) || fat_sector == 0)
+		return -1;
+
+	layout->fat_pos  = base->rsvd_sector;
+	layout->fat_size = fat_sector << 9;
+	layout->data_pos = base->rsvd_sector + (fat_sector * base->num_fats) + root_sector;
+
+	if(layout->data_pos >= all_sector)
+		return -1;
+
+	layout->cluster_shift = __builtin_ctz(spc);
+	layout->cluster_num   = (all_sector - layout->data_pos) >> layout->cluster_shift;
+
+	if(layout->cluster_num < 4085)
+		layout->type = 12;
+	else if(layout->cluster_num < 65525)
+		layout->type = 16;
+	else
+		layout->type = 32;
+
+	// the FAT32 fields only exist when FAT32 is what the cluster count says
+	if((layout->type == 32) != (base->fat_size_16 == 0))
+		return -1;
+
+	if((((layout->cluster_num + 2) * layout->type + 7) >> 3) > layout->fat_size)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Read the FAT entry of cluster, returns < 0 if it can not be read.
+ */
+static int vmassReclaimEntry(const VmassFatLayout *layout, VmassFatWindow *win, SceSize cluster, SceUInt32 *entry){
+
+	int res;
+	SceSize off, size, need;
+	const SceUInt8 *p;
+
+	off  = (cluster * layout->type) >> 3;
+	need = (layout->type == 32) ? 4 : 2; // a FAT12 entry straddles two bytes
+
+	if(win->size == 0 || off < win->off || (off + need) > (win->off + win->size)){
+		win->off = off & ~0x1FF;
+
+		size = layout->fat_size - win->off;
+		if(size > VMASS_RECLAIM_WINDOW_SIZE)
+			size = VMASS_RECLAIM_WINDOW_SIZE;
+
+		res = vmassImageCopyOut((layout->fat_pos << 9) + win->off, win->buf, size, win->scratch);
+		if(res < 0){
+			win->size = 0;
+			return res;
+		}
+
+		win->size = size;
+	}
+
+	p = win->buf + (off - win->off);
+
+	if(layout->type == 12)
+		*entry = ((p[0] | (p[1] << 8)) >> ((cluster & 1) << 2)) & 0xFFF;
+	else if(layout->type == 16)
+		*entry = p[0] | (p[1] << 8);
+	else
+		*entry = (p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24)) & 0x0FFFFFFF;
+
+	return 0;
+}
+
+/*
+ * Returns 1 if every cluster that covers sectors [sector_pos, sector_pos + sector_num) is free.
+ * Sectors past the last cluster belong to no file.
+ */
+static int vmassReclaimIsFree(const VmassFatLayout *layout, VmassFatWindow *win, SceSize sector_pos, SceSize sector_num){
+
+	SceSize cluster, last;
+	SceUInt32 entry;
+
+	if(sector_pos < layout->data_pos)
+		return 0;
+
+	cluster = ((sector_pos - layout->data_pos) >> layout->cluster_shift) + 2;
+	last    = ((sector_pos + sector_num - 1 - layout->data_pos) >> layout->cluster_shift) + 2;
+
+	if(last > (layout->cluster_num + 1))
+		last = layout->cluster_num + 1;
+
+	for(;cluster<=last;cluster++){
+		if(vmassReclaimEntry(layout, win, cluster, &entry) < 0 || entry != 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+void vmassReclaimNoteWrite(void){
+	__atomic_add_fetch(&reclaim_write_seq, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * With write_seq, gives up when a write completed since *write_seq was read.
+ */
+static int vmassReclaimRun(SceSize *reclaimed_size, const SceUInt32 *write_seq){
+
+	int res, i;
+	void *buffer;
+	SceUID memid;
+	SceSize loaded_size, total_size, sector_pos, sector_num, reclaimed = 0;
+	VmassPageInfo *page;
+	VmassFatLayout layout;
+	VmassFatWindow win;
+
+	// a page that is not loaded yet would be filled again by the loader
+	vmassGetLoadProgress(&loaded_size, &total_size);
+	if(loaded_size != total_size)
+		return -1;
+
+	memid = ksceKernelAllocMemBlock("VmassReclaimBuffer", 0x1020D006, VMASS_RECLAIM_BUFFER_SIZE, NULL);
+	if(memid < 0)
+		return memid;
+
+	ksceKernelGetMemBlockBase(memid, &buffer);
+
+	win.buf     = buffer;
+	win.scratch = buffer + VMASS_RECLAIM_WINDOW_SIZE;
+	win.size    = 0;
+
+	ksceKernelLockFastMutex(&reclaim_mtx);
+	vmassQueueBlock();
+
+	res = 0;
+	if(write_seq != NULL && __atomic_load_n(&reclaim_write_seq, __ATOMIC_RELAXED) != *write_seq)
+		res = -1;
+
+	if(res >= 0)
+		res = vmassImageCopyOut(0, buffer, sizeof(FatHeader), win.scratch);
+	if(res >= 0)
+		res = vmassReclaimLayout(buffer, &layout);
+
+	for(i=0;res>=0 && i<vmass_page_num;i++){
+		page = &vmass_page_list[i];
+
+		if((page->flags & (VMASS_PAGE_THIN | VMASS_PAGE_BORROWED)) != VMASS_PAGE_THIN)
+			continue;
+
+		if(page->base == NULL && page->comp == NULL)
+			continue;
+
+		sector_pos = page->offset >> 9;
+		sector_num = page->size >> 9;
+
+		if(vmassReclaimIsFree(&layout, &win, sector_pos, sector_num) == 0)
+			continue;
+
+		// a snapshot still being saved keeps the old data
+		vmassSnapshotFault(sector_pos, sector_num);
+
+		vmassPageDiscard(i);
+		vmassImageMarkDirty(sector_pos, sector_num);
+
+		reclaimed += page->size;
+	}
+
+	vmassQueueUnblock();
+	ksceKernelUnlockFastMutex(&reclaim_mtx);
+
+	ksceKernelFreeMemBlock(memid);
+
+	if(res < 0)
+		return res;
+
+	if(reclaimed_size != NULL)
+		*reclaimed_size = reclaimed;
+
+	return 0;
+}
+
+int vmassReclaim(SceSize *reclaimed_size){
+	return vmassReclaimRun(reclaimed_size, NULL);
+}
+
+/*
+ * The first sync writes back what uma0: cached. If the second one writes nothing either, the FAT on the storage
+ * was current when it returned, and it stays so until the next write.
+ */
+static int vmassReclaimAuto(void){
+
+	int res;
+	SceUInt32 write_seq;
+	SceIoStat stat;
+
+	// a USB host mounts the volume itself, uma0: is unmounted here meanwhile
+	if(ksceIoGetstat("uma0:", &stat) < 0)
+		return -1;
+
+	res = ksceIoSync("uma0:", 0);
+	if(res < 0)
+		return res;
+
+	write_seq = __atomic_load_n(&reclaim_write_seq, __ATOMIC_RELAXED);
+
+	res = ksceIoSync("uma0:", 0);
+	if(res < 0)
+		return res;
+
+	return vmassReclaimRun(NULL, &write_seq);
+}
+
+/*
+ * Called when backing a thin page failed, runs a reclaim on SceVmassReclaimThread.
+ */
+void vmassReclaimKick(void){
+
+	if(__atomic_load_n(&vmass_reclaim_mode, __ATOMIC_RELAXED) == VMASS_RECLAIM_AUTO && reclaim_evf_id >= 0)
+		ksceKernelSetEventFlag(reclaim_evf_id, VMASS_RECLAIM_RUN);
+}
+
+int vmassSetReclaimMode(int mode){
+
+	if(mode != VMASS_RECLAIM_MANUAL && mode != VMASS_RECLAIM_AUTO)
+		return -1;
+
+	__atomic_store_n(&vmass_reclaim_mode, mode, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+static int sceVmassReclaimThread(SceSize args, void *argp){
+
+	unsigned int bits;
+
+	while(1){
+		bits = 0;
+
+		ksceKernelWaitEventFlag(reclaim_evf_id, VMASS_RECLAIM_RUN | VMASS_RECLAIM_EXIT, SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, &bits, NULL);
+
+		if((bits & VMASS_RECLAIM_EXIT) != 0)
+			break;
+
+		vmassReclaimAuto();
+	}
+
+	return 0;
+}
+
+int vmassReclaimInit(void){
+
+	int res;
+
+	res = ksceKernelInitializeFastMutex(&reclaim_mtx, "VmassReclaimMutex", 0, 0);
+	if(res < 0)
+		return res;
+
+	reclaim_evf_id = ksceKernelCreateEventFlag("VmassReclaimEvf", 0, 0, NULL);
+	if(reclaim_evf_id < 0){
+		res = reclaim_evf_id;
+		goto del_mtx;
+	}
+
+	reclaim_thid = ksceKernelCreateThread("SceVmassReclaimThread", sceVmassReclaimThread, VMASS_RECLAIM_THREAD_PRIORITY, 0x1000, 0, 0, NULL);
+	if(reclaim_thid < 0){
+		res = reclaim_thid;
+		goto del_evf;
+	}
+
+	res = ksceKernelStartThread(reclaim_thid, 0, NULL);
+	if(res < 0)
+		goto del_thread;
+
+	return 0;
+
+del_thread:
+	ksceKernelDeleteThread(reclaim_thid);
+	reclaim_thid = -1;
+
+del_evf:
+	ksceKernelDeleteEventFlag(reclaim_evf_id);
+	reclaim_evf_id = -1;
+
+del_mtx:
+	ksceKernelDeleteFastMutex(&reclaim_mtx);
+
+	return res;
+}
+
+int vmassReclaimFini(void){
+
+	ksceKernelSetEventFlag(reclaim_evf_id, VMASS_RECLAIM_EXIT);
+	ksceKernelWaitThreadEnd(reclaim_thid, NULL, NULL);
+	ksceKernelDeleteThread(reclaim_thid);
+	reclaim_thid = -1;
+
+	ksceKernelDeleteEventFlag(reclaim_evf_id);
+	reclaim_evf_id = -1;
+
+	ksceKernelDeleteFastMutex(&reclaim_mtx);
+
+	return 0;
+}
@@ -0,0 +1,291 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Snapshot
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/threadmgr.h>
+#include <psp2kern/kernel/sysmem.h>
+#include <psp2kern/kernel/sysclib.h>
+#include "vmass.h"
+#include "vmass_internal.h"
+
+/*
+ * A snapshot freezes the storage in granules of 64KiB. Until the save has read a frozen granule, the first write
+ * to it copies the granule aside, and the save reads that copy instead of the storage.
+ */
+#define VMASS_SNAPSHOT_SHIFT (7)
+
+#define VMASS_SNAPSHOT_THREAD_PRIORITY   (0xA0)
+#define VMASS_SNAPSHOT_THREAD_STACK_SIZE (0x4000) // runs the whole save, down through the LZ coder and ksceIo*
+
+SceUInt32 *snap_frozen_map; // granules whose frozen data is still the storage
+void **snap_copy;           // frozen data of the granules written since the snapshot
+SceSize snap_num;
+int snap_active;
+int snap_torn; // a frozen granule was written without its copy, the save fails
+
+SceUID snap_thid = -1;
+int snap_saving, snap_res;
+
+static int vmassFrozenTest(SceSize idx){
+	return (__atomic_load_n(&snap_frozen_map[idx >> 5], __ATOMIC_RELAXED) & (1 << (idx & 0x1F))) != 0;
+}
+
+static void vmassFrozenClear(SceSize idx){
+	__atomic_and_fetch(&snap_frozen_map[idx >> 5], ~(1 << (idx & 0x1F)), __ATOMIC_RELAXED);
+}
+
+static void vmassSnapshotGranule(SceSize idx, SceSize *sector_pos, SceSize *sector_num){
+
+	*sector_pos = idx << VMASS_SNAPSHOT_SHIFT;
+	*sector_num = (g_vmass_size >> 9) - *sector_pos;
+	if(*sector_num > (1 << VMASS_SNAPSHOT_SHIFT))
+		*sector_num = 1 << VMASS_SNAPSHOT_SHIFT;
+}
+
+/*
+ * Copy frozen granule idx aside before it is written. If no memory is left, the write still goes on and the snapshot
+ * is torn: the save fails when it reads on, and the granules it took stay dirty for the next save.
+ */
+static void vmassSnapshotPreserve(SceSize idx){
+
+	void *copy = NULL;
+	SceUID memid;
+	SceSize sector_pos, sector_num;
+
+	vmassSnapshotGranule(idx, &sector_pos, &sector_num);
+
+	memid = ksceKernelAllocMemBlock("VmassSnapshotChunk", 0x1020D006, 1 << (VMASS_SNAPSHOT_SHIFT + 9), NULL);
+	if(memid >= 0)
+		ksceKernelGetMemBlockBase(memid, &copy);
+
+	vmassRangeLock(-1, VMASS_REQ_WRITE, sector_pos, sector_num);
+
+	if(vmassFrozenTest(idx) != 0){
+		if(copy != NULL && _vmassReadSector(sector_pos, copy, sector_num) >= 0){
+			snap_copy[idx] = copy;
+			copy = NULL;
+		}else{
+			__atomic_store_n(&snap_torn, 1, __ATOMIC_RELEASE);
+		}
+
+		vmassFrozenClear(idx);
+	}
+
+	vmassRangeUnlock(VMASS_REQ_WRITE, sector_pos, sector_num);
+
+	if(copy != NULL)
+		ksceKernelFreeMemBlock(memid);
+}
+
+/*
+ * Preserve the frozen granules a write touches before it takes its range lock.
+ */
+int vmassSnapshotFault(SceSize sector_pos, SceSize sector_num){
+
+	SceSize idx, last;
+
+	if(__atomic_load_n(&snap_active, __ATOMIC_ACQUIRE) == 0)
+		return 0;
+
+	last = (sector_pos + sector_num - 1) >> VMASS_SNAPSHOT_SHIFT;
+
+	for(idx=(sector_pos >> VMASS_SNAPSHOT_SHIFT);idx<=last;idx++){
+		if(vmassFrozenTest(idx) != 0)
+			vmassSnapshotPreserve(idx);
+	}
+
+	return 0;
+}
+
+/*
+ * Read the frozen view of sectors [sector_pos, sector_pos + sector_num). With consume, granules read whole are
+ * released, later writes to them are not preserved and they can not be read again.
+ */
+int vmassSnapshotCopyOut(SceSize sector_pos, void *dst, SceSize sector_num, void *scratch, int consume){
+
+	int res = 0, whole;
+	void *copy;
+	SceSize idx, granule_pos, granule_num, work_num;
+
+	while(sector_num != 0){
+		idx = sector_pos >> VMASS_SNAPSHOT_SHIFT;
+
+		vmassSnapshotGranule(idx, &granule_pos, &granule_num);
+
+		work_num = granule_pos + granule_num - sector_pos;
+		if(work_num > sector_num)
+			work_num = sector_num;
+
+		whole = (consume != 0 && sector_pos == granule_pos && work_num == granule_num);
+
+		vmassQueueEnter();
+		vmassRangeLock(-1, VMASS_REQ_READ, sector_pos, work_num);
+
+		copy = snap_copy[idx];
+		if(__atomic_load_n(&snap_torn, __ATOMIC_ACQUIRE) != 0){
+			// set under the range lock, so a torn granule is seen before it is read
+			copy = NULL;
+			res  = -1;
+		}else if(copy != NULL){
+			memcpy(dst, copy + ((sector_pos - granule_pos) << 9), work_num << 9);
+			if(whole != 0)
+				snap_copy[idx] = NULL;
+		}else{
+			res = vmassImageCopyOut(sector_pos << 9, dst, work_num << 9, scratch);
+			if(whole != 0)
+				vmassFrozenClear(idx);
+		}
+
+		vmassRangeUnlock(VMASS_REQ_READ, sector_pos, work_num);
+		vmassQueueLeave();
+
+		if(copy != NULL && whole != 0)
+			ksceKernelFreeMemBlock(ksceKernelFindMemBlockByAddr(copy, 0));
+
+		if(res < 0)
+			return res;
+
+		sector_pos += work_num;
+		dst        += work_num << 9;
+		sector_num -= work_num;
+	}
+
+	return 0;
+}
+
+/*
+ * Freeze the storage. The caller holds the queue blocked, so no write is in flight.
+ */
+void vmassSnapshotTake(void){
+
+	SceSize i;
+
+	memset(snap_frozen_map, 0, ((snap_num + 0x1F) >> 5) * sizeof(SceUInt32));
+
+	for(i=0;i<snap_num;i++)
+		snap_frozen_map[i >> 5] |= 1 << (i & 0x1F);
+
+	__atomic_store_n(&snap_torn, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&snap_active, 1, __ATOMIC_RELEASE);
+}
+
+void vmassSnapshotRelease(void){
+
+	SceSize i;
+
+	vmassQueueBlock();
+
+	__atomic_store_n(&snap_active, 0, __ATOMIC_RELEASE);
+
+	for(i=0;i<snap_num;i++){
+		if(snap_copy[i] != NULL){
+			ksceKernelFreeMemBlock(ksceKernelFindMemBlockByAddr(snap_copy[i], 0));
+			snap_copy[i] = NULL;
+		}
+	}
+
+	vmassQueueUnblock();
+}
+
+static int sceVmassSnapshotThread(SceSize args, void *argp){
+
+	__atomic_store_n(&snap_res, vmassCreateImage(), __ATOMIC_RELAXED);
+	__atomic_store_n(&snap_saving, 0, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/*
+ * Reap the thread of the previous snapshot save.
+ */
+static int vmassSnapshotReap(void){
+
+	if(snap_thid < 0)
+		return 0;
+
+	ksceKernelWaitThreadEnd(snap_thid, NULL, NULL);
+	ksceKernelDeleteThread(snap_thid);
+	snap_thid = -1;
+
+	return __atomic_load_n(&snap_res, __ATOMIC_RELAXED);
+}
+
+int vmassSaveSnapshot(void){
+
+	int res;
+
+	if(__atomic_load_n(&snap_saving, __ATOMIC_ACQUIRE) != 0)
+		return -1;
+
+	vmassSnapshotReap();
+
+	snap_thid = ksceKernelCreateThread("SceVmassSnapshotThread", sceVmassSnapshotThread, VMASS_SNAPSHOT_THREAD_PRIORITY, VMASS_SNAPSHOT_THREAD_STACK_SIZE, 0, 0, NULL);
+	if(snap_thid < 0)
+		return snap_thid;
+
+	snap_saving = 1;
+
+	res = ksceKernelStartThread(snap_thid, 0, NULL);
+	if(res < 0){
+		snap_saving = 0;
+		ksceKernelDeleteThread(snap_thid);
+		snap_thid = -1;
+	}
+
+	return res;
+}
+
+int vmassWaitSnapshot(void){
+
+	if(snap_thid < 0)
+		return -1;
+
+	return vmassSnapshotReap();
+}
+
+int vmassSnapshotInit(SceSize size){
+
+	snap_num = ((size >> 9) + (1 << VMASS_SNAPSHOT_SHIFT) - 1) >> VMASS_SNAPSHOT_SHIFT;
+
+	snap_frozen_map = ksceKernelAllocHeapMemory(VMASS_KERNEL_HEAP, ((snap_num + 0x1F) >> 5) * sizeof(SceUInt32));
+	if(snap_frozen_map == NULL)
+		return -1;
+
+	snap_copy = ksceKernelAllocHeapMemory(VMASS_KERNEL_HEAP, snap_num * sizeof(void *));
+	if(snap_copy == NULL){
+		ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, snap_frozen_map);
+		snap_frozen_map = NULL;
+		return -1;
+	}
+
+	memset(snap_frozen_map, 0, ((snap_num + 0x1F) >> 5) * sizeof(SceUInt32));
+	memset(snap_copy, 0, snap_num * sizeof(void *));
+
+	return 0;
+}
+
+int vmassSnapshotFini(void){
+
+	if(snap_thid >= 0)
+		vmassSnapshotReap();
+
+	ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, snap_copy);
+	snap_copy = NULL;
+
+	ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, snap_frozen_map);
+	snap_frozen_map = NULL;
+	snap_num = 0;
+
+	return 0;
+}
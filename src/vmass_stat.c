@@ -0,0 +1,128 @@
+/*
+ * PlayStation(R)Vita Virtual Mass I/O Statistics
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/cpu.h>
+#include <psp2kern/kernel/sysclib.h>
+#include "vmass.h"
+#include "vmass_internal.h"
+
+/*
+ * Each core counts into its own cache line aligned copy, so cores never share a line while counting.
+ * A thread can still move to another core between reading the core id and the add, so the adds stay atomic.
+ */
+#define VMASS_STAT_CPU_NUM (4)
+
+#define VMASS_STAT_WORD_NUM (sizeof(VmassStat) / sizeof(SceUInt64))
+
+typedef struct VmassStatCpu {
+	VmassStat stat;
+} __attribute__((aligned(0x40))) VmassStatCpu;
+
+VmassStatCpu vmass_stat_cpu[VMASS_STAT_CPU_NUM];
+
+static VmassStat *vmassStatSelf(void){
+	return &vmass_stat_cpu[ksceKernelCpuGetCpuId() & (VMASS_STAT_CPU_NUM - 1)].stat;
+}
+
+static int vmassStatSizeClass(SceSize sector_num){
+
+	if(sector_num <= 8)
+		return 0;
+
+	if(sector_num <= 0x80)
+		return 1;
+
+	if(sector_num <= 0x400)
+		return 2;
+
+	return 3;
+}
+
+static int vmassStatLatencyBucket(SceUInt32 time){
+
+	int bucket;
+
+	bucket = (time == 0) ? 0 : (32 - __builtin_clz(time));
+	if(bucket >= VMASS_STAT_LATENCY_NUM)
+		bucket = VMASS_STAT_LATENCY_NUM - 1;
+
+	return bucket;
+}
+
+void vmassStatRequest(unsigned int opcode, SceSize sector_num, SceUInt32 time){
+
+	VmassStat *stat = vmassStatSelf();
+	int size_class = vmassStatSizeClass(sector_num), bucket = vmassStatLatencyBucket(time);
+
+	if(opcode == VMASS_REQ_READ){
+		__atomic_add_fetch(&stat->read_count, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&stat->read_bytes, sector_num << 9, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&stat->read_latency[size_class][bucket], 1, __ATOMIC_RELAXED);
+	}else{
+		__atomic_add_fetch(&stat->write_count, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&stat->write_bytes, sector_num << 9, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&stat->write_latency[size_class][bucket], 1, __ATOMIC_RELAXED);
+	}
+}
+
+void vmassStatChunk(SceSize queue_num, SceSize inline_num){
+
+	VmassStat *stat = vmassStatSelf();
+
+	if(queue_num != 0)
+		__atomic_add_fetch(&stat->queue_count, queue_num, __ATOMIC_RELAXED);
+
+	if(inline_num != 0)
+		__atomic_add_fetch(&stat->inline_count, inline_num, __ATOMIC_RELAXED);
+}
+
+void vmassStatLockWait(SceUInt32 time){
+
+	VmassStat *stat = vmassStatSelf();
+
+	__atomic_add_fetch(&stat->lock_wait_count, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stat->lock_wait_time, time, __ATOMIC_RELAXED);
+}
+
+/*
+ * Every counter is read, or taken and zeroed, on its own. A request counted meanwhile lands either in this
+ * snapshot or in the next one, never in both or neither.
+ */
+int vmassGetStat(VmassStat *stat, int reset){
+
+	int i;
+	SceSize n;
+	SceUInt64 *dst, *src;
+
+	if(stat == NULL || (reset != 0 && reset != VMASS_STAT_RESET))
+		return -1;
+
+	memset(stat, 0, sizeof(*stat));
+
+	dst = (SceUInt64 *)stat;
+
+	for(i=0;i<VMASS_STAT_CPU_NUM;i++){
+		src = (SceUInt64 *)&vmass_stat_cpu[i].stat;
+
+		for(n=0;n<VMASS_STAT_WORD_NUM;n++){
+			if(reset != 0)
+				dst[n] += __atomic_exchange_n(&src[n], 0, __ATOMIC_RELAXED);
+			else
+				dst[n] += __atomic_load_n(&src[n], __ATOMIC_RELAXED);
+		}
+	}
+
+	return 0;
+}
@@ -19,23 +19,76 @@
 #include "sysevent.h"
 #include "vmass.h"
 
+/*
+ * Power-off and reboot call the handler once per phase, 0x201 to 0x204. The save is started on a snapshot at the
+ * first phase and runs while the rest of the sequence goes on, 0x204 only waits for it and then saves the granules
+ * written since. If no earlier phase started it, 0x204 saves everything itself as before.
+ *
+ * Only the early phases sync uma0:, the snapshot lets it stay mounted. 0x204 unmounts it before the last save,
+ * so nothing can write to it afterwards.
+ */
+#define VMASS_SYSEVENT_PHASE_FIRST (0x201)
+#define VMASS_SYSEVENT_PHASE_LAST  (0x204)
+
+int sysevent_saving;
+
+static int vmassSysEventWantSave(void){
+
+	SceUInt32 ctrl = 0x74FFFFFF;
+
+	ksceSysconGetControlsInfo(&ctrl);
+
+	return (~ctrl & SCE_SYSCON_CTRL_START) != 0;
+}
+
 int vmassSysEventHandler(int resume, int eventid, void *args, void *opt){
 
-	if(resume == 0 && eventid == 0x204 && *(int *)(args + 0x00) == 0x18 && *(int *)(args + 0x04) != SCE_SYS_EVENT_STATE_SUSPEND){
+	int save;
 
-		SceUInt32 ctrl = 0x74FFFFFF;
+	if(resume != 0 || eventid < VMASS_SYSEVENT_PHASE_FIRST || eventid > VMASS_SYSEVENT_PHASE_LAST)
+		return 0;
 
-		ksceSysconGetControlsInfo(&ctrl);
+	if(*(int *)(args + 0x00) != 0x18 || *(int *)(args + 0x04) == SCE_SYS_EVENT_STATE_SUSPEND)
+		return 0;
 
-		if((~ctrl & SCE_SYSCON_CTRL_START) != 0){
+	if(eventid != VMASS_SYSEVENT_PHASE_LAST){
+		if(sysevent_saving == 0 && vmassSysEventWantSave() != 0){
 
 			/*
-			 * Unmount uma0: and remove file cache etc.
+			 * Write back the file cache of uma0:. The save is a snapshot, so uma0: can stay mounted.
 			 */
-			ksceIoUmount(0xF00, 1, 0, 0);
+			ksceIoSync("uma0:", 0);
 
-			vmassCreateImage();
+			if(vmassSaveSnapshot() >= 0)
+				sysevent_saving = 1;
 		}
+
+		return 0;
+	}
+
+	// writes since the last commit
+	vmassFlushJournal();
+
+	// no-op unless tracing is on
+	vmassDumpTrace(NULL);
+
+	if(sysevent_saving != 0){
+		vmassWaitSnapshot();
+		sysevent_saving = 0;
+		save = 1;
+	}else{
+		save = vmassSysEventWantSave();
+	}
+
+	if(save != 0){
+
+		/*
+		 * Unmount uma0: and remove file cache etc.
+		 */
+		ksceIoUmount(0xF00, 1, 0, 0);
+
+		// only what was written since the snapshot, if it was saved
+		vmassCreateImage();
 	}
 
 	return 0;
@@ -0,0 +1,433 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Compressed Tier
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/threadmgr.h>
+#include <psp2kern/kernel/sysmem.h>
+#include <psp2kern/kernel/sysclib.h>
+#include "vmass.h"
+#include "vmass_page.h"
+#include "vmass_lz.h"
+#include "vmass_tier.h"
+#include "vmass_internal.h"
+
+/*
+ * Thin pages that were not accessed for VMASS_TIER_IDLE_SCAN scans are compressed into the pool heap and their memblock
+ * is given back to the system. The next access decompresses the page into a new memblock.
+ *
+ * The scan takes the page's range lock exclusively, so a page never changes tier under a request.
+ *
+ * When no memblock is left to decompress into, reclaim is kicked. A read is then served from the bounce chunk and
+ * the page stays cold, a write fails like one to an unbacked thin page.
+ */
+#define VMASS_TIER_THREAD_PRIORITY (0xA0)
+
+#define VMASS_TIER_POOL_SIZE     (0x200000)
+#define VMASS_TIER_SCAN_INTERVAL (1000000)
+#define VMASS_TIER_IDLE_SCAN     (4)
+
+#define VMASS_TIER_EXIT (1 << 0)
+
+// compressed output buffer followed by the codec work area
+#define VMASS_TIER_WORK_SIZE ((VMASS_THIN_CHUNK_SIZE + VMASS_LZ_WORK_SIZE + 0xFFF) & ~0xFFF)
+
+int vmass_tier_mode = VMASS_TIER_OFF;
+
+SceUID tier_heap_id = -1, tier_work_id = -1, tier_bounce_id = -1, tier_evf_id = -1, tier_thid = -1;
+void *tier_work, *tier_bounce;
+
+SceKernelLwMutexWork tier_mtx;      // serialises decompression of cold pages, owns tier_bounce
+SceKernelLwMutexWork tier_scan_mtx; // owns tier_work
+
+VmassTierStat vmass_tier_stat;
+
+void vmassTierTouch(VmassPageInfo *page, void *base){
+
+	if(__atomic_load_n(&page->access, __ATOMIC_RELAXED) == 0)
+		__atomic_store_n(&page->access, 1, __ATOMIC_RELAXED);
+
+	if(base != NULL)
+		__atomic_add_fetch(&vmass_tier_stat.hit_count, 1, __ATOMIC_RELAXED);
+}
+
+static void vmassTierAccount(VmassPageInfo *page, int compressed){
+
+	if(compressed != 0){
+		__atomic_add_fetch(&vmass_tier_stat.compressed_num, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&vmass_tier_stat.compressed_size, page->comp_size, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&vmass_tier_stat.original_size, page->size, __ATOMIC_RELAXED);
+	}else{
+		__atomic_sub_fetch(&vmass_tier_stat.compressed_num, 1, __ATOMIC_RELAXED);
+		__atomic_sub_fetch(&vmass_tier_stat.compressed_size, page->comp_size, __ATOMIC_RELAXED);
+		__atomic_sub_fetch(&vmass_tier_stat.original_size, page->size, __ATOMIC_RELAXED);
+	}
+}
+
+int vmassTierLoad(VmassPageInfo *page, void **base){
+
+	int res = 0;
+	void *block;
+	SceUID memid;
+
+	ksceKernelLockFastMutex(&tier_mtx);
+
+	block = __atomic_load_n(&page->base, __ATOMIC_ACQUIRE);
+	if(block != NULL || page->comp == NULL)
+		goto end;
+
+	block = __atomic_exchange_n(&page->reserve, NULL, __ATOMIC_ACQ_REL);
+	if(block == NULL){
+		memid = ksceKernelAllocMemBlock("VmassStorageChunk", page->memtype, page->size, NULL);
+		if(memid < 0){
+			vmassReclaimKick();
+			res = memid;
+			goto end;
+		}
+
+		ksceKernelGetMemBlockBase(memid, &block);
+	}
+
+	if(vmassLzDecompress(block, page->size, page->comp, page->comp_size) != page->size){
+		vmassPageKeep(page, block);
+		block = NULL;
+		res   = -1;
+		goto end;
+	}
+
+	__atomic_store_n(&page->base, block, __ATOMIC_RELEASE);
+
+	ksceKernelFreeHeapMemory(tier_heap_id, page->comp);
+	__atomic_store_n(&page->comp, NULL, __ATOMIC_RELEASE);
+
+	vmassTierAccount(page, 0);
+
+	__atomic_add_fetch(&vmass_page_backed_size, page->size, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&vmass_tier_stat.miss_count, 1, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&page->access, 1, __ATOMIC_RELAXED);
+
+end:
+	ksceKernelUnlockFastMutex(&tier_mtx);
+
+	*base = block;
+
+	return res;
+}
+
+int vmassTierRead(VmassPageInfo *page, void *dst){
+
+	int res = -1;
+
+	ksceKernelLockFastMutex(&tier_mtx);
+
+	if(page->comp != NULL && vmassLzDecompress(dst, page->size, page->comp, page->comp_size) == page->size)
+		res = 0;
+
+	ksceKernelUnlockFastMutex(&tier_mtx);
+
+	return res;
+}
+
+int vmassTierReadBounce(VmassPageInfo *page, SceSize off, void *dst, SceSize size){
+
+	int res = -1;
+	void *base;
+
+	ksceKernelLockFastMutex(&tier_mtx);
+
+	// another request may have loaded the page since
+	base = __atomic_load_n(&page->base, __ATOMIC_ACQUIRE);
+	if(base != NULL){
+		memcpy(dst, base + off, size);
+		res = 0;
+	}else if(page->comp != NULL && tier_bounce != NULL
+		&& vmassLzDecompress(tier_bounce, page->size, page->comp, page->comp_size) == page->size){
+		memcpy(dst, tier_bounce + off, size);
+		__atomic_add_fetch(&vmass_tier_stat.bounce_count, 1, __ATOMIC_RELAXED);
+		res = 0;
+	}
+
+	ksceKernelUnlockFastMutex(&tier_mtx);
+
+	return res;
+}
+
+void vmassTierDrop(VmassPageInfo *page){
+
+	if(page->comp == NULL)
+		return;
+
+	vmassTierAccount(page, 0);
+
+	ksceKernelFreeHeapMemory(tier_heap_id, page->comp);
+	page->comp = NULL;
+}
+
+/*
+ * Pages must save at least an eighth of their size to be kept compressed.
+ */
+static int vmassTierCompress(VmassPageInfo *page, int force){
+
+	int size, res = -1;
+	void *base, *blob;
+
+	vmassQueueEnter();
+	vmassRangeLock(-1, VMASS_REQ_WRITE, page->offset >> 9, page->size >> 9);
+
+	base = page->base;
+	if(base == NULL || (force == 0 && __atomic_load_n(&page->access, __ATOMIC_RELAXED) != 0))
+		goto unlock;
+
+	size = vmassLzCompress(tier_work, page->size - (page->size >> 3), base, page->size, tier_work + VMASS_THIN_CHUNK_SIZE);
+	if(size < 0){
+		__atomic_add_fetch(&vmass_tier_stat.reject_count, 1, __ATOMIC_RELAXED);
+		goto unlock;
+	}
+
+	blob = ksceKernelAllocHeapMemory(tier_heap_id, size);
+	if(blob == NULL){
+		__atomic_add_fetch(&vmass_tier_stat.reject_count, 1, __ATOMIC_RELAXED);
+		goto unlock;
+	}
+
+	memcpy(blob, tier_work, size);
+
+	page->comp_size = size;
+	__atomic_store_n(&page->comp, blob, __ATOMIC_RELEASE);
+	__atomic_store_n(&page->base, NULL, __ATOMIC_RELEASE);
+
+	ksceKernelFreeMemBlock(ksceKernelFindMemBlockByAddr(base, 0));
+
+	vmassTierAccount(page, 1);
+
+	__atomic_sub_fetch(&vmass_page_backed_size, page->size, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&vmass_tier_stat.compress_count, 1, __ATOMIC_RELAXED);
+
+	res = 0;
+
+unlock:
+	vmassRangeUnlock(VMASS_REQ_WRITE, page->offset >> 9, page->size >> 9);
+	vmassQueueLeave();
+
+	return res;
+}
+
+int vmassTierScan(SceUInt32 idle_scans){
+
+	int i;
+	VmassPageInfo *page;
+
+	// a cold page must stay readable without memory to decompress it into
+	if(tier_work == NULL || tier_bounce == NULL)
+		return -1;
+
+	ksceKernelLockFastMutex(&tier_scan_mtx);
+
+	for(i=0;i<vmass_page_num;i++){
+		page = &vmass_page_list[i];
+
+		if((page->flags & (VMASS_PAGE_THIN | VMASS_PAGE_BORROWED)) != VMASS_PAGE_THIN || page->size > VMASS_THIN_CHUNK_SIZE)
+			continue;
+
+		if(__atomic_exchange_n(&page->access, 0, __ATOMIC_RELAXED) != 0 && idle_scans != 0){
+			page->idle = 0;
+			continue;
+		}
+
+		if(page->idle < 0xFFFF)
+			page->idle++;
+
+		if(page->idle < idle_scans || __atomic_load_n(&page->base, __ATOMIC_ACQUIRE) == NULL)
+			continue;
+
+		vmassTierCompress(page, idle_scans == 0);
+	}
+
+	ksceKernelUnlockFastMutex(&tier_scan_mtx);
+
+	return 0;
+}
+
+int sceVmassTierThread(SceSize args, void *argp){
+
+	SceUInt timeout;
+
+	while(1){
+		timeout = VMASS_TIER_SCAN_INTERVAL;
+
+		if(ksceKernelWaitEventFlag(tier_evf_id, VMASS_TIER_EXIT, SCE_EVENT_WAITOR | SCE_EVENT_WAITCLEAR_PAT, NULL, &timeout) == 0)
+			break;
+
+		vmassTierScan(VMASS_TIER_IDLE_SCAN);
+	}
+
+	return 0;
+}
+
+/*
+ * The pool and the work buffer are created on the first enable and kept until vmassTierFini,
+ * pages stay compressed after the tier is turned off until they are accessed.
+ */
+static int vmassTierStart(void){
+
+	int res;
+
+	if(tier_heap_id < 0){
+		tier_heap_id = ksceKernelCreateHeap("VmassTierPool", VMASS_TIER_POOL_SIZE, NULL);
+		if(tier_heap_id < 0)
+			return tier_heap_id;
+	}
+
+	if(tier_work_id < 0){
+		tier_work_id = ksceKernelAllocMemBlock("VmassTierWork", 0x1020D006, VMASS_TIER_WORK_SIZE, NULL);
+		if(tier_work_id < 0)
+			return tier_work_id;
+
+		ksceKernelGetMemBlockBase(tier_work_id, &tier_work);
+	}
+
+	if(tier_bounce_id < 0){
+		tier_bounce_id = ksceKernelAllocMemBlock("VmassTierBounce", 0x1020D006, VMASS_THIN_CHUNK_SIZE, NULL);
+		if(tier_bounce_id < 0)
+			return tier_bounce_id;
+
+		ksceKernelGetMemBlockBase(tier_bounce_id, &tier_bounce);
+	}
+
+	tier_thid = ksceKernelCreateThread("SceVmassTierThread", sceVmassTierThread, VMASS_TIER_THREAD_PRIORITY, 0x1000, 0, 0, NULL);
+	if(tier_thid < 0)
+		return tier_thid;
+
+	res = ksceKernelStartThread(tier_thid, 0, NULL);
+	if(res < 0){
+		ksceKernelDeleteThread(tier_thid);
+		tier_thid = -1;
+	}
+
+	return res;
+}
+
+static int vmassTierStop(void){
+
+	ksceKernelSetEventFlag(tier_evf_id, VMASS_TIER_EXIT);
+	ksceKernelWaitThreadEnd(tier_thid, NULL, NULL);
+	ksceKernelDeleteThread(tier_thid);
+	tier_thid = -1;
+
+	return 0;
+}
+
+int vmassSetTierMode(int mode){
+
+	int res = 0;
+
+	if(mode != VMASS_TIER_OFF && mode != VMASS_TIER_ON)
+		return -1;
+
+	ksceKernelLockFastMutex(&lw_mtx);
+
+	if(mode == VMASS_TIER_ON && tier_thid < 0)
+		res = vmassTierStart();
+	else if(mode == VMASS_TIER_OFF && tier_thid >= 0)
+		res = vmassTierStop();
+
+	if(res >= 0)
+		vmass_tier_mode = mode;
+
+	ksceKernelUnlockFastMutex(&lw_mtx);
+
+	return res;
+}
+
+int vmassGetTierStat(VmassTierStat *stat){
+
+	if(stat == NULL)
+		return -1;
+
+	stat->hit_count       = __atomic_load_n(&vmass_tier_stat.hit_count, __ATOMIC_RELAXED);
+	stat->miss_count      = __atomic_load_n(&vmass_tier_stat.miss_count, __ATOMIC_RELAXED);
+	stat->compress_count  = __atomic_load_n(&vmass_tier_stat.compress_count, __ATOMIC_RELAXED);
+	stat->reject_count    = __atomic_load_n(&vmass_tier_stat.reject_count, __ATOMIC_RELAXED);
+	stat->bounce_count    = __atomic_load_n(&vmass_tier_stat.bounce_count, __ATOMIC_RELAXED);
+	stat->compressed_num  = __atomic_load_n(&vmass_tier_stat.compressed_num, __ATOMIC_RELAXED);
+	stat->compressed_size = __atomic_load_n(&vmass_tier_stat.compressed_size, __ATOMIC_RELAXED);
+	stat->original_size   = __atomic_load_n(&vmass_tier_stat.original_size, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+int vmassTierInit(void){
+
+	int res;
+
+	res = ksceKernelInitializeFastMutex(&tier_mtx, "VmassTierMutex", 0, 0);
+	if(res < 0)
+		return res;
+
+	res = ksceKernelInitializeFastMutex(&tier_scan_mtx, "VmassTierScanMutex", 0, 0);
+	if(res < 0)
+		goto del_mtx;
+
+	tier_evf_id = ksceKernelCreateEventFlag("VmassTierEvf", 0, 0, NULL);
+	if(tier_evf_id < 0){
+		res = tier_evf_id;
+		goto del_scan_mtx;
+	}
+
+	return 0;
+
+del_scan_mtx:
+	ksceKernelDeleteFastMutex(&tier_scan_mtx);
+
+del_mtx:
+	ksceKernelDeleteFastMutex(&tier_mtx);
+
+	return res;
+}
+
+int vmassTierFini(void){
+
+	int i;
+
+	if(tier_thid >= 0)
+		vmassTierStop();
+
+	for(i=0;i<vmass_page_num;i++)
+		vmassTierDrop(&vmass_page_list[i]);
+
+	if(tier_work_id >= 0){
+		ksceKernelFreeMemBlock(tier_work_id);
+		tier_work_id = -1;
+		tier_work    = NULL;
+	}
+
+	if(tier_bounce_id >= 0){
+		ksceKernelFreeMemBlock(tier_bounce_id);
+		tier_bounce_id = -1;
+		tier_bounce    = NULL;
+	}
+
+	if(tier_heap_id >= 0){
+		ksceKernelDeleteHeap(tier_heap_id);
+		tier_heap_id = -1;
+	}
+
+	ksceKernelDeleteEventFlag(tier_evf_id);
+	ksceKernelDeleteFastMutex(&tier_scan_mtx);
+	ksceKernelDeleteFastMutex(&tier_mtx);
+
+	vmass_tier_mode = VMASS_TIER_OFF;
+
+	return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Compressed Tier Header
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VMASS_TIER_H_
+#define _VMASS_TIER_H_
+
+#include <psp2kern/types.h>
+#include "vmass.h"
+#include "vmass_page.h"
+
+extern int vmass_tier_mode;
+
+/*
+ * Decompress a cold page back into its own memblock. Returns the new base in *base.
+ */
+int vmassTierLoad(VmassPageInfo *page, void **base);
+
+/*
+ * Mark the page as accessed, base is the memory the access was served from (NULL if unbacked).
+ */
+void vmassTierTouch(VmassPageInfo *page, void *base);
+
+/*
+ * Decompress a cold page into dst without making it hot again.
+ */
+int vmassTierRead(VmassPageInfo *page, void *dst);
+
+/*
+ * Copy size bytes at off of a cold page to dst through the bounce chunk, for a read vmassTierLoad found no memory for.
+ */
+int vmassTierReadBounce(VmassPageInfo *page, SceSize off, void *dst, SceSize size);
+
+void vmassTierDrop(VmassPageInfo *page);
+
+int vmassTierInit(void);
+int vmassTierFini(void);
+
+#endif	/* _VMASS_TIER_H_ */
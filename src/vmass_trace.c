@@ -0,0 +1,270 @@
+/*
+ * PlayStation(R)Vita Virtual Mass I/O Trace
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <psp2kern/kernel/threadmgr.h>
+#include <psp2kern/kernel/sysmem.h>
+#include <psp2kern/kernel/sysclib.h>
+#include <psp2kern/kernel/cpu.h>
+#include <psp2kern/io/fcntl.h>
+#include "vmass.h"
+#include "vmass_trace.h"
+#include "vmass_internal.h"
+
+/*
+ * A request takes a slot by incrementing trace_head and publishes it through the slot's sequence number,
+ * which is 0 while the record is written and index + 1 once it is complete. The dump copies a slot between two
+ * reads of its sequence number and drops it if the two differ, so a writer lapping the dump never blocks on it.
+ */
+#define VMASS_TRACE_DUMP_NUM (0x100) // records per file write
+
+typedef struct VmassTraceSlot {
+	SceUInt32 seq;
+	VmassTraceRecord record;
+} VmassTraceSlot;
+
+int vmass_trace_mode = VMASS_TRACE_OFF;
+SceSize vmass_trace_record_num = VMASS_TRACE_RECORD_DEF;
+
+int trace_ready = 0;
+SceUID trace_memid = -1;
+VmassTraceSlot *trace_ring = NULL;
+SceSize trace_mask;
+SceUInt32 trace_head;
+
+SceKernelLwMutexWork trace_mtx;
+
+void vmassTraceRecord(unsigned int opcode, SceSize sector_pos, SceSize sector_num, SceUInt32 time_s, SceUInt32 latency, int flags){
+
+	SceUInt32 idx;
+	VmassTraceSlot *slot;
+	VmassTraceSlot *ring = __atomic_load_n(&trace_ring, __ATOMIC_ACQUIRE);
+
+	if(ring == NULL)
+		return;
+
+	idx  = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED);
+	slot = &ring[idx & trace_mask];
+
+	__atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	slot->record.time       = time_s;
+	slot->record.latency    = latency;
+	slot->record.sector_pos = sector_pos;
+	slot->record.sector_num = sector_num;
+	slot->record.op         = (opcode == VMASS_REQ_READ) ? VMASS_TRACE_OP_READ : VMASS_TRACE_OP_WRITE;
+	slot->record.cpu        = ksceKernelCpuGetCpuId();
+	slot->record.flags      = flags;
+
+	__atomic_store_n(&slot->seq, idx + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * The ring is only replaced with the queue blocked, so no request is writing to the old one.
+ */
+static int vmassTraceStart(void){
+
+	int res;
+	void *base;
+	SceSize size;
+
+	size = (vmass_trace_record_num * sizeof(VmassTraceSlot) + 0xFFF) & ~0xFFF;
+
+	res = ksceKernelAllocMemBlock("VmassTraceRing", 0x1020D006, size, NULL);
+	if(res < 0)
+		return res;
+
+	trace_memid = res;
+
+	ksceKernelGetMemBlockBase(trace_memid, &base);
+	memset(base, 0, size);
+
+	trace_mask = vmass_trace_record_num - 1;
+	trace_head = 0;
+
+	__atomic_store_n(&trace_ring, base, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static void vmassTraceStop(void){
+
+	__atomic_store_n(&trace_ring, NULL, __ATOMIC_RELEASE);
+
+	ksceKernelFreeMemBlock(trace_memid);
+	trace_memid = -1;
+}
+
+int vmassSetTraceMode(int mode, SceSize record_num){
+
+	int res = 0;
+
+	if(mode != VMASS_TRACE_OFF && mode != VMASS_TRACE_ON)
+		return -1;
+
+	if(record_num == 0)
+		record_num = VMASS_TRACE_RECORD_DEF;
+
+	if(record_num < VMASS_TRACE_RECORD_MIN || record_num > VMASS_TRACE_RECORD_MAX || (record_num & (record_num - 1)) != 0)
+		return -1;
+
+	if(trace_ready == 0){
+		vmass_trace_mode       = mode;
+		vmass_trace_record_num = record_num;
+		return 0;
+	}
+
+	ksceKernelLockFastMutex(&trace_mtx);
+
+	// turning it on again restarts the trace
+	if(trace_memid >= 0){
+		vmassQueueBlock();
+		vmassTraceStop();
+		vmassQueueUnblock();
+	}
+
+	vmass_trace_mode       = mode;
+	vmass_trace_record_num = record_num;
+
+	if(mode == VMASS_TRACE_ON){
+		vmassQueueBlock();
+		res = vmassTraceStart();
+		vmassQueueUnblock();
+
+		if(res < 0)
+			vmass_trace_mode = VMASS_TRACE_OFF;
+	}
+
+	ksceKernelUnlockFastMutex(&trace_mtx);
+
+	return res;
+}
+
+static int vmassTraceWrite(SceUID fd, const void *data, SceSize size){
+
+	int res;
+
+	res = ksceIoWrite(fd, data, size);
+	if(res >= 0 && res != size)
+		res = -1;
+
+	return res;
+}
+
+int vmassDumpTrace(const char *path){
+
+	int res;
+	SceUID fd;
+	SceUInt32 head, idx, seq, n;
+	SceSize num = 0;
+	VmassTraceSlot *slot;
+	VmassTraceRecord *buf;
+	VmassTraceHeader header;
+
+	if(path == NULL)
+		path = VMASS_TRACE_PATH;
+
+	if(trace_ready == 0)
+		return -1;
+
+	buf = ksceKernelAllocHeapMemory(VMASS_KERNEL_HEAP, VMASS_TRACE_DUMP_NUM * sizeof(*buf));
+	if(buf == NULL)
+		return -1;
+
+	ksceKernelLockFastMutex(&trace_mtx);
+
+	if(trace_memid < 0){
+		res = -1;
+		goto unlock;
+	}
+
+	fd = ksceIoOpen(path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0666);
+	if(fd < 0){
+		res = fd;
+		goto unlock;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic       = VMASS_TRACE_MAGIC;
+	header.version     = VMASS_TRACE_VERSION;
+	header.record_size = sizeof(VmassTraceRecord);
+
+	// the header is written again once the record count is known
+	res = vmassTraceWrite(fd, &header, sizeof(header));
+
+	head = __atomic_load_n(&trace_head, __ATOMIC_ACQUIRE);
+	idx  = (head > vmass_trace_record_num) ? (head - vmass_trace_record_num) : 0;
+	n    = 0;
+
+	for(;res >= 0 && idx != head;idx++){
+		slot = &trace_ring[idx & trace_mask];
+
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		memcpy(&buf[n], &slot->record, sizeof(*buf));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+		if(seq != (idx + 1) || __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq)
+			continue;
+
+		n++;
+		if(n == VMASS_TRACE_DUMP_NUM){
+			res = vmassTraceWrite(fd, buf, n * sizeof(*buf));
+			num += n;
+			n = 0;
+		}
+	}
+
+	if(res >= 0 && n != 0){
+		res = vmassTraceWrite(fd, buf, n * sizeof(*buf));
+		num += n;
+	}
+
+	if(res >= 0){
+		header.record_num = num;
+		header.total_num  = head;
+
+		res = ksceIoLseek(fd, 0, SCE_SEEK_SET);
+		if(res >= 0)
+			res = vmassTraceWrite(fd, &header, sizeof(header));
+	}
+
+	ksceIoClose(fd);
+
+	if(res >= 0)
+		res = 0;
+
+unlock:
+	ksceKernelUnlockFastMutex(&trace_mtx);
+
+	ksceKernelFreeHeapMemory(VMASS_KERNEL_HEAP, buf);
+
+	return res;
+}
+
+int vmassTraceInit(void){
+
+	int res;
+
+	res = ksceKernelInitializeFastMutex(&trace_mtx, "VmassTraceMutex", 0, 0);
+	if(res < 0)
+		return res;
+
+	trace_ready = 1;
+
+	if(vmass_trace_mode == VMASS_TRACE_ON && vmassTraceStart() < 0)
+		vmass_trace_mode = VMASS_TRACE_OFF;
+
+	return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * PlayStation(R)Vita Virtual Mass Trace Format
+ * Copyright (C) 2026 Princess of Slepping
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VMASS_TRACE_H_
+#define _VMASS_TRACE_H_
+
+#include <psp2kern/types.h>
+
+/*
+ * A trace is a VmassTraceHeader followed by record_num VmassTraceRecord in the order the requests completed.
+ * total_num counts every request traced since tracing was turned on, so total_num - record_num were overwritten
+ * in the ring or torn by a concurrent write while it was dumped.
+ */
+#define VMASS_TRACE_MAGIC   (0x52544D56) // "VMTR"
+#define VMASS_TRACE_VERSION (1)
+
+#define VMASS_TRACE_OP_READ  (1)
+#define VMASS_TRACE_OP_WRITE (2)
+
+typedef struct VmassTraceHeader { // size is 0x18
+	SceUInt32 magic;
+	SceUInt32 version;
+	SceUInt32 record_size;
+	SceUInt32 record_num;
+	SceUInt64 total_num;
+} VmassTraceHeader;
+
+typedef struct VmassTraceRecord { // size is 0x14
+	SceUInt32 time;       // us of ksceKernelGetSystemTimeLow when the request entered vmass, wraps
+	SceUInt32 latency;    // us until it completed
+	SceUInt32 sector_pos;
+	SceUInt32 sector_num;
+	SceUInt8 op;
+	SceUInt8 cpu;
+	SceUInt16 flags;      // VMASS_TRACE_FLAG_*
+} VmassTraceRecord;
+
+#define VMASS_TRACE_FLAG_ASYNC (1 << 0) // submitted through vmassSubmitReadSector/vmassSubmitWriteSector
+#define VMASS_TRACE_FLAG_ERROR (1 << 1)
+
+#endif	/* _VMASS_TRACE_H_ */